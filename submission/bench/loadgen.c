@@ -0,0 +1,220 @@
+/* * * * * * * * *
+ * Load generator for a2's server mode (a2 -L), measuring the throughput and
+ * latency of a table served over a local socket
+ *
+ * usage:
+ *   ./a2 -t linear -L /tmp/a2.sock -w 4 &
+ *   ./bench/loadgen address [nrequests [depth [nconns [stop]]]] > load.csv
+ *       address: the server's address, as given to a2 -L (a port number for
+ *                localhost TCP, or else the path of a Unix domain socket)
+ *       nrequests: how many requests to send altogether (default 2^22)
+ *       depth: how many requests each connection sends before waiting for
+ *              their replies (default 64)
+ *       nconns: how many connections to send them over, each from a thread
+ *               of its own (default 4)
+ *       stop: if given (as the word "stop"), stop the server afterwards
+ *
+ * each connection sends batches of 'depth' random requests, half inserts and
+ * half lookups (of keys from a range twice the number of requests, so that
+ * some lookups find their key), and waits for each batch's replies before
+ * sending the next. prints a CSV row with the throughput, and the percentiles
+ * of the time from sending a batch to having all its replies
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime, pthread_barrier_t
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>  // for memcpy, strcmp
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../inthash.h"
+#include "../server.h"
+#include "../xorshift.h"
+
+#define DEFAULT_NREQUESTS (1 << 22)
+#define DEFAULT_DEPTH 64
+#define DEFAULT_NCONNS 4
+#define MAX_CONNS 256
+
+// one connection's share of the load
+typedef struct client {
+	const char *address;	// where the server is
+	int nbatches;			// how many batches to send
+	int depth;				// how many requests in each
+	int64 key_range;		// keys are drawn from [0, key_range)
+	int64 state;			// this client's random number generator
+	int64 *latencies;		// the time each batch took, in nanoseconds
+	pthread_barrier_t *start;	// waited on by every client before sending
+} Client;
+
+// the current time in nanoseconds, from the monotonic clock
+static int64 now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// send all 'n' bytes at 'data' on socket 'fd'
+static void send_all(int fd, const char *data, size_t n) {
+	while (n > 0) {
+		ssize_t sent = send(fd, data, n, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			perror("send");
+			exit(1);
+		}
+		data += sent;
+		n -= sent;
+	}
+}
+
+// receive exactly 'n' bytes into 'data' from socket 'fd'
+static void receive_all(int fd, char *data, size_t n) {
+	while (n > 0) {
+		ssize_t received = recv(fd, data, n, 0);
+		if (received <= 0) {
+			fprintf(stderr, "server closed the connection\n");
+			exit(1);
+		}
+		data += received;
+		n -= received;
+	}
+}
+
+// the requests of one connection
+static void *run_client(void *arg) {
+	Client *client = arg;
+	int fd = server_open_socket(client->address, false);
+	if (fd < 0) {
+		perror(client->address);
+		exit(1);
+	}
+
+	char *requests = malloc(client->depth * REQUEST_SIZE);
+	char *replies = malloc(client->depth);
+	assert(requests && replies);
+
+	pthread_barrier_wait(client->start);
+	int b;
+	for (b = 0; b < client->nbatches; b++) {
+		int i;
+		for (i = 0; i < client->depth; i++) {
+			int64 random = next_random(&client->state);
+			char *request = requests + i * REQUEST_SIZE;
+			request[0] = (random & 1) ? REQUEST_INSERT : REQUEST_LOOKUP;
+			int64 key = (random >> 1) % client->key_range;
+			memcpy(request + 1, &key, sizeof key);
+		}
+
+		int64 start = now();
+		send_all(fd, requests, client->depth * REQUEST_SIZE);
+		receive_all(fd, replies, client->depth);
+		client->latencies[b] = now() - start;
+
+		for (i = 0; i < client->depth; i++) {
+			assert(replies[i] == REPLY_YES || replies[i] == REPLY_NO);
+		}
+	}
+
+	close(fd);
+	free(requests);
+	free(replies);
+	return NULL;
+}
+
+// compare two latencies, for sorting
+static int compare_latencies(const void *a, const void *b) {
+	int64 x = *(const int64 *) a, y = *(const int64 *) b;
+	return (x > y) - (x < y);
+}
+
+// send the server at 'address' a request to stop
+static void stop_server(const char *address) {
+	int fd = server_open_socket(address, false);
+	if (fd < 0) {
+		perror(address);
+		exit(1);
+	}
+	char request[REQUEST_SIZE] = { REQUEST_STOP };
+	char reply;
+	send_all(fd, request, REQUEST_SIZE);
+	receive_all(fd, &reply, 1);
+	close(fd);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s address [nrequests [depth [nconns [stop]]]]"
+			" > load.csv\n", argv[0]);
+		exit(1);
+	}
+	const char *address = argv[1];
+	int nrequests = (argc > 2) ? atoi(argv[2]) : DEFAULT_NREQUESTS;
+	int depth = (argc > 3) ? atoi(argv[3]) : DEFAULT_DEPTH;
+	int nconns = (argc > 4) ? atoi(argv[4]) : DEFAULT_NCONNS;
+	bool stop = (argc > 5 && strcmp(argv[5], "stop") == 0);
+	if (nrequests <= 0 || depth <= 0 || nconns <= 0 || nconns > MAX_CONNS) {
+		fprintf(stderr, "usage: %s address [nrequests [depth [nconns [stop]]]]"
+			" > load.csv\n", argv[0]);
+		exit(1);
+	}
+
+	// every connection sends the same number of whole batches
+	int nbatches = nrequests / depth / nconns;
+	if (nbatches == 0) {
+		nbatches = 1;
+	}
+	int64 *latencies = malloc((size_t) nconns * nbatches * sizeof *latencies);
+	assert(latencies);
+
+	pthread_barrier_t start;
+	pthread_barrier_init(&start, NULL, nconns + 1);
+	Client clients[MAX_CONNS];
+	pthread_t threads[MAX_CONNS];
+	int c;
+	for (c = 0; c < nconns; c++) {
+		clients[c].address = address;
+		clients[c].nbatches = nbatches;
+		clients[c].depth = depth;
+		clients[c].key_range = 2 * (int64) nrequests;
+		clients[c].state = XORSHIFT_SEED + c;
+		clients[c].latencies = latencies + (size_t) c * nbatches;
+		clients[c].start = &start;
+		int error = pthread_create(&threads[c], NULL, run_client, &clients[c]);
+		assert(error == 0);
+	}
+
+	// time from when every client is connected and ready
+	pthread_barrier_wait(&start);
+	int64 begin = now();
+	for (c = 0; c < nconns; c++) {
+		pthread_join(threads[c], NULL);
+	}
+	double seconds = (now() - begin) / 1e9;
+	pthread_barrier_destroy(&start);
+
+	size_t nlatencies = (size_t) nconns * nbatches;
+	qsort(latencies, nlatencies, sizeof *latencies, compare_latencies);
+	int64 total = (int64) nconns * nbatches * depth;
+
+	printf("nconns,depth,requests,seconds,mreqs_per_s,p50_us,p99_us,p999_us\n");
+	printf("%d,%d,%llu,%.3f,%.3f,%.1f,%.1f,%.1f\n", nconns, depth,
+		(unsigned long long) total, seconds, total / seconds / 1e6,
+		latencies[nlatencies / 2] / 1e3,
+		latencies[(size_t) (nlatencies * 0.99)] / 1e3,
+		latencies[(size_t) (nlatencies * 0.999)] / 1e3);
+
+	if (stop) {
+		stop_server(address);
+	}
+	free(latencies);
+	return 0;
+}
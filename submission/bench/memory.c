@@ -0,0 +1,113 @@
+/* * * * * * * * *
+ * Benchmark program measuring how many bytes of memory each type of hash
+ * table uses per key, as more and more keys are inserted
+ *
+ * usage:
+ *   make memory.csv          (or make memory.png, to plot it with gnuplot)
+ *   ./bench/memory [maxkeys [size]] > memory.csv
+ *       maxkeys: how many keys to insert into each table (default 2^20, but
+ *                see SINGLE_KEY_MAX_KEYS)
+ *       size: initial size to create each table with, as in a2 -s (which is
+ *             the bucket size for xtndbln and xuckoon) (default 4)
+ *
+ * prints one CSV row per table type per measurement, with the total bytes,
+ * bytes per key, and the breakdown from hash_table_memory_usage()
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../memusage.h"
+#include "../latency.h"
+#include "../xorshift.h"
+
+#define DEFAULT_MAX_KEYS (1 << 20)
+#define DEFAULT_SIZE 4
+
+// the table types to measure, in order
+static const char *types[] = {
+	"linear", "xtndbl1", "cuckoo", "xtndbln", "xuckoo", "xuckoon"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// the single-key bucket types can't separate two keys whose hash values agree
+// in every bit their table of bucket pointers can use (27, at most), and
+// among random keys such a pair turns up after ten thousand or so. so they're
+// only measured up to this many keys
+#define SINGLE_KEY_MAX_KEYS 8192
+
+// keys are kept below both primes used by the hash functions, so that no two
+// keys share a hash value (which single-key buckets could never separate)
+#define MAX_KEY 2147483563
+
+// the next pseudo-random key (below MAX_KEY) from the xorshift generator at
+// 'state'
+static int64 next_key(int64 *state) {
+	return next_random(state) % MAX_KEY;
+}
+
+// the next number of keys to measure at after 'n': alternately 1.5 times and
+// 4/3 times as many, so that there are two measurements per doubling
+static int next_checkpoint(int n) {
+	int next = (n & (n - 1)) == 0 ? n + n / 2 : n + n / 3;
+	return (next > n) ? next : n + 1;
+}
+
+// print a row of measurements of 'table' holding 'nkeys' keys
+static void print_row(const char *type, HashTable *table, int nkeys) {
+	MemoryUsage usage = hash_table_memory_usage(table);
+	size_t total = memory_total(usage);
+	printf("%s,%d,%zu,%.2f,%zu,%zu,%zu,%zu,%zu,%zu\n", type, nkeys, total,
+		(double) total / nkeys, usage.slots, usage.inuse, usage.directory,
+		usage.headers, usage.entries, usage.overhead);
+}
+
+int main(int argc, char **argv) {
+	int maxkeys = (argc > 1) ? atoi(argv[1]) : DEFAULT_MAX_KEYS;
+	int size = (argc > 2) ? atoi(argv[2]) : DEFAULT_SIZE;
+	if (maxkeys <= 0 || size <= 0) {
+		fprintf(stderr, "usage: %s [maxkeys [size]] > memory.csv\n", argv[0]);
+		exit(1);
+	}
+
+	// operation times aren't part of any layout, so don't keep histograms of
+	// them (which would otherwise dwarf the smallest tables)
+	latency_set_sample_period(0);
+
+	printf("type,nkeys,bytes,bytes_per_key,slots,inuse,directory,headers,"
+		"entries,overhead\n");
+
+	int t;
+	for (t = 0; t < NUM_TYPES; t++) {
+		TableType type = strtotype((char *) types[t]);
+		HashTable *table = new_hash_table(type, size);
+		int limit = maxkeys;
+		bool single_key = (type == XTNDBL1 || type == XUCKOO);
+		if (single_key && limit > SINGLE_KEY_MAX_KEYS) {
+			limit = SINGLE_KEY_MAX_KEYS;
+		}
+
+		// every type sees the same keys, in the same order
+		int64 state = XORSHIFT_SEED;
+		int nkeys = 0, checkpoint = 1;
+		while (nkeys < limit) {
+			if (hash_table_insert(table, next_key(&state))) {
+				nkeys++;
+			}
+			if (nkeys == checkpoint || nkeys == limit) {
+				print_row(types[t], table, nkeys);
+				checkpoint = next_checkpoint(checkpoint);
+			}
+		}
+
+		free_hash_table(table);
+	}
+
+	return 0;
+}
@@ -0,0 +1,17 @@
+# plot bytes per key against key count for every table type, from the output
+# of bench/memory (run with: make memory.png)
+
+set datafile separator ","
+set terminal png size 900,600
+set output "memory.png"
+
+set title "memory used per key"
+set xlabel "number of keys"
+set ylabel "bytes per key"
+set logscale x 2
+set key top right
+set grid
+
+types = "linear xtndbl1 cuckoo xtndbln xuckoo xuckoon"
+plot for [type in types] "memory.csv" \
+	using 2:(strcol(1) eq type ? $4 : 1/0) with linespoints title type
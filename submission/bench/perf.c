@@ -0,0 +1,154 @@
+/* * * * * * * * *
+ * Benchmark program counting the hardware events (cache misses, TLB misses,
+ * branch misses, ...) caused by each insertion and lookup, for every type of
+ * hash table
+ *
+ * usage:
+ *   make perf.csv
+ *   ./bench/perf [nkeys [size]] > perf.csv
+ *       nkeys: how many keys to insert into each table (default 2^20, but
+ *              see SINGLE_KEY_MAX_KEYS in bench/memory.c)
+ *       size: initial size to create each table with, as in a2 -s (default 4)
+ *
+ * inserts the keys into a fresh table, then looks each of them up again, then
+ * looks up as many keys that aren't there, counting events over each of these
+ * batches. prints one CSV row per table type per batch, with the events per
+ * operation ("nan" for events this machine can't count: see
+ * /proc/sys/kernel/perf_event_paranoid)
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../latency.h"
+#include "../perfctr.h"
+#include "../xorshift.h"
+
+#define DEFAULT_NKEYS (1 << 20)
+#define DEFAULT_SIZE 4
+
+// the table types to measure, in order
+static const char *types[] = {
+	"linear", "xtndbl1", "cuckoo", "xtndbln", "xuckoo", "xuckoon"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// as in bench/memory.c, the single-key bucket types can only be trusted with
+// this many random keys, and keys are kept below both hash function primes
+#define SINGLE_KEY_MAX_KEYS 8192
+#define MAX_KEY 2147483563
+
+// the batches of operations counted
+typedef enum batch {
+	INSERT, HIT, MISS, NUM_BATCHES
+} Batch;
+static const char *batch_names[NUM_BATCHES] = { "insert", "hit", "miss" };
+
+// the next pseudo-random key (below MAX_KEY) from the xorshift generator at
+// 'state'
+static int64 next_key(int64 *state) {
+	return next_random(state) % MAX_KEY;
+}
+
+// carry out 'batch' on 'table' for each of the 'n' keys in 'keys', counting
+// the events it causes into 'tally'
+static void run_batch(PerfCounters *counters, PerfTally *tally,
+	HashTable *table, Batch batch, int64 *keys, int n) {
+	int i;
+
+	perf_counters_start(counters);
+	if (batch == INSERT) {
+		for (i = 0; i < n; i++) {
+			hash_table_insert(table, keys[i]);
+		}
+	} else {
+		for (i = 0; i < n; i++) {
+			hash_table_lookup(table, keys[i]);
+		}
+	}
+	perf_counters_stop(counters, tally, n);
+}
+
+// print a row of events per operation in 'tally'
+static void print_row(PerfCounters *counters, const char *type, int nkeys,
+	Batch batch, PerfTally *tally) {
+	printf("%s,%d,%s", type, nkeys, batch_names[batch]);
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		if (perf_counter_available(counters, kind)) {
+			printf(",%.3f", perf_tally_per_op(tally, kind));
+		} else {
+			printf(",nan");
+		}
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	int nkeys = (argc > 1) ? atoi(argv[1]) : DEFAULT_NKEYS;
+	int size = (argc > 2) ? atoi(argv[2]) : DEFAULT_SIZE;
+	if (nkeys <= 0 || size <= 0) {
+		fprintf(stderr, "usage: %s [nkeys [size]] > perf.csv\n", argv[0]);
+		exit(1);
+	}
+
+	// the clock reads sampling would do are no part of any table's costs
+	latency_set_sample_period(0);
+
+	PerfCounters counters;
+	if (!perf_counters_open(&counters)) {
+		fprintf(stderr, "no hardware counters available "
+			"(is perf_event_paranoid too high?)\n");
+	}
+
+	// the keys to insert, and then as many more that won't be inserted
+	int64 *keys = malloc(2 * (size_t) nkeys * sizeof *keys);
+	assert(keys);
+	int64 state = XORSHIFT_SEED;
+	int i;
+	for (i = 0; i < 2 * nkeys; i++) {
+		keys[i] = next_key(&state);
+	}
+
+	printf("type,nkeys,op");
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		printf(",%s", perf_counter_name(kind));
+	}
+	printf("\n");
+
+	int t;
+	for (t = 0; t < NUM_TYPES; t++) {
+		TableType type = strtotype((char *) types[t]);
+		HashTable *table = new_hash_table(type, size);
+		int n = nkeys;
+		bool single_key = (type == XTNDBL1 || type == XUCKOO);
+		if (single_key && n > SINGLE_KEY_MAX_KEYS) {
+			n = SINGLE_KEY_MAX_KEYS;
+		}
+
+		// misses come from the far half of the keys, whatever 'n' is
+		Batch batch;
+		for (batch = 0; batch < NUM_BATCHES; batch++) {
+			PerfTally tally;
+			perf_tally_init(&tally);
+			int64 *batch_keys = (batch == MISS) ? keys + nkeys : keys;
+			run_batch(&counters, &tally, table, batch, batch_keys, n);
+			print_row(&counters, types[t], n, batch, &tally);
+		}
+		fflush(stdout);
+
+		free_hash_table(table);
+	}
+
+	perf_counters_close(&counters);
+	free(keys);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/* * * * * * * * *
+ * Benchmark program building hash tables far larger than 2^31 keys, to check
+ * that every size, address and count holds up past 32 bits, and to measure
+ * how lookups slow down once a table is many times the size of the caches
+ * (and, without huge pages, of the TLB's reach)
+ *
+ * usage:
+ *   make scale.csv
+ *   ./bench/scale [nkeys [family [nthreads]]] > scale.csv
+ *       nkeys: how many keys to build each table with (default 3 * 2^30,
+ *              which needs a machine with a few hundred GB of memory: try
+ *              2^24 or so to run it anywhere)
+ *       family: hash function family, as in a2 -f (default mixer)
+ *       nthreads: how many threads to bulk load with (default: one per cpu)
+ *
+ * bulk loads each table type with 'nkeys' random 64-bit keys, then looks up
+ * NLOOKUPS of them, and as many keys that aren't there. prints one CSV row per
+ * table type, with the time taken to build it, the average time per lookup,
+ * and the bytes used per key
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime, sysconf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../memusage.h"
+#include "../latency.h"
+#include "../xorshift.h"
+
+#define DEFAULT_NKEYS (3LL << 30)
+#define DEFAULT_FAMILY "mixer"
+#define BUCKET_SIZE 4
+#define NLOOKUPS (1 << 22)
+
+// the table types to measure, in order. the single-key bucket types are left
+// out: they can't hold this many random keys (see bench/memory.c)
+static const char *types[] = {
+	"linear", "cuckoo", "xtndbln", "xuckoon"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// the current time in seconds, from the monotonic clock
+static double now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// look up each of the 'n' keys in 'keys' in 'table'
+// returns the average number of nanoseconds each lookup took
+static double time_lookups(HashTable *table, int64 *keys, int n) {
+	double start = now();
+	int i, nfound = 0;
+	for (i = 0; i < n; i++) {
+		nfound += hash_table_lookup(table, keys[i]);
+	}
+	double elapsed = now() - start;
+
+	// (using the results, so that no lookup can be optimised away)
+	if (nfound < 0) {
+		printf("impossible\n");
+	}
+	return elapsed * 1e9 / n;
+}
+
+int main(int argc, char **argv) {
+	size64 nkeys = (argc > 1) ? strtoll(argv[1], NULL, 10) : DEFAULT_NKEYS;
+	HashFamily family = strtofamily((argc > 2) ? argv[2] : DEFAULT_FAMILY);
+	int nthreads = (argc > 3) ? atoi(argv[3])
+		: (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (nkeys <= 0 || family == NOFAMILY || nthreads <= 0) {
+		fprintf(stderr, "usage: %s [nkeys [family [nthreads]]] > scale.csv\n",
+			argv[0]);
+		exit(1);
+	}
+
+	// the clock reads sampling would do are no part of any table's costs
+	latency_set_sample_period(0);
+	hash_set_default_family(family);
+
+	// every type gets the same keys. random 64-bit keys almost never repeat,
+	// and are almost never equal to any of the misses either
+	int64 *keys = malloc(nkeys * sizeof *keys);
+	assert(keys);
+	int64 state = XORSHIFT_SEED;
+	size64 i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state);
+	}
+
+	// the lookups: keys picked at random from those inserted, then keys from
+	// another stream, which weren't
+	int nlookups = (nkeys < NLOOKUPS) ? nkeys : NLOOKUPS;
+	int64 *hits = malloc(nlookups * sizeof *hits);
+	int64 *misses = malloc(nlookups * sizeof *misses);
+	assert(hits && misses);
+	int64 other = 0x9e3779b97f4a7c15ULL;
+	int j;
+	for (j = 0; j < nlookups; j++) {
+		hits[j] = keys[next_random(&state) % nkeys];
+		misses[j] = next_random(&other);
+	}
+
+	printf("type,nkeys,family,build_s,hit_ns,miss_ns,bytes_per_key\n");
+
+	int t;
+	for (t = 0; t < NUM_TYPES; t++) {
+		TableType type = strtotype((char *) types[t]);
+
+		double start = now();
+		HashTable *table = hash_table_bulk_load(type, BUCKET_SIZE, keys, nkeys,
+			nthreads);
+		double build_time = now() - start;
+
+		double hit_ns = time_lookups(table, hits, nlookups);
+		double miss_ns = time_lookups(table, misses, nlookups);
+		size_t bytes = memory_total(hash_table_memory_usage(table));
+
+		printf("%s,%lld,%s,%.3f,%.1f,%.1f,%.2f\n", types[t], (long long) nkeys,
+			familytostr(family), build_time, hit_ns, miss_ns,
+			bytes * 1.0 / nkeys);
+		fflush(stdout);
+
+		free_hash_table(table);
+	}
+
+	free(keys);
+	free(hits);
+	free(misses);
+	return 0;
+}
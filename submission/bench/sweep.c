@@ -0,0 +1,218 @@
+/* * * * * * * * *
+ * Benchmark program sweeping every type of hash table over initial sizes (or
+ * bucket sizes), numbers of keys and lookup hit ratios, calling the tables
+ * directly rather than through the interpreter, so as to compare them at a
+ * glance
+ *
+ * usage:
+ *   make bench               (writes bench.csv, with MAXKEYS keys at most)
+ *   ./bench/sweep [maxkeys] > bench.csv
+ *       maxkeys: the most keys to insert into a table (default 10^8, which
+ *                needs a few GB of memory). tables are measured with 10^3,
+ *                10^4, ... keys, up to this many (but see SINGLE_KEY_MAX_KEYS
+ *                in bench/memory.c)
+ *
+ * for each table type, size and number of keys, inserts the keys into a fresh
+ * table (again and again, for small numbers of keys, so that at least MIN_OPS
+ * insertions are timed), then times MIN_OPS lookups of keys picked at random
+ * from those inserted, as many of keys that aren't there, and as many mixing
+ * the two at each hit ratio. prints one CSV row per hit ratio, with the
+ * average nanoseconds per insertion, per lookup of the mix, per hit and per
+ * miss, and the peak resident memory of the process measuring them (which
+ * includes the keys themselves)
+ *
+ * each table type, size and number of keys is measured in a child process of
+ * its own, so that every peak is its own, and so that a table which fails an
+ * assertion only loses its own rows
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime, fork
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../latency.h"
+#include "../xorshift.h"
+
+#define DEFAULT_MAX_KEYS 100000000
+#define MIN_KEYS 1000
+
+// at least how many of each operation are timed
+#define MIN_OPS (1 << 20)
+
+// the table types to measure, in order
+static const char *types[] = {
+	"linear", "xtndbl1", "cuckoo", "xtndbln", "xuckoo", "xuckoon"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// the sizes to create each table with, as in a2 -s (the initial number of
+// slots for linear and cuckoo, and the bucket size for the others)
+static const int sizes[] = { 4, 16, 64 };
+#define NUM_SIZES (sizeof sizes / sizeof *sizes)
+
+// the percentages of lookups which find their key
+static const int hit_percents[] = { 0, 50, 90, 100 };
+#define NUM_HIT_PERCENTS (sizeof hit_percents / sizeof *hit_percents)
+
+// as in bench/memory.c, the single-key bucket types can only be trusted with
+// this many random keys, and their keys are kept below both hash function
+// primes
+#define SINGLE_KEY_MAX_KEYS 8192
+#define MAX_KEY 2147483563
+
+// the current time in nanoseconds, from the monotonic clock
+static int64 now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// look up each of the 'n' keys in 'keys' in 'table'
+// returns the average number of nanoseconds each lookup took
+static double time_lookups(HashTable *table, int64 *keys, int n) {
+	int64 start = now();
+	int i, nfound = 0;
+	for (i = 0; i < n; i++) {
+		nfound += hash_table_lookup(table, keys[i]);
+	}
+	int64 elapsed = now() - start;
+
+	// (using the results, so that no lookup can be optimised away)
+	if (nfound < 0) {
+		printf("impossible\n");
+	}
+	return (double) elapsed / n;
+}
+
+// measure a table of type 'type' with size 'size' and 'nkeys' keys, printing
+// a row for each hit ratio
+static void measure(TableType type, const char *name, int size, int nkeys) {
+	// the keys to insert, and the keys to look up (hits are inserted keys
+	// picked at random, misses are keys from another stream)
+	bool single_key = (type == XTNDBL1 || type == XUCKOO);
+	int64 *keys = malloc((size_t) nkeys * sizeof *keys);
+	int64 *hits = malloc(MIN_OPS * sizeof *hits);
+	int64 *misses = malloc(MIN_OPS * sizeof *misses);
+	int64 *mixed = malloc(MIN_OPS * sizeof *mixed);
+	assert(keys && hits && misses && mixed);
+	int64 state = XORSHIFT_SEED;
+	int64 other = 0x9e3779b97f4a7c15ULL;
+	int i;
+	for (i = 0; i < nkeys; i++) {
+		keys[i] = next_random(&state);
+		if (single_key) {
+			keys[i] %= MAX_KEY;
+		}
+	}
+	for (i = 0; i < MIN_OPS; i++) {
+		hits[i] = keys[next_random(&state) % nkeys];
+		misses[i] = next_random(&other);
+		if (single_key) {
+			misses[i] %= MAX_KEY;
+		}
+	}
+
+	// insert the keys into as many fresh tables as it takes to time MIN_OPS
+	// insertions, keeping the last
+	HashTable *table = NULL;
+	int64 elapsed = 0;
+	int rounds = (MIN_OPS + nkeys - 1) / nkeys, r;
+	for (r = 0; r < rounds; r++) {
+		if (table) {
+			free_hash_table(table);
+		}
+		table = new_hash_table(type, size);
+		int64 start = now();
+		for (i = 0; i < nkeys; i++) {
+			hash_table_insert(table, keys[i]);
+		}
+		elapsed += now() - start;
+	}
+	double insert_ns = (double) elapsed / ((double) rounds * nkeys);
+
+	double hit_ns = time_lookups(table, hits, MIN_OPS);
+	double miss_ns = time_lookups(table, misses, MIN_OPS);
+
+	int p;
+	for (p = 0; p < NUM_HIT_PERCENTS; p++) {
+		for (i = 0; i < MIN_OPS; i++) {
+			bool hit = next_random(&state) % 100 < hit_percents[p];
+			mixed[i] = hit ? hits[i] : misses[i];
+		}
+		double lookup_ns = time_lookups(table, mixed, MIN_OPS);
+
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		printf("%s,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%ld\n", name, size, nkeys,
+			hit_percents[p], insert_ns, lookup_ns, hit_ns, miss_ns,
+			usage.ru_maxrss);
+	}
+	fflush(stdout);
+
+	free_hash_table(table);
+	free(keys);
+	free(hits);
+	free(misses);
+	free(mixed);
+}
+
+int main(int argc, char **argv) {
+	int max_keys = (argc > 1) ? atoi(argv[1]) : DEFAULT_MAX_KEYS;
+	if (max_keys < MIN_KEYS) {
+		fprintf(stderr, "usage: %s [maxkeys] > bench.csv (maxkeys >= %d)\n",
+			argv[0], MIN_KEYS);
+		exit(1);
+	}
+
+	// the clock reads sampling would do are no part of any table's costs
+	latency_set_sample_period(0);
+
+	printf("type,size,nkeys,hit_pct,insert_ns,lookup_ns,hit_ns,miss_ns,"
+		"peak_rss_kb\n");
+	fflush(stdout);
+
+	int t, s;
+	for (t = 0; t < NUM_TYPES; t++) {
+		TableType type = strtotype((char *) types[t]);
+		bool single_key = (type == XTNDBL1 || type == XUCKOO);
+		for (s = 0; s < NUM_SIZES; s++) {
+			int nkeys;
+			for (nkeys = MIN_KEYS; nkeys <= max_keys; nkeys *= 10) {
+				if (single_key && nkeys > SINGLE_KEY_MAX_KEYS) {
+					break;
+				}
+
+				pid_t child = fork();
+				assert(child >= 0);
+				if (child == 0) {
+					measure(type, types[t], sizes[s], nkeys);
+					exit(0);
+				}
+				int status;
+				waitpid(child, &status, 0);
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					fprintf(stderr, "%s with size %d and %d keys failed\n",
+						types[t], sizes[s], nkeys);
+				}
+
+				// (the next power of ten mustn't overflow)
+				if (nkeys > max_keys / 10) {
+					break;
+				}
+			}
+		}
+	}
+	return 0;
+}
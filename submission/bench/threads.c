@@ -0,0 +1,222 @@
+/* * * * * * * * *
+ * Benchmark program measuring how insertion and lookup throughput of a
+ * sharded hash table, or of the lock-free table, scale with the number of
+ * threads using it at once
+ *
+ * usage:
+ *   make threads.csv          (or make threads.png, to plot it with gnuplot)
+ *   ./bench/threads [type [nkeys [nshards]]] > threads.csv
+ *       type: which type of table to shard, as in a2 -t, or "lockfree" for
+ *             the lock-free table (default: each of linear, cuckoo, xtndbln,
+ *             xuckoon, auto and lockfree in turn)
+ *       nkeys: how many keys to insert (default 2^20)
+ *       nshards: how many shards to split the table into (default 64, and
+ *                reported as 0 for the lock-free table, which has none)
+ *
+ * for 1, 2, 4, ..., 64 threads, builds a fresh table by having the threads
+ * insert their share of the keys, then has them look up twice as many keys
+ * (half of which are in the table). prints one CSV row per table type per
+ * thread count, with throughput in millions of operations per second
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime, pthread_barrier_t
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>  // for strcmp
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../shardtbl.h"
+#include "../tables/lockfree.h"
+#include "../xorshift.h"
+
+#define DEFAULT_NKEYS (1 << 20)
+#define DEFAULT_NSHARDS 64
+#define DEFAULT_SIZE 4
+#define MAX_THREADS 64
+
+// the table types to measure by default. the single-key bucket types are left
+// out: they can't hold this many random keys (see bench/memory.c)
+static const char *types[] = {
+	"linear", "cuckoo", "xtndbln", "xuckoon", "auto", "lockfree"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// which operation the threads are running
+typedef enum phase {
+	INSERT, LOOKUP
+} Phase;
+
+// the table being measured: one of these is NULL
+typedef struct target {
+	ShardedHashTable *sharded;
+	LockFreeHashTable *lockfree;
+} Target;
+
+// the work given to each thread: a contiguous share of the keys
+typedef struct worker {
+	Target *target;
+	pthread_barrier_t *start;	// so that every thread starts together
+	Phase phase;
+	int64 *keys;				// this thread's keys
+	int n;						// how many of them
+	int nfound;					// how many lookups found their key
+} Worker;
+
+// the current time, in seconds
+static double now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// insert 'key' into 'target'
+static void target_insert(Target *target, int64 key) {
+	if (target->lockfree != NULL) {
+		lockfree_hash_table_insert(target->lockfree, key);
+	} else {
+		sharded_hash_table_insert(target->sharded, key);
+	}
+}
+
+// lookup whether 'key' is inside 'target'
+static bool target_lookup(Target *target, int64 key) {
+	if (target->lockfree != NULL) {
+		return lockfree_hash_table_lookup(target->lockfree, key);
+	}
+	return sharded_hash_table_lookup(target->sharded, key);
+}
+
+// run one thread's share of the current phase
+static void *run_worker(void *arg) {
+	Worker *worker = arg;
+	pthread_barrier_wait(worker->start);
+
+	int i;
+	for (i = 0; i < worker->n; i++) {
+		if (worker->phase == INSERT) {
+			target_insert(worker->target, worker->keys[i]);
+		} else if (target_lookup(worker->target, worker->keys[i])) {
+			worker->nfound++;
+		}
+	}
+
+	return NULL;
+}
+
+// have 'nthreads' threads carry out 'phase' on the 'n' keys in 'keys' in
+// 'target', each taking an equal share of them
+// returns how many seconds they took, altogether
+static double run_phase(Target *target, Phase phase, int64 *keys, int n,
+	int nthreads) {
+	pthread_t threads[MAX_THREADS];
+	Worker workers[MAX_THREADS];
+	pthread_barrier_t start;
+	pthread_barrier_init(&start, NULL, nthreads + 1);
+
+	int t;
+	for (t = 0; t < nthreads; t++) {
+		int first = (long) n * t / nthreads;
+		int last = (long) n * (t + 1) / nthreads;
+		Worker worker = { .target = target, .start = &start, .phase = phase,
+			.keys = keys + first, .n = last - first, .nfound = 0 };
+		workers[t] = worker;
+		int error = pthread_create(&threads[t], NULL, run_worker, &workers[t]);
+		assert(error == 0);
+	}
+
+	// the clock starts once every thread is ready to go
+	pthread_barrier_wait(&start);
+	double start_time = now();
+	for (t = 0; t < nthreads; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	double elapsed = now() - start_time;
+
+	pthread_barrier_destroy(&start);
+	return elapsed;
+}
+
+// is 'name' the name of the lock-free table, rather than a table type?
+static bool is_lockfree(const char *name) {
+	return strcmp(name, "lockfree") == 0;
+}
+
+// measure 'type' for every thread count, printing a row for each
+static void measure(const char *name, int64 *keys, int nkeys, int nshards) {
+	bool lockfree = is_lockfree(name);
+	TableType type = strtotype((char *) name);
+	assert(lockfree || type != NOTYPE);
+
+	int nthreads;
+	for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+		Target target = { NULL, NULL };
+		if (lockfree) {
+			target.lockfree = new_lockfree_hash_table(DEFAULT_SIZE);
+		} else {
+			target.sharded = new_sharded_hash_table(type, DEFAULT_SIZE,
+				nshards);
+		}
+
+		// the first half of the keys go in, then all of them are looked up
+		double insert_time = run_phase(&target, INSERT, keys, nkeys, nthreads);
+		double lookup_time = run_phase(&target, LOOKUP, keys, 2 * nkeys,
+			nthreads);
+
+		printf("%s,%d,%d,%.3f,%.3f\n", name, nthreads, lockfree ? 0 : nshards,
+			nkeys / insert_time / 1e6, 2 * nkeys / lookup_time / 1e6);
+		fflush(stdout);
+
+		if (lockfree) {
+			free_lockfree_hash_table(target.lockfree);
+		} else {
+			free_sharded_hash_table(target.sharded);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const char *type = (argc > 1) ? argv[1] : NULL;
+	int nkeys = (argc > 2) ? atoi(argv[2]) : DEFAULT_NKEYS;
+	int nshards = (argc > 3) ? atoi(argv[3]) : DEFAULT_NSHARDS;
+	if ((type != NULL && strtotype((char *) type) == NOTYPE
+		&& !is_lockfree(type)) || nkeys <= 0
+		|| nshards <= 0 || nshards > MAX_SHARDS
+		|| (nshards & (nshards - 1)) != 0) {
+		fprintf(stderr, "usage: %s [type [nkeys [nshards]]] > threads.csv\n",
+			argv[0]);
+		fprintf(stderr, "(nshards must be a power of two, up to %d)\n",
+			MAX_SHARDS);
+		exit(1);
+	}
+
+	// every type sees the same keys, in the same order
+	int64 *keys = malloc(2 * (size_t) nkeys * sizeof *keys);
+	assert(keys);
+	int64 state = XORSHIFT_SEED;
+	int i;
+	for (i = 0; i < 2 * nkeys; i++) {
+		keys[i] = next_random(&state);
+	}
+
+	printf("type,threads,shards,insert_mops,lookup_mops\n");
+
+	if (type != NULL) {
+		measure(type, keys, nkeys, nshards);
+	} else {
+		for (i = 0; i < NUM_TYPES; i++) {
+			measure(types[i], keys, nkeys, nshards);
+		}
+	}
+
+	free(keys);
+	return 0;
+}
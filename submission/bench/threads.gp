@@ -0,0 +1,25 @@
+# plot insertion and lookup throughput against thread count for every table
+# type, from the output of bench/threads (run with: make threads.png)
+
+set datafile separator ","
+set terminal png size 1200,500
+set output "threads.png"
+
+set xlabel "number of threads"
+set ylabel "millions of operations per second"
+set logscale x 2
+set key top left
+set grid
+
+types = "linear cuckoo xtndbln xuckoon auto lockfree"
+set multiplot layout 1,2
+
+set title "insertion throughput"
+plot for [type in types] "threads.csv" \
+	using 2:(strcol(1) eq type ? $4 : 1/0) with linespoints title type
+
+set title "lookup throughput"
+plot for [type in types] "threads.csv" \
+	using 2:(strcol(1) eq type ? $5 : 1/0) with linespoints title type
+
+unset multiplot
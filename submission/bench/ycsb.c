@@ -0,0 +1,377 @@
+/* * * * * * * * *
+ * Benchmark program running the standard YCSB workloads A to F (adapted from
+ * a database's records to a table's keys and values) against every type of
+ * hash table, as a repeatable way to choose between them
+ *
+ * usage:
+ *   make ycsb.csv
+ *   ./bench/ycsb [nrecords [nops [size]]] > ycsb.csv
+ *       nrecords: how many records to load each table with before each
+ *                 workload (default 2^20, but see SINGLE_KEY_MAX_RECORDS)
+ *       nops: how many operations each workload carries out (default 2^21)
+ *       size: initial size to create each table with, as in a2 -s (default 4)
+ *
+ * a record is a key with a value. for every table type and every workload, a
+ * fresh table is loaded with 'nrecords' records (hash_table_put()), then the
+ * workload's operations are carried out on it:
+ *
+ *   workload  mix                           records chosen
+ *   A         50% read, 50% update          zipfian
+ *   B         95% read, 5% update           zipfian
+ *   C         100% read                     zipfian
+ *   D         95% read, 5% insert           latest (newest records hottest)
+ *   E         95% scan, 5% insert           zipfian (for the first record)
+ *   F         50% read, 50% read-modify-write  zipfian
+ *
+ * a read is hash_table_get(), an update is hash_table_update(), an insert is
+ * hash_table_put() of a new record, and a read-modify-write changes a value in
+ * place through hash_table_find_value(). tables keep no order among their
+ * keys, so a scan reads a run of up to MAX_SCAN_LENGTH records in the order
+ * they were inserted (as YCSB's hashed keys do), one lookup each. zipfian
+ * records are chosen as in YCSB, with the popular ones scattered among the
+ * rest rather than all inserted together
+ *
+ * prints one CSV row per table type per workload (and one for loading the
+ * table), with the throughput, and the percentiles of the time taken by one
+ * in every SAMPLE_PERIOD operations (the clock reads add a little to the
+ * throughput's time too)
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../latency.h"
+#include "../xorshift.h"
+
+#define DEFAULT_NRECORDS (1 << 20)
+#define DEFAULT_NOPS (1 << 21)
+#define DEFAULT_SIZE 4
+
+// the table types to measure, in order
+static const char *types[] = {
+	"linear", "xtndbl1", "cuckoo", "xtndbln", "xuckoo", "xuckoon", "auto"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// as in bench/memory.c, the single-key bucket types can only be trusted with
+// so many random keys, and keys are kept below both hash function primes. so
+// for those types, the records (and operations, 5% of which may insert more
+// records) are capped at these
+#define SINGLE_KEY_MAX_RECORDS 4096
+#define SINGLE_KEY_MAX_OPS 32768
+#define MAX_KEY 2147483563
+
+// YCSB's defaults: the skew of the zipfian distribution, and the longest scan
+#define ZIPF_THETA 0.99
+#define MAX_SCAN_LENGTH 100
+
+// one in how many operations is timed
+#define SAMPLE_PERIOD 16
+
+// how the records operated on are chosen
+typedef enum distribution {
+	ZIPFIAN,	// a few popular records, scattered among the rest
+	LATEST		// the most recently inserted records are the most popular
+} Distribution;
+
+// a workload: percentages of each kind of operation, and how records are chosen
+typedef struct workload {
+	const char *name;
+	int read, update, insert, scan, rmw;
+	Distribution distribution;
+} Workload;
+
+// the workloads, in order
+static const Workload workloads[] = {
+	{ "A", 50, 50,  0,  0,  0, ZIPFIAN },
+	{ "B", 95,  5,  0,  0,  0, ZIPFIAN },
+	{ "C", 100, 0,  0,  0,  0, ZIPFIAN },
+	{ "D", 95,  0,  5,  0,  0, LATEST },
+	{ "E",  0,  0,  5, 95,  0, ZIPFIAN },
+	{ "F", 50,  0,  0,  0, 50, ZIPFIAN }
+};
+#define NUM_WORKLOADS (sizeof workloads / sizeof *workloads)
+
+// zipf-distributed ranks in [1, n], where the chance of rank k is proportional
+// to 1/k^theta, drawn by rejection-inversion (Hormann and Derflinger), which
+// needs no table of the n probabilities
+typedef struct zipf {
+	double n, theta;
+	double hx1, hn, s;	// constants of the method, from zipf_init()
+} Zipf;
+
+// the state of a run: the records so far, and the random number generators
+typedef struct run {
+	HashTable *table;
+	int64 *keys;		// record i has key keys[i]
+	int nrecords;		// how many records have been inserted
+	int64 state;		// the xorshift generator's state
+	Zipf zipf;			// over the records loaded before the workload began
+	int64 *samples;		// the times taken by the operations timed, in ns
+	int nsamples;
+	size64 nfound;		// how many lookups found their key (so that none
+						// can be optimised away)
+} Run;
+
+
+/* * * *
+ * random numbers
+ */
+
+// a pseudo-random number in [0, 1) from the generator at 'state'
+static double next_unit(int64 *state) {
+	return (next_random(state) >> 11) * (1.0 / (1ULL << 53));
+}
+
+// log(1 + x) / x, accurately even when x is near 0
+static double log1p_over(double x) {
+	return (fabs(x) > 1e-8) ? log1p(x) / x : 1 - x * (0.5 - x * (1.0/3 - x/4));
+}
+
+// (e^x - 1) / x, accurately even when x is near 0
+static double expm1_over(double x) {
+	return (fabs(x) > 1e-8) ? expm1(x) / x
+		: 1 + x * 0.5 * (1 + x * (1.0/3) * (1 + x/4));
+}
+
+// the density h of the zipf distribution 'zipf', its integral H, and the
+// inverse of H
+static double zipf_h(Zipf *zipf, double x) {
+	return exp(-zipf->theta * log(x));
+}
+static double zipf_h_integral(Zipf *zipf, double x) {
+	double log_x = log(x);
+	return expm1_over((1 - zipf->theta) * log_x) * log_x;
+}
+static double zipf_h_integral_inverse(Zipf *zipf, double x) {
+	double t = x * (1 - zipf->theta);
+	if (t < -1) {
+		t = -1;
+	}
+	return exp(log1p_over(t) * x);
+}
+
+// set up 'zipf' to draw ranks in [1, n] with skew 'theta'
+static void zipf_init(Zipf *zipf, double n, double theta) {
+	zipf->n = n;
+	zipf->theta = theta;
+	zipf->hx1 = zipf_h_integral(zipf, 1.5) - 1;
+	zipf->hn = zipf_h_integral(zipf, n + 0.5);
+	zipf->s = 2 - zipf_h_integral_inverse(zipf,
+		zipf_h_integral(zipf, 2.5) - zipf_h(zipf, 2));
+}
+
+// the next rank from 'zipf', using the generator at 'state'
+static int64 zipf_next(Zipf *zipf, int64 *state) {
+	while (true) {
+		double u = zipf->hn + next_unit(state) * (zipf->hx1 - zipf->hn);
+		double x = zipf_h_integral_inverse(zipf, u);
+		double k = floor(x + 0.5);
+		if (k < 1) {
+			k = 1;
+		} else if (k > zipf->n) {
+			k = zipf->n;
+		}
+		if (k - x <= zipf->s
+			|| u >= zipf_h_integral(zipf, k + 0.5) - zipf_h(zipf, k)) {
+			return (int64) k;
+		}
+	}
+}
+
+// scramble the bits of 'x' (the finaliser of splitmix64), so that popular
+// ranks land on records scattered through the order they were inserted in
+static int64 scramble(int64 x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+// the next record for 'run' to operate on, from 'distribution'
+static int next_record(Run *run, Distribution distribution) {
+	int64 rank = zipf_next(&run->zipf, &run->state);
+	if (distribution == LATEST) {
+		// (ranks only go up to the records loaded, so this is always one)
+		return run->nrecords - rank;
+	}
+	return scramble(rank) % run->nrecords;
+}
+
+
+/* * * *
+ * running workloads
+ */
+
+// the current time in nanoseconds, from the monotonic clock
+static int64 now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// insert a new record into the table of 'run'
+static void insert_record(Run *run) {
+	int record = run->nrecords++;
+	hash_table_put(run->table, run->keys[record], record);
+}
+
+// carry out one operation from 'workload' on the table of 'run'
+static void run_operation(Run *run, const Workload *workload) {
+	int choice = next_random(&run->state) % 100;
+	int64 value;
+
+	if ((choice -= workload->read) < 0) {
+		int record = next_record(run, workload->distribution);
+		run->nfound += hash_table_get(run->table, run->keys[record], &value);
+
+	} else if ((choice -= workload->update) < 0) {
+		int record = next_record(run, workload->distribution);
+		hash_table_update(run->table, run->keys[record], run->state);
+
+	} else if ((choice -= workload->insert) < 0) {
+		insert_record(run);
+
+	} else if ((choice -= workload->scan) < 0) {
+		int record = next_record(run, workload->distribution);
+		int length = 1 + next_random(&run->state) % MAX_SCAN_LENGTH;
+		int end = (record + length < run->nrecords)
+			? record + length : run->nrecords;
+		for (; record < end; record++) {
+			run->nfound += hash_table_get(run->table, run->keys[record],
+				&value);
+		}
+
+	} else {
+		int record = next_record(run, workload->distribution);
+		int64 *found = hash_table_find_value(run->table, run->keys[record]);
+		if (found) {
+			*found += 1;
+		}
+	}
+}
+
+// carry out 'nops' operations on the table of 'run', each of them from
+// 'workload', or (if 'workload' is NULL) inserting a new record, timing one
+// in every SAMPLE_PERIOD into run->samples
+// returns how many seconds they took altogether
+static double run_operations(Run *run, const Workload *workload, int nops) {
+	run->nsamples = 0;
+	int64 begin = now();
+	int i;
+	for (i = 0; i < nops; i++) {
+		int64 start = (i % SAMPLE_PERIOD == 0) ? now() : 0;
+
+		if (workload) {
+			run_operation(run, workload);
+		} else {
+			insert_record(run);
+		}
+
+		if (start) {
+			run->samples[run->nsamples++] = now() - start;
+		}
+	}
+	return (now() - begin) / 1e9;
+}
+
+// compare two times, for sorting
+static int compare_times(const void *a, const void *b) {
+	int64 x = *(const int64 *) a, y = *(const int64 *) b;
+	return (x > y) - (x < y);
+}
+
+// print a row for 'nops' operations of workload 'name' carried out on a table
+// of type 'type' loaded with 'nrecords', which took 'seconds' altogether and
+// whose samples are in 'run'
+static void print_row(Run *run, const char *name, const char *type,
+	int nrecords, int nops, double seconds) {
+	qsort(run->samples, run->nsamples, sizeof *run->samples, compare_times);
+	int n = run->nsamples;
+	printf("%s,%s,%d,%d,%.3f,%.3f,%lld,%lld,%lld\n", name, type, nrecords,
+		nops, seconds, nops / seconds / 1e6,
+		(long long) run->samples[n / 2],
+		(long long) run->samples[(int) (n * 0.99)],
+		(long long) run->samples[(int) (n * 0.999)]);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	int nrecords = (argc > 1) ? atoi(argv[1]) : DEFAULT_NRECORDS;
+	int nops = (argc > 2) ? atoi(argv[2]) : DEFAULT_NOPS;
+	int size = (argc > 3) ? atoi(argv[3]) : DEFAULT_SIZE;
+	if (nrecords <= 0 || nops <= 0 || size <= 0) {
+		fprintf(stderr, "usage: %s [nrecords [nops [size]]] > ycsb.csv\n",
+			argv[0]);
+		exit(1);
+	}
+
+	// the clock reads sampling would do are no part of any table's costs
+	latency_set_sample_period(0);
+
+	// the keys of every record there could be: those loaded, and those each
+	// operation might insert. every table type and workload gets the same
+	Run run;
+	run.keys = malloc(((size_t) nrecords + nops) * sizeof *run.keys);
+	int nsamples = (nrecords > nops ? nrecords : nops) / SAMPLE_PERIOD + 1;
+	run.samples = malloc(nsamples * sizeof *run.samples);
+	assert(run.keys && run.samples);
+	int64 state = XORSHIFT_SEED;
+	int i;
+	for (i = 0; i < nrecords + nops; i++) {
+		run.keys[i] = next_random(&state) % MAX_KEY;
+	}
+	run.nfound = 0;
+
+	printf("workload,type,nrecords,nops,seconds,mops_per_s,"
+		"p50_ns,p99_ns,p999_ns\n");
+
+	int t, w;
+	for (t = 0; t < NUM_TYPES; t++) {
+		TableType type = strtotype((char *) types[t]);
+		int n = nrecords, ops = nops;
+		if (type == XTNDBL1 || type == XUCKOO) {
+			n = (n < SINGLE_KEY_MAX_RECORDS) ? n : SINGLE_KEY_MAX_RECORDS;
+			ops = (ops < SINGLE_KEY_MAX_OPS) ? ops : SINGLE_KEY_MAX_OPS;
+		}
+
+		for (w = 0; w < NUM_WORKLOADS; w++) {
+			// every workload starts from the same freshly loaded table, and
+			// the same random numbers
+			run.table = new_hash_table(type, size);
+			run.nrecords = 0;
+			double seconds = run_operations(&run, NULL, n);
+			if (w == 0) {
+				print_row(&run, "load", types[t], n, n, seconds);
+			}
+
+			run.state = 0x9e3779b97f4a7c15ULL;
+			zipf_init(&run.zipf, n, ZIPF_THETA);
+			seconds = run_operations(&run, &workloads[w], ops);
+			print_row(&run, workloads[w].name, types[t], n, ops, seconds);
+
+			free_hash_table(run.table);
+		}
+	}
+
+	// (using the results, so that no lookup can be optimised away)
+	if (run.nfound < 0) {
+		printf("impossible\n");
+	}
+	free(run.keys);
+	free(run.samples);
+	return 0;
+}
@@ -1,34 +1,80 @@
 /* * * * * * * * *
  * Utility program that generates random input and lookup commands for
  * the hash table interpreter program
- * 
+ *
  * usage:
  *   make cmdgen
- *   ./cmdgen ninserts nlookups > commandfilename
+ *   ./cmdgen [options] ninserts nlookups [string|collide] [binary]
+ *       > commandfilename
  *       ninserts: number of insert commands to generate
  *       nlookups: number of lookup commands to generate
+ *       string: generate byte-string keys (for a2 -k string) instead of
+ *               integers
+ *       collide: generate integer keys that all collide under h1(), as an
+ *                attacker would (see collidingkeys())
+ *       binary: write integer commands in binary (see cmdinput.h), which a2
+ *               reads without any parsing
  *       commandfilename: name of file to store commands in
+ *   options:
+ *       -d dist: how inserted keys are distributed over the key space:
+ *                uniform (the default), zipf, sequential, strided or
+ *                clustered (see nextkey())
+ *       -k n: draw keys from [0, n) (default 100 * ninserts + 1, or 0 for
+ *             all 2^64 keys)
+ *       -z theta: skew of the zipf distribution (default 0.99)
+ *       -w n: distance between strided keys (default 4096)
+ *       -c n: length of each run of clustered keys (default 64)
+ *       -h percent: how many lookups are for keys already inserted
+ *                   (default 50)
+ *       -x n: also generate n delete commands, for keys already inserted
+ *       -i: interleave the commands at random, rather than generating all
+ *           inserts first, then lookups, then deletes
+ *       -s seed: seed the random number generator (default: the time, which
+ *                is printed to stderr so that the commands can be generated
+ *                again)
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Shreyash Patodia and Matt Farrugia
- * 
+ *
  * modifications by ...
  */
 
+#define _POSIX_C_SOURCE 200809L  /* for getopt */
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "inthash.h"
+#include "cmdinput.h"
+#include "xorshift.h"
 
 /*************************************************************************/
 
 void printusageexit(char *exe) {
 	/* Print usage information: */
-	fprintf(stderr, "usage: %s ninserts nlookups > commandfilename\n", exe);
+	fprintf(stderr, "usage: %s [options] ninserts nlookups [string|collide] "
+		"[binary] > commandfilename\n", exe);
 	fprintf(stderr, " ninserts: number of insert commands to generate\n");
 	fprintf(stderr, " nlookups: number of lookup commands to generate\n");
+	fprintf(stderr, " string: generate string keys instead of integers\n");
+	fprintf(stderr, " collide: generate keys that all collide under h1\n");
+	fprintf(stderr, " binary: write integer commands in binary form\n");
 	fprintf(stderr, " commandfilename: name of file to store commands in\n");
+	fprintf(stderr, "options:\n");
+	fprintf(stderr, " -d dist: key distribution: uniform, zipf, sequential, "
+		"strided or clustered\n");
+	fprintf(stderr, " -k n: draw keys from [0, n) (0 for all 64-bit keys)\n");
+	fprintf(stderr, " -z theta: skew of the zipf distribution\n");
+	fprintf(stderr, " -w n: distance between strided keys\n");
+	fprintf(stderr, " -c n: length of each run of clustered keys\n");
+	fprintf(stderr, " -h percent: percentage of lookups that should hit\n");
+	fprintf(stderr, " -x n: number of delete commands to generate\n");
+	fprintf(stderr, " -i: interleave inserts, lookups and deletes\n");
+	fprintf(stderr, " -s seed: seed for the random number generator\n");
 
 	/* and exit, as promised :) */
 	exit(1);
@@ -36,53 +82,438 @@ void printusageexit(char *exe) {
 
 /*************************************************************************/
 
+/* The random number generator (see xorshift.h), seeded with seedrandom().
+ * Unlike rand(), it gives all 64 bits, and the same numbers on every
+ * machine. */
+static int64 randomstate;
+
+void seedrandom(int64 seed) {
+	/* Any seed but 0 works; spread the bits of small seeds out first. */
+	randomstate = (seed ^ 0x9e3779b97f4a7c15ULL) * 0xbf58476d1ce4e5b9ULL;
+	if (randomstate == 0) {
+		randomstate = 1;
+	}
+}
+
+int64 nextrandom() {
+	return next_random(&randomstate);
+}
+
+/* A random number in [0, n), or any 64-bit number if n is 0. */
+int64 randombelow(int64 n) {
+	return (n == 0) ? nextrandom() : nextrandom() % n;
+}
+
+/* A random number in [0, 1). */
+double randomunit() {
+	return (nextrandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*************************************************************************/
+
+/* Zipf-distributed numbers in [1, n], where the chance of k is proportional
+ * to 1 / k^theta, by rejection-inversion sampling (Hormann and Derflinger,
+ * 1996), which takes about the same time for any n, however large. */
+typedef struct zipf {
+	double n, theta;
+	double hx1, hn, s;	/* constants of the method, from zipfsetup() */
+} Zipf;
+
+/* log(1 + x) / x and (e^x - 1) / x, accurately even when x is near 0. */
+double helper1(double x) {
+	return (fabs(x) > 1e-8) ? log1p(x) / x : 1 - x * (0.5 - x * (1.0/3 - x/4));
+}
+double helper2(double x) {
+	return (fabs(x) > 1e-8) ? expm1(x) / x
+		: 1 + x * 0.5 * (1 + x * (1.0/3) * (1 + x/4));
+}
+
+/* The density h, its integral H, and the inverse of H. */
+double zipfh(Zipf *zipf, double x) {
+	return exp(-zipf->theta * log(x));
+}
+double zipfhintegral(Zipf *zipf, double x) {
+	double logx = log(x);
+	return helper2((1 - zipf->theta) * logx) * logx;
+}
+double zipfhintegralinverse(Zipf *zipf, double x) {
+	double t = x * (1 - zipf->theta);
+	if (t < -1) {
+		t = -1;
+	}
+	return exp(helper1(t) * x);
+}
+
+void zipfsetup(Zipf *zipf, double n, double theta) {
+	zipf->n = n;
+	zipf->theta = theta;
+	zipf->hx1 = zipfhintegral(zipf, 1.5) - 1;
+	zipf->hn = zipfhintegral(zipf, n + 0.5);
+	zipf->s = 2 - zipfhintegralinverse(zipf,
+		zipfhintegral(zipf, 2.5) - zipfh(zipf, 2));
+}
+
+int64 zipfnext(Zipf *zipf) {
+	while (1) {
+		double u = zipf->hn + randomunit() * (zipf->hx1 - zipf->hn);
+		double x = zipfhintegralinverse(zipf, u);
+		double k = floor(x + 0.5);
+		if (k < 1) {
+			k = 1;
+		} else if (k > zipf->n) {
+			k = zipf->n;
+		}
+		if (k - x <= zipf->s
+			|| u >= zipfhintegral(zipf, k + 0.5) - zipfh(zipf, k)) {
+			return (int64) k;
+		}
+	}
+}
+
+/*************************************************************************/
+
+/* How inserted keys are spread over the key space. */
+#define UNIFORM    0	/* each key equally likely */
+#define ZIPF       1	/* a few hot keys, and a long tail of cold ones */
+#define SEQUENTIAL 2	/* 0, 1, 2, ... */
+#define STRIDED    3	/* 0, w, 2w, ... (wrapping around the key space) */
+#define CLUSTERED  4	/* runs of consecutive keys, from random starts */
+const char *distnames[] = {
+	"uniform", "zipf", "sequential", "strided", "clustered", NULL
+};
+
+/* Everything deciding which keys are generated. */
+typedef struct workload {
+	int dist;
+	int64 keyspace;		/* keys are below this (or any 64-bit key, if 0) */
+	int64 stride;		/* for STRIDED */
+	int64 clusterlen;	/* for CLUSTERED */
+	Zipf zipf;			/* for ZIPF */
+	int64 count;		/* how many keys have been generated */
+	int64 clusterstart;	/* the start of the current run, for CLUSTERED */
+} Workload;
+
+/* Scramble the bits of x (a bijection on 64-bit numbers), so that the hot
+ * zipf keys aren't simply the smallest ones. */
+int64 scramble(int64 x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/* Generate the next key to insert, following the workload's distribution. */
+int64 nextkey(Workload *w) {
+	int64 i = w->count++;
+	int64 key;
+	switch (w->dist) {
+		case ZIPF:
+			key = scramble(zipfnext(&w->zipf));
+			break;
+		case SEQUENTIAL:
+			key = i;
+			break;
+		case STRIDED:
+			key = i * w->stride;
+			break;
+		case CLUSTERED:
+			if (i % w->clusterlen == 0) {
+				w->clusterstart = nextrandom();
+			}
+			key = w->clusterstart + i % w->clusterlen;
+			break;
+		default:
+			key = nextrandom();
+			break;
+	}
+	return (w->keyspace == 0) ? key : key % w->keyspace;
+}
+
+/*************************************************************************/
+
+/* A set of the keys inserted so far, so that lookups meant to miss can avoid
+ * them (open addressing with linear probing; no key is ever removed). */
+typedef struct keyset {
+	int64 *slots;
+	char *used;
+	int64 mask;		/* the number of slots, minus one (a power of two) */
+} KeySet;
+
+void keysetinit(KeySet *set, int64 nkeys) {
+	int64 size = 2;
+	while (size < 2 * nkeys) {
+		size *= 2;
+	}
+	set->slots = malloc(sizeof (int64) * size);
+	set->used = calloc(size, 1);
+	set->mask = size - 1;
+}
+
+/* Find the slot where key is, or would go. */
+int64 keysetslot(KeySet *set, int64 key) {
+	int64 i = scramble(key) & set->mask;
+	while (set->used[i] && set->slots[i] != key) {
+		i = (i + 1) & set->mask;
+	}
+	return i;
+}
+
+void keysetadd(KeySet *set, int64 key) {
+	int64 i = keysetslot(set, key);
+	set->used[i] = 1;
+	set->slots[i] = key;
+}
+
+int keysethas(KeySet *set, int64 key) {
+	return set->used[keysetslot(set, key)];
+}
+
+/*************************************************************************/
+
+/* String keys look like the URLs and IDs found in real workloads. */
+#define MAX_KEY_LEN 64
+#define ID_CHARS "0123456789abcdefghijklmnopqrstuvwxyz"
+
+/* Turn the number n into a string key, written into key. Even numbers become
+ * URL paths, odd numbers become IDs of 8 to 23 characters. The same n always
+ * gives the same key, so lookups can reuse the numbers chosen for inserts. */
+void numtokey(int64 n, char *key) {
+	if (n % 2 == 0) {
+		sprintf(key, "https://example.com/items/%llu", n / 2);
+		return;
+	}
+
+	/* Spell out n in base 36, padding with characters derived from n. */
+	int len = 8 + n % 16;
+	int i;
+	for (i = 0; i < len; i++) {
+		key[i] = ID_CHARS[n % 36];
+		n = n / 36 + (n % 36) * 7919;
+	}
+	key[len] = '\0';
+}
+
+/* Make n distinct keys whose hash values under h1() (the hash function every
+ * table used before tables chose their own random seeds, and the low half of
+ * every hash under a2 -S 0) all share their lowest bits, so that under -S 0
+ * every one of them lands in the same slot or bucket of any table with up to
+ * 2^bits addresses (a power of two): one long probe sequence, or one bucket
+ * split over and over. The keys come back in random order. */
+int64 *collidingkeys(int n) {
+	/* Hash values i * 2^bits, for as many bits as leaves room for n of them
+	 * below 2^31 (h1()'s prime is just under 2^31, but at least 2^5 more
+	 * than the largest of these). */
+	int bits = 31;
+	while (bits > 5 && (1LL << (31 - bits)) < n) {
+		bits--;
+	}
+	if ((1LL << (31 - bits)) < n) {
+		fprintf(stderr, "too many colliding keys requested\n");
+		exit(1);
+	}
+
+	int64 *keys = malloc(sizeof (int64) * n);
+	int i;
+	for (i = 0; i < n; i++) {
+		keys[i] = h1_preimage((int) ((int64) i << bits));
+	}
+
+	/* Shuffle them (Fisher-Yates). */
+	for (i = n - 1; i > 0; i--) {
+		int j = randombelow(i + 1);
+		int64 tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+	return keys;
+}
+
+/* Print a command, in integer, string or binary form as requested. */
+void printcommand(char op, int64 n, int strings, int binary) {
+	if (binary) {
+		command_write_binary(stdout, op, n);
+	} else if (strings) {
+		char key[MAX_KEY_LEN];
+		numtokey(n, key);
+		printf("%c %s\n", op, key);
+	} else {
+		printf("%c %llu\n", op, n);
+	}
+}
+
+/*************************************************************************/
+
 int main(int argc, char **argv) {
 	int i;
 
-	/* Get command line arguments. */
-	if (argc < 3) {
+	/* Get command line options, then arguments. */
+	Workload w = { .dist = UNIFORM, .stride = 4096, .clusterlen = 64 };
+	int64 keyspace = 0, seed = time(NULL);
+	int keyspaceset = 0;
+	double theta = 0.99;
+	int hitpercent = 50, ndeletes = 0, interleave = 0;
+	int option;
+	while ((option = getopt(argc, argv, "d:k:z:w:c:h:x:is:")) != -1) {
+		switch (option) {
+			case 'd':
+				for (w.dist = 0; distnames[w.dist] != NULL; w.dist++) {
+					if (strcmp(distnames[w.dist], optarg) == 0) {
+						break;
+					}
+				}
+				if (distnames[w.dist] == NULL) {
+					printusageexit(argv[0]);
+				}
+				break;
+			case 'k':
+				keyspace = strtoull(optarg, NULL, 0);
+				keyspaceset = 1;
+				break;
+			case 'z':
+				theta = atof(optarg);
+				break;
+			case 'w':
+				w.stride = strtoull(optarg, NULL, 0);
+				break;
+			case 'c':
+				w.clusterlen = strtoull(optarg, NULL, 0);
+				break;
+			case 'h':
+				hitpercent = atoi(optarg);
+				break;
+			case 'x':
+				ndeletes = atoi(optarg);
+				break;
+			case 'i':
+				interleave = 1;
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			default:
+				printusageexit(argv[0]);
+		}
+	}
+	if (argc - optind < 2) {
+		printusageexit(argv[0]);
+	}
+	int ninserts  = atoi(argv[optind]);
+	int nlookups = atoi(argv[optind + 1]);
+	int strings = 0, collide = 0, binary = 0;
+	for (i = optind + 2; i < argc; i++) {
+		if (strcmp(argv[i], "string") == 0) {
+			strings = 1;
+		} else if (strcmp(argv[i], "collide") == 0) {
+			collide = 1;
+		} else if (strcmp(argv[i], "binary") == 0) {
+			binary = 1;
+		} else {
+			printusageexit(argv[0]);
+		}
+	}
+	if (strings && (collide || binary)) {
+		printusageexit(argv[0]);
+	}
+	if (ninserts < 0 || nlookups < 0 || ndeletes < 0 || hitpercent < 0
+		|| hitpercent > 100 || theta <= 0 || w.clusterlen < 1) {
 		printusageexit(argv[0]);
 	}
-	int ninserts  = atoi(argv[1]);
-	int nlookups = atoi(argv[2]);
 
-	/* Seed the random number generator. */
-	srand(time(NULL));
+	/* Seed the random number generator, saying how to get the same
+	 * commands again. */
+	seedrandom(seed);
+	fprintf(stderr, "seed: %llu\n", seed);
 
-	/* Decide on some random numbers for insertion. */
-	int max = 100 * ninserts + 1;
-	int64 *inserts = malloc(sizeof (int64) * ninserts);
-	for (i = 0; i < ninserts; i++) {
-		inserts[i] = rand() % max;
+	w.keyspace = keyspaceset ? keyspace : 100 * (int64) ninserts + 1;
+	if (w.dist == ZIPF) {
+		/* (ranks beyond 2^53 are as good as endless: doubles can't tell
+		 * them apart) */
+		double n = (w.keyspace == 0) ? 9007199254740992.0 : w.keyspace;
+		zipfsetup(&w.zipf, n, theta);
 	}
 
-	/* Print insertion commands for these numbers. */
-	for (i = 0; i < ninserts; i++) {
-		printf("i %llu\n", inserts[i]);
+	/* Colliding keys are decided all at once, with as many more kept back
+	 * for lookups that should fail (random keys would mostly miss the long
+	 * chain). */
+	int64 *colliding = NULL;
+	if (collide) {
+		colliding = collidingkeys(2 * ninserts);
 	}
 
+	/* The keys inserted so far, in order, and as a set (for avoiding them
+	 * when a lookup should miss). */
+	int64 *inserts = malloc(sizeof (int64) * (ninserts > 0 ? ninserts : 1));
+	KeySet inserted;
+	keysetinit(&inserted, ninserts);
+	int ninserted = 0;
+
+	if (binary) {
+		command_write_binary_header(stdout);
+	}
 
-	/* Print lookup commands. Some will succeed, others will fail. */
-	for (i = 0; i < nlookups; i++) {
-		
-		/* Flip a coin to decide whether to use an existing key or a new one. */
-		int64 lookup;
-		if (rand() % 2) {
+	/* Generate the commands, each chosen in proportion to how many of its
+	 * kind are left if interleaving, or else all of one kind at a time. */
+	int64 remaining[3] = { ninserts, nlookups, ndeletes };
+	while (remaining[0] + remaining[1] + remaining[2] > 0) {
+		int kind = 0;
+		if (interleave) {
+			int64 r = randombelow(remaining[0] + remaining[1] + remaining[2]);
+			while (r >= remaining[kind]) {
+				r -= remaining[kind];
+				kind++;
+			}
+		} else {
+			while (remaining[kind] == 0) {
+				kind++;
+			}
+		}
+		remaining[kind]--;
+
+		if (kind == 0) {
+			/* Insert the next key of the distribution. */
+			int64 key = collide ? colliding[ninserted] : nextkey(&w);
+			inserts[ninserted++] = key;
+			keysetadd(&inserted, key);
+			printcommand('i', key, strings, binary);
+
+		} else if (ninserted > 0 && (kind == 2
+			|| randombelow(100) < (int64) hitpercent)) {
 			/* Use a random existing key */
-			lookup = inserts[rand() % ninserts];
-		
+			int64 key = inserts[randombelow(ninserted)];
+			printcommand(kind == 1 ? 'l' : 'd', key, strings, binary);
+
+		} else if (collide && ninserts > 0) {
+			/* Use a colliding key that wasn't inserted */
+			int64 key = colliding[ninserts + randombelow(ninserts)];
+			printcommand('l', key, strings, binary);
+
 		} else {
-			/* Generate a new random key */
-			lookup = rand() % max;
+			/* Generate a new random key that isn't in the table (from the
+			 * whole 64-bit range, if the key space is too full to find one) */
+			int64 key;
+			int tries = 0;
+			do {
+				key = randombelow(tries++ < 64 ? w.keyspace : 0);
+			} while (keysethas(&inserted, key));
+			printcommand(kind == 1 ? 'l' : 'd', key, strings, binary);
 		}
-		printf("l %llu\n", lookup);
 	}
 
 	/* Finish with commands to print the table, print statistics, and quit. */
 
-	printf("p\n");
-	printf("s\n");
-	printf("q\n"); 
+	if (binary) {
+		command_write_binary(stdout, 'p', 0);
+		command_write_binary(stdout, 's', 0);
+		command_write_binary(stdout, 'q', 0);
+	} else {
+		printf("p\n");
+		printf("s\n");
+		printf("q\n");
+	}
 
+	free(inserts);
+	free(inserted.slots);
+	free(inserted.used);
+	free(colliding);
 	return 0;
 }
@@ -0,0 +1,355 @@
+/* * * * * * * * *
+ * Module for reading interpreter commands quickly enough that replaying a
+ * file of hundreds of millions of them costs little more than carrying them
+ * out. a command file is mapped into memory and scanned in place, rather than
+ * copied out a line at a time and parsed with sscanf(), and may instead be in
+ * a compact binary form (as written by cmdgen ... binary), which needs no
+ * parsing at all
+ *
+ * a binary command file is a header, then one 9-byte record per command: the
+ * operation character, then the integer argument in native byte order
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _DEFAULT_SOURCE  // for mmap, madvise, fileno
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>  // for memchr, memcmp, memcpy, strlen
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cmdinput.h"
+
+// every binary command file starts with these 8 bytes
+#define MAGIC "HTBLCMDS"
+// written in native byte order, so we can tell if a file came from a machine
+// with a different byte order
+#define BYTE_ORDER_MARK 0x01020304
+// the size of each command in a binary command file
+#define RECORD_SIZE (1 + sizeof (int64))
+
+// the header at the start of every binary command file
+typedef struct header {
+	char magic[8];			// always MAGIC
+	uint32_t byte_order;	// always BYTE_ORDER_MARK
+	uint32_t record_size;	// always RECORD_SIZE
+} Header;
+
+// a source of commands: a mapped file, or else a stream read line by line
+struct command_reader {
+	FILE *file;				// where commands come from, if not mapped
+	char *base;				// the mapped file (or NULL if not mapped)
+	size_t size;			// the size of the mapped file in bytes
+	size_t offset;			// how far through the mapped file we've read
+	bool binary;			// is the mapped file a binary command file?
+	char line[MAX_LINE_LEN];	// the last line read, if not mapped
+	int peeked;				// the length of a line read into 'line' early
+							// but not yet used (or -1 if none is)
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// map the file 'file' into memory from its current position, if it's a
+// regular file, storing the mapping in 'reader'
+// returns false if it can't be mapped
+static bool map_file(CommandReader *reader, FILE *file) {
+	int fd = fileno(file);
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+		return false;
+	}
+
+	void *base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	// only a hint: commands are read from start to end, once
+	madvise(base, info.st_size, MADV_SEQUENTIAL);
+
+	// (anything already read from 'file' has been used)
+	off_t position = lseek(fd, 0, SEEK_CUR);
+	reader->base = base;
+	reader->size = info.st_size;
+	reader->offset = (position > 0) ? position : 0;
+	return true;
+}
+
+// read a line from the stream into reader->line, up to MAX_LINE_LEN
+// returns its length (not counting its newline), or -1 if the input has run
+// out
+static int read_line(CommandReader *reader) {
+	if (fgets(reader->line, MAX_LINE_LEN, reader->file) == NULL) {
+		return -1;
+	}
+	int len = strlen(reader->line);
+	if (len > 0 && reader->line[len-1] == '\n') {
+		len--; // strip trailing newline
+	} else {
+		// cut the line short, skipping the rest of it
+		int c;
+		while ((c = getc(reader->file)) != '\n' && c != EOF);
+	}
+	return len;
+}
+
+// find the next line of input, storing its start in *line and the position
+// just past its end (not counting its newline) in *end
+// returns false if the input has run out
+static bool next_line(CommandReader *reader, const char **line,
+	const char **end) {
+
+	// mapped lines can be used where they are
+	if (reader->base != NULL) {
+		if (reader->offset >= reader->size) {
+			return false;
+		}
+		*line = reader->base + reader->offset;
+		const char *newline = memchr(*line, '\n',
+			reader->size - reader->offset);
+		*end = (newline != NULL) ? newline : reader->base + reader->size;
+		reader->offset = *end - reader->base + 1;
+		return true;
+	}
+
+	// otherwise read a line from the stream (unless one was read already)
+	int len = reader->peeked;
+	if (len >= 0) {
+		reader->peeked = -1;
+	} else {
+		len = read_line(reader);
+	}
+	if (len < 0) {
+		return false;
+	}
+	*line = reader->line;
+	*end = reader->line + len;
+	return true;
+}
+
+// is 'c' whitespace, as isspace() would say in the C locale?
+static bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// skip any whitespace from 'text', up to 'end'
+// returns the first character that isn't whitespace (or 'end')
+static const char *skip_space(const char *text, const char *end) {
+	while (text < end && is_space(*text)) {
+		text++;
+	}
+	return text;
+}
+
+// parse an unsigned decimal integer from the start of 'text' (up to 'end')
+// into *value, just as sscanf("%llu") would: allowing a sign, wrapping
+// negative numbers around (so that -1 becomes 2^64-1), and capping numbers too
+// large to fit at 2^64-1
+// returns false if there are no digits there
+static bool scan_integer(const char *text, const char *end, int64 *value) {
+	bool negative = false;
+	if (text < end && (*text == '-' || *text == '+')) {
+		negative = (*text == '-');
+		text++;
+	}
+	if (text == end || *text < '0' || *text > '9') {
+		return false;
+	}
+
+	int64 number = 0;
+	bool overflow = false;
+	while (text < end && *text >= '0' && *text <= '9') {
+		int digit = *text - '0';
+		if (number > (UINT64_MAX - digit) / 10) {
+			overflow = true;
+		}
+		number = number * 10 + digit;
+		text++;
+	}
+
+	if (overflow) {
+		*value = UINT64_MAX;
+	} else {
+		*value = negative ? -number : number;
+	}
+	return true;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// start reading commands from 'file', mapping it into memory if possible, and
+// recognising binary command files by their header
+// returns NULL (after printing why) if 'file' is a binary command file that
+// can't be read: one written on another kind of machine, or one that can't be
+// mapped (such as one piped in)
+CommandReader *new_command_reader(FILE *file) {
+	assert(file);
+
+	CommandReader *reader = malloc(sizeof *reader);
+	assert(reader);
+	reader->file = file;
+	reader->base = NULL;
+	reader->binary = false;
+	reader->peeked = -1;
+
+	if (map_file(reader, file)) {
+		Header header;
+		if (reader->size - reader->offset >= sizeof header) {
+			memcpy(&header, reader->base + reader->offset, sizeof header);
+			reader->binary = memcmp(header.magic, MAGIC,
+				sizeof header.magic) == 0;
+		}
+		if (reader->binary) {
+			if (header.byte_order != BYTE_ORDER_MARK) {
+				fprintf(stderr, "binary command file written on a machine "
+					"with a different byte order\n");
+				free_command_reader(reader);
+				return NULL;
+			}
+			if (header.record_size != RECORD_SIZE) {
+				fprintf(stderr, "binary command file has %u-byte commands, "
+					"not %d-byte ones\n", (unsigned) header.record_size,
+					(int) RECORD_SIZE);
+				free_command_reader(reader);
+				return NULL;
+			}
+			reader->offset += sizeof header;
+		}
+	} else if (!isatty(fileno(file))) {
+		// a binary command file piped in would only be parsed into garbage,
+		// so look at the first line now, to refuse one (keeping the line
+		// for next_line() otherwise). a terminal isn't kept waiting for it
+		reader->peeked = read_line(reader);
+		if (reader->peeked >= 0
+			&& strncmp(reader->line, MAGIC, strlen(MAGIC)) == 0) {
+			fprintf(stderr, "binary command files can't be piped in: "
+				"redirect one from the file instead (< file)\n");
+			free_command_reader(reader);
+			return NULL;
+		}
+	}
+
+	return reader;
+}
+
+// free all memory associated with 'reader', unmapping its file (the file
+// itself is left open)
+void free_command_reader(CommandReader *reader) {
+	assert(reader);
+	if (reader->base != NULL) {
+		munmap(reader->base, reader->size);
+	}
+	free(reader);
+}
+
+// are the commands from 'reader' in binary form? (such commands can only
+// carry integer keys)
+bool command_reader_is_binary(CommandReader *reader) {
+	assert(reader);
+	return reader->binary;
+}
+
+// read the next command, storing its operation character in *operation and
+// its integer argument (if any) in *key. once the input runs out, every
+// command read is END_OF_INPUT
+// returns the number of tokens successfully read (e.g. 0 for none,
+// 1 for operation only, 2 for both operation and integer)
+int command_reader_next(CommandReader *reader, char *operation, int64 *key) {
+
+	// binary commands always have both parts, needing only to be copied out
+	if (reader->binary) {
+		if (reader->size - reader->offset < RECORD_SIZE) {
+			*operation = END_OF_INPUT;
+			return 1;
+		}
+		const char *record = reader->base + reader->offset;
+		*operation = record[0];
+		memcpy(key, record + 1, sizeof *key);
+		reader->offset += RECORD_SIZE;
+		return 2;
+	}
+
+	const char *line, *end;
+	if (!next_line(reader, &line, &end)) {
+		*operation = END_OF_INPUT;
+		return 1;
+	}
+	if (line == end) {
+		return 0;
+	}
+
+	// the operation is the first character, whatever it is
+	*operation = line[0];
+	// note: since the key is unsigned, a command like 'i -1' will overflow,
+	// resulting in *key = 18446744073709551615 (2^64-1). this is a feature.
+	if (!scan_integer(skip_space(line + 1, end), end, key)) {
+		return 1;
+	}
+	return 2;
+}
+
+// read the next command, storing its operation character in *operation and
+// its string argument (up to the first whitespace, if any) in 'key' (which
+// must have room for MAX_LINE_LEN characters), and the length of the string
+// in *len. 'reader' must not be binary
+// returns the number of tokens successfully read, as command_reader_next()
+// does
+int command_reader_next_str(CommandReader *reader, char *operation,
+	char *key, int *len) {
+	assert(!reader->binary);
+
+	const char *line, *end;
+	if (!next_line(reader, &line, &end)) {
+		*operation = END_OF_INPUT;
+		return 1;
+	}
+	if (line == end) {
+		return 0;
+	}
+
+	*operation = line[0];
+	const char *start = skip_space(line + 1, end);
+	const char *stop = start;
+	while (stop < end && !is_space(*stop) && stop - start < MAX_LINE_LEN - 1) {
+		stop++;
+	}
+	if (stop == start) {
+		return 1;
+	}
+
+	*len = stop - start;
+	memcpy(key, start, *len);
+	key[*len] = '\0';
+	return 2;
+}
+
+// write a binary command file header to 'file', to be followed by commands
+// written with command_write_binary()
+void command_write_binary_header(FILE *file) {
+	assert(file);
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof header.magic);
+	header.byte_order = BYTE_ORDER_MARK;
+	header.record_size = RECORD_SIZE;
+	fwrite(&header, sizeof header, 1, file);
+}
+
+// write the command with operation character 'operation' and integer argument
+// 'key' (ignored by operations that take no argument) to 'file', in binary
+void command_write_binary(FILE *file, char operation, int64 key) {
+	char record[RECORD_SIZE];
+	record[0] = operation;
+	memcpy(record + 1, &key, sizeof key);
+	fwrite(record, sizeof record, 1, file);
+}
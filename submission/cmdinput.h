@@ -0,0 +1,73 @@
+/* * * * * * * * *
+ * Module for reading interpreter commands quickly enough that replaying a
+ * file of hundreds of millions of them costs little more than carrying them
+ * out. a command file is mapped into memory and scanned in place, rather than
+ * copied out a line at a time and parsed with sscanf(), and may instead be in
+ * a compact binary form (as written by cmdgen ... binary), which needs no
+ * parsing at all
+ *
+ * input that can't be mapped (a terminal or a pipe) is read a line at a time,
+ * as before. binary command files must be mapped, so can't be piped in (and
+ * are refused, rather than read as text, if they are)
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef CMDINPUT_H
+#define CMDINPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "inthash.h"
+
+// the longest line (and so the longest string key) read, including the
+// trailing newline. longer lines are cut short
+#define MAX_LINE_LEN 80
+
+// the command returned once the input runs out
+#define END_OF_INPUT 'q'
+
+// a source of commands
+typedef struct command_reader CommandReader;
+
+// start reading commands from 'file', mapping it into memory if possible, and
+// recognising binary command files by their header
+// returns NULL (after printing why) if 'file' is a binary command file that
+// can't be read: one written on another kind of machine, or one that can't be
+// mapped (such as one piped in)
+CommandReader *new_command_reader(FILE *file);
+
+// free all memory associated with 'reader', unmapping its file (the file
+// itself is left open)
+void free_command_reader(CommandReader *reader);
+
+// are the commands from 'reader' in binary form? (such commands can only
+// carry integer keys)
+bool command_reader_is_binary(CommandReader *reader);
+
+// read the next command, storing its operation character in *operation and
+// its integer argument (if any) in *key. once the input runs out, every
+// command read is END_OF_INPUT
+// returns the number of tokens successfully read (e.g. 0 for none,
+// 1 for operation only, 2 for both operation and integer)
+int command_reader_next(CommandReader *reader, char *operation, int64 *key);
+
+// read the next command, storing its operation character in *operation and
+// its string argument (up to the first whitespace, if any) in 'key' (which
+// must have room for MAX_LINE_LEN characters), and the length of the string
+// in *len. 'reader' must not be binary
+// returns the number of tokens successfully read, as command_reader_next()
+// does
+int command_reader_next_str(CommandReader *reader, char *operation,
+	char *key, int *len);
+
+// write a binary command file header to 'file', to be followed by commands
+// written with command_write_binary()
+void command_write_binary_header(FILE *file);
+
+// write the command with operation character 'operation' and integer argument
+// 'key' (ignored by operations that take no argument) to 'file', in binary
+void command_write_binary(FILE *file, char operation, int64 key);
+
+#endif
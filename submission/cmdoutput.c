@@ -0,0 +1,186 @@
+/* * * * * * * * *
+ * Module for reporting the results of the interpreter's inserts and lookups
+ * cheaply enough that replaying a command file measures the table, rather
+ * than printf(). results can be printed a line each (formatted by hand, into
+ * a large output buffer), or only counted (quiet mode), and can also be
+ * written to a bitmap file holding one bit per command
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>  // for isatty
+
+#include "cmdoutput.h"
+
+// the results an insert or lookup can have
+typedef enum result {
+	INSERTED, ALREADY_THERE, FOUND, NOT_FOUND, NUM_RESULTS
+} Result;
+
+// what follows the key on each kind of result's line
+static const char *result_text[NUM_RESULTS] = {
+	" inserted\n", " already in table\n", " found\n", " not found\n"
+};
+
+// the most digits a key can have (2^64-1 has 20)
+#define MAX_DIGITS 20
+
+// a destination for the results of commands
+struct command_writer {
+	bool quiet;					// count results without printing them?
+	int64 counts[NUM_RESULTS];	// how many of each result there have been
+	FILE *bitmap;				// the bitmap file (or NULL if none)
+	unsigned char bits;			// the bits not yet written to the bitmap
+	int nbits;					// how many of them there are
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// count 'result' in 'writer', adding its bit to the bitmap file (if any)
+static void record(CommandWriter *writer, Result result) {
+	writer->counts[result]++;
+	if (writer->bitmap == NULL) {
+		return;
+	}
+
+	if (result == INSERTED || result == FOUND) {
+		writer->bits |= 1 << writer->nbits;
+	}
+	writer->nbits++;
+	if (writer->nbits == 8) {
+		putc(writer->bits, writer->bitmap);
+		writer->bits = 0;
+		writer->nbits = 0;
+	}
+}
+
+// print the line for 'result' with integer key 'key' to stdout (formatting
+// the key by hand, as printf() is several times slower)
+static void print_result(Result result, int64 key) {
+	char digits[MAX_DIGITS];
+	int start = MAX_DIGITS;
+	do {
+		digits[--start] = '0' + key % 10;
+		key /= 10;
+	} while (key > 0);
+
+	fwrite(digits + start, 1, MAX_DIGITS - start, stdout);
+	fputs(result_text[result], stdout);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// start reporting results to stdout (a line each, or only counted if 'quiet'
+// is true) and, unless 'bitmap_path' is NULL, to a bitmap file created at
+// 'bitmap_path'. call this before anything is printed to stdout
+// returns NULL if the bitmap file can't be created
+CommandWriter *new_command_writer(bool quiet, const char *bitmap_path) {
+	CommandWriter *writer = malloc(sizeof *writer);
+	assert(writer);
+	writer->quiet = quiet;
+	writer->bits = 0;
+	writer->nbits = 0;
+	int result;
+	for (result = 0; result < NUM_RESULTS; result++) {
+		writer->counts[result] = 0;
+	}
+
+	writer->bitmap = NULL;
+	if (bitmap_path != NULL) {
+		writer->bitmap = fopen(bitmap_path, "wb");
+		if (writer->bitmap == NULL) {
+			free(writer);
+			return NULL;
+		}
+		setvbuf(writer->bitmap, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+	}
+
+	// (a terminal's user is waiting to see each result)
+	if (!isatty(fileno(stdout))) {
+		setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+	}
+	return writer;
+}
+
+// free all memory associated with 'writer', finishing and closing its bitmap
+// file (if any)
+void free_command_writer(CommandWriter *writer) {
+	assert(writer);
+	if (writer->bitmap != NULL) {
+		// the last byte is padded with zeroes
+		if (writer->nbits > 0) {
+			putc(writer->bits, writer->bitmap);
+		}
+		fclose(writer->bitmap);
+	}
+	free(writer);
+}
+
+// report that inserting 'key' did (or didn't, if it was already there)
+// insert it
+void command_writer_insert(CommandWriter *writer, int64 key, bool inserted) {
+	Result result = inserted ? INSERTED : ALREADY_THERE;
+	record(writer, result);
+	if (!writer->quiet) {
+		print_result(result, key);
+	}
+}
+
+// report that looking up 'key' did (or didn't) find it
+void command_writer_lookup(CommandWriter *writer, int64 key, bool found) {
+	Result result = found ? FOUND : NOT_FOUND;
+	record(writer, result);
+	if (!writer->quiet) {
+		print_result(result, key);
+	}
+}
+
+// report that inserting the string 'key' did (or didn't) insert it
+void command_writer_str_insert(CommandWriter *writer, const char *key,
+	bool inserted) {
+	Result result = inserted ? INSERTED : ALREADY_THERE;
+	record(writer, result);
+	if (!writer->quiet) {
+		fputs(key, stdout);
+		fputs(result_text[result], stdout);
+	}
+}
+
+// report that looking up the string 'key' did (or didn't) find it
+void command_writer_str_lookup(CommandWriter *writer, const char *key,
+	bool found) {
+	Result result = found ? FOUND : NOT_FOUND;
+	record(writer, result);
+	if (!writer->quiet) {
+		fputs(key, stdout);
+		fputs(result_text[result], stdout);
+	}
+}
+
+// print how many of each result there have been so far to stdout, if only
+// counting them
+void command_writer_print_counts(CommandWriter *writer) {
+	assert(writer);
+	if (!writer->quiet) {
+		return;
+	}
+	printf("results:\n");
+	printf("    %llu inserted, %llu already in table\n",
+		(unsigned long long) writer->counts[INSERTED],
+		(unsigned long long) writer->counts[ALREADY_THERE]);
+	printf("    %llu found, %llu not found\n",
+		(unsigned long long) writer->counts[FOUND],
+		(unsigned long long) writer->counts[NOT_FOUND]);
+}
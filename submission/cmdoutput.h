@@ -0,0 +1,58 @@
+/* * * * * * * * *
+ * Module for reporting the results of the interpreter's inserts and lookups
+ * cheaply enough that replaying a command file measures the table, rather
+ * than printf(). results can be printed a line each (formatted by hand, into
+ * a large output buffer), or only counted (quiet mode), and can also be
+ * written to a bitmap file holding one bit per command
+ *
+ * a bitmap file holds the results of the inserts and lookups in the order
+ * they were carried out: bit i (bit i % 8 of byte i / 8, counting from the
+ * least significant) is 1 if command i inserted or found its key
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef CMDOUTPUT_H
+#define CMDOUTPUT_H
+
+#include <stdbool.h>
+#include "inthash.h"
+
+// how much of stdout is buffered before it's written, when it isn't a
+// terminal (which still sees each line as soon as it's printed)
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// a destination for the results of commands
+typedef struct command_writer CommandWriter;
+
+// start reporting results to stdout (a line each, or only counted if 'quiet'
+// is true) and, unless 'bitmap_path' is NULL, to a bitmap file created at
+// 'bitmap_path'. call this before anything is printed to stdout
+// returns NULL if the bitmap file can't be created
+CommandWriter *new_command_writer(bool quiet, const char *bitmap_path);
+
+// free all memory associated with 'writer', finishing and closing its bitmap
+// file (if any)
+void free_command_writer(CommandWriter *writer);
+
+// report that inserting 'key' did (or didn't, if it was already there)
+// insert it
+void command_writer_insert(CommandWriter *writer, int64 key, bool inserted);
+
+// report that looking up 'key' did (or didn't) find it
+void command_writer_lookup(CommandWriter *writer, int64 key, bool found);
+
+// report that inserting the string 'key' did (or didn't) insert it
+void command_writer_str_insert(CommandWriter *writer, const char *key,
+	bool inserted);
+
+// report that looking up the string 'key' did (or didn't) find it
+void command_writer_str_lookup(CommandWriter *writer, const char *key,
+	bool found);
+
+// print how many of each result there have been so far to stdout, if only
+// counting them
+void command_writer_print_counts(CommandWriter *writer);
+
+#endif
@@ -0,0 +1,152 @@
+/* * * * * * * * *
+ * Module for reading interpreter commands on a thread of their own, so that
+ * parsing a large command file overlaps with carrying out its commands on
+ * another core. a parser thread reads commands and passes them, already
+ * decoded, through a lock-free ring to the thread carrying them out, which
+ * takes them from the ring in batches
+ *
+ * the ring's two ends are counts of how many commands have ever been put in
+ * (head) and taken out (tail), each written by one side only, and each on a
+ * cache line of its own along with that side's last look at the other end, so
+ * that the two threads only fight over a line when one has to look again
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for posix_memalign, sched_yield
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "cmdpipe.h"
+
+// how many commands the ring holds (a power of two)
+#define RING_SIZE 4096
+// size of a cache line in bytes
+#define CACHE_LINE 64
+// how many times to look again for room (or commands) in the ring before
+// giving up the cpu to the other thread (which, on a single core, is the only
+// way there will ever be any)
+#define SPINS 64
+// the command after which no more are read (see END_OF_INPUT)
+#define QUIT 'q'
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+
+// commands being read on a thread of their own
+struct command_pipe {
+	// written by the parser thread only
+	int64 head;				// how many commands have been put in the ring
+	int64 seen_tail;		// how many had been taken out, when last looked
+	char head_padding[CACHE_LINE - 2 * sizeof (int64)];
+
+	// written by the thread taking commands out only
+	int64 tail;				// how many commands have been taken out
+	int64 seen_head;		// how many had been put in, when last looked
+	char tail_padding[CACHE_LINE - 2 * sizeof (int64)];
+
+	Command ring[RING_SIZE];	// command i is kept at ring[i % RING_SIZE]
+	CommandReader *reader;		// where the parser thread reads commands
+	pthread_t thread;			// the parser thread
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// wait a moment for the other thread, having looked 'spins' times already
+static void wait_for_other(int spins) {
+	if (spins >= SPINS) {
+		sched_yield();
+	}
+}
+
+// the parser thread: read commands from pipe->reader into the ring, until a
+// 'q' command
+static void *parse(void *arg) {
+	CommandPipe *pipe = arg;
+	int64 head = pipe->head;
+	bool quit = false;
+
+	while (!quit) {
+		// wait for room in the ring
+		int spins = 0;
+		while (head - pipe->seen_tail == RING_SIZE) {
+			pipe->seen_tail = LOAD(&pipe->tail);
+			wait_for_other(spins++);
+		}
+
+		Command *command = &pipe->ring[head % RING_SIZE];
+		command->argc = command_reader_next(pipe->reader, &command->operation,
+			&command->key);
+		quit = (command->argc >= 1 && command->operation == QUIT);
+
+		// publish the command (and everything written into it) only now
+		head++;
+		STORE(&pipe->head, head);
+	}
+	return NULL;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// start reading commands from 'reader' on a new thread (which keeps reading
+// until it reads a 'q' command, as every command is once the input runs out).
+// 'reader' mustn't be used by any other thread until the pipe is freed
+CommandPipe *new_command_pipe(CommandReader *reader) {
+	assert(reader);
+
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE, sizeof (CommandPipe));
+	assert(error == 0);
+	CommandPipe *pipe = memory;
+	pipe->head = pipe->seen_tail = 0;
+	pipe->tail = pipe->seen_head = 0;
+	pipe->reader = reader;
+
+	error = pthread_create(&pipe->thread, NULL, parse, pipe);
+	assert(error == 0);
+	return pipe;
+}
+
+// wait for the parser thread to finish, and free all memory associated with
+// 'pipe'. the thread only finishes once it has read a 'q' command
+void free_command_pipe(CommandPipe *pipe) {
+	assert(pipe);
+	pthread_join(pipe->thread, NULL);
+	free(pipe);
+}
+
+// take up to 'max' commands, in order, into 'batch', waiting for at least one
+// to be read first if there are none yet
+// returns how many commands were taken
+int command_pipe_next_batch(CommandPipe *pipe, Command *batch, int max) {
+	assert(max > 0);
+	int64 tail = pipe->tail;
+
+	// look at the head again only once every command seen so far is taken
+	int spins = 0;
+	while (pipe->seen_head == tail) {
+		pipe->seen_head = LOAD(&pipe->head);
+		wait_for_other(spins++);
+	}
+
+	int n = 0;
+	while (n < max && tail != pipe->seen_head) {
+		batch[n++] = pipe->ring[tail % RING_SIZE];
+		tail++;
+	}
+
+	// hand the slots back to the parser thread
+	STORE(&pipe->tail, tail);
+	return n;
+}
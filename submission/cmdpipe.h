@@ -0,0 +1,46 @@
+/* * * * * * * * *
+ * Module for reading interpreter commands on a thread of their own, so that
+ * parsing a large command file overlaps with carrying out its commands on
+ * another core. a parser thread reads commands and passes them, already
+ * decoded, through a lock-free ring to the thread carrying them out, which
+ * takes them from the ring in batches
+ *
+ * the ring has one producer (the parser thread) and one consumer (whichever
+ * thread takes commands out), so needs no locks: each side only ever writes
+ * its own end of it
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef CMDPIPE_H
+#define CMDPIPE_H
+
+#include "inthash.h"
+#include "cmdinput.h"
+
+// a decoded command, with an integer key
+typedef struct command {
+	char operation;		// the operation character
+	int argc;			// how many tokens were read, as command_reader_next()
+	int64 key;			// the integer argument, if argc is 2
+} Command;
+
+// commands being read on a thread of their own
+typedef struct command_pipe CommandPipe;
+
+// start reading commands from 'reader' on a new thread (which keeps reading
+// until it reads a 'q' command, as every command is once the input runs out).
+// 'reader' mustn't be used by any other thread until the pipe is freed
+CommandPipe *new_command_pipe(CommandReader *reader);
+
+// wait for the parser thread to finish, and free all memory associated with
+// 'pipe'. the thread only finishes once it has read a 'q' command
+void free_command_pipe(CommandPipe *pipe);
+
+// take up to 'max' commands, in order, into 'batch', waiting for at least one
+// to be read first if there are none yet
+// returns how many commands were taken
+int command_pipe_next_batch(CommandPipe *pipe, Command *batch, int max);
+
+#endif
@@ -11,6 +11,7 @@
 #include <assert.h>
 
 #include "hashtbl.h"
+#include "snapshot.h"
 
 #include "tables/linear.h"	// provided
 #include "tables/xtndbl1.h"	// provided
@@ -18,6 +19,7 @@
 #include "tables/xtndbln.h" // create for part 2
 #include "tables/xuckoo.h"	// create for part 3
 #include "tables/xuckoon.h"	// created for bonus challenge
+#include "tables/adaptive.h"	// switches between the others
 
 
 // converts from a string representation to a TableType constant:
@@ -45,6 +47,9 @@ TableType strtotype(char *str) {
 	if (strcmp("xuckoon", str) == 0) {
 		return XUCKOON;
 	}
+	if (strcmp("auto", str) == 0) {
+		return AUTO;
+	}
 	return NOTYPE;
 }
 
@@ -53,11 +58,12 @@ TableType strtotype(char *str) {
 struct table {
 	TableType type;	// what type of hash table is this?
 	void *table;	// the hash table itself
+	Snapshot *snapshot;	// the snapshot it was loaded from, if any
 };
 
 // initialise a hash table of type 'type' with initial size 'size',
 // and return its pointer
-HashTable *new_hash_table(TableType type, int size) {
+HashTable *new_hash_table(TableType type, size64 size) {
 
 	// allocate space for the table wrapper
 	HashTable *table = malloc(sizeof *table);
@@ -65,6 +71,7 @@ HashTable *new_hash_table(TableType type, int size) {
 
 	// store the table type, so we know which functions to call later
 	table->type = type;
+	table->snapshot = NULL;
 
 	// create and store the table itself
 	switch (type) {
@@ -86,6 +93,54 @@ HashTable *new_hash_table(TableType type, int size) {
 		case XUCKOON:
 			table->table = new_xuckoon_hash_table(size);
 			break;
+		case AUTO:
+			table->table = new_adaptive_hash_table(size);
+			break;
+		default:
+			// no such table type? error. release memory and return NULL
+			free(table);
+			return NULL;
+	}
+
+	return table;
+}
+
+// build a hash table of type 'type' containing the 'n' keys in 'keys', filled
+// in parallel by 'nthreads' threads
+HashTable *hash_table_bulk_load(TableType type, int size, int64 *keys,
+	size64 n, int nthreads) {
+
+	// allocate space for the table wrapper
+	HashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->type = type;
+	table->snapshot = NULL;
+
+	// build the table itself
+	switch (type) {
+		case LINEAR:
+			table->table = linear_hash_table_bulk_load(keys, n, nthreads);
+			break;
+		case XTNDBL1:
+			table->table = xtndbl1_hash_table_bulk_load(keys, n, nthreads);
+			break;
+		case CUCKOO:
+			table->table = cuckoo_hash_table_bulk_load(keys, n, nthreads);
+			break;
+		case XTNDBLN:
+			table->table = xtndbln_hash_table_bulk_load(keys, n, size,
+				nthreads);
+			break;
+		case XUCKOO:
+			table->table = xuckoo_hash_table_bulk_load(keys, n, nthreads);
+			break;
+		case XUCKOON:
+			table->table = xuckoon_hash_table_bulk_load(keys, n, size,
+				nthreads);
+			break;
+		case AUTO:
+			table->table = adaptive_hash_table_bulk_load(keys, n, nthreads);
+			break;
 		default:
 			// no such table type? error. release memory and return NULL
 			free(table);
@@ -119,14 +174,55 @@ void free_hash_table(HashTable *table) {
 		case XUCKOON:
 			free_xuckoon_hash_table(table->table);
 			break;
+		case AUTO:
+			free_adaptive_hash_table(table->table);
+			break;
 		default:
 			break;
 	}
 
+	// now nothing can be using the snapshot it was loaded from (if any)
+	if (table->snapshot != NULL) {
+		snapshot_close(table->snapshot);
+	}
+
 	// free the wrapper struct itself
 	free(table);
 }
 
+// make room in 'table' for 'nkeys' keys in total, without growing as they're
+// inserted
+void hash_table_reserve(HashTable *table, size64 nkeys) {
+	assert(table != NULL);
+
+	// forward the call onto the relevant reserve function
+	switch (table->type) {
+		case LINEAR:
+			linear_hash_table_reserve(table->table, nkeys);
+			break;
+		case XTNDBL1:
+			xtndbl1_hash_table_reserve(table->table, nkeys);
+			break;
+		case CUCKOO:
+			cuckoo_hash_table_reserve(table->table, nkeys);
+			break;
+		case XTNDBLN:
+			xtndbln_hash_table_reserve(table->table, nkeys);
+			break;
+		case XUCKOO:
+			xuckoo_hash_table_reserve(table->table, nkeys);
+			break;
+		case XUCKOON:
+			xuckoon_hash_table_reserve(table->table, nkeys);
+			break;
+		case AUTO:
+			adaptive_hash_table_reserve(table->table, nkeys);
+			break;
+		default:
+			break;
+	}
+}
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool hash_table_insert(HashTable *table, int64 key) {
@@ -146,6 +242,8 @@ bool hash_table_insert(HashTable *table, int64 key) {
 			return xuckoo_hash_table_insert(table->table, key);
 		case XUCKOON:
 			return xuckoon_hash_table_insert(table->table, key);
+		case AUTO:
+			return adaptive_hash_table_insert(table->table, key);
 		default:
 			return false;
 	}
@@ -170,11 +268,133 @@ bool hash_table_lookup(HashTable *table, int64 key) {
 			return xuckoo_hash_table_lookup(table->table, key);
 		case XUCKOON:
 			return xuckoon_hash_table_lookup(table->table, key);
+		case AUTO:
+			return adaptive_hash_table_lookup(table->table, key);
 		default:
 			return false;
 	}
 }
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool hash_table_put(HashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+
+	// forward the call onto the relevant put function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_put(table->table, key, value);
+		case XTNDBL1:
+			return xtndbl1_hash_table_put(table->table, key, value);
+		case CUCKOO:
+			return cuckoo_hash_table_put(table->table, key, value);
+		case XTNDBLN:
+			return xtndbln_hash_table_put(table->table, key, value);
+		case XUCKOO:
+			return xuckoo_hash_table_put(table->table, key, value);
+		case XUCKOON:
+			return xuckoon_hash_table_put(table->table, key, value);
+		case AUTO:
+			return adaptive_hash_table_put(table->table, key, value);
+		default:
+			return false;
+	}
+}
+
+// find where the value for 'key' is stored inside 'table'
+// returns a pointer to the value inside the table, or NULL if not found
+int64 *hash_table_find_value(HashTable *table, int64 key) {
+	assert(table != NULL);
+
+	// forward the call onto the relevant get function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_get(table->table, key);
+		case XTNDBL1:
+			return xtndbl1_hash_table_get(table->table, key);
+		case CUCKOO:
+			return cuckoo_hash_table_get(table->table, key);
+		case XTNDBLN:
+			return xtndbln_hash_table_get(table->table, key);
+		case XUCKOO:
+			return xuckoo_hash_table_get(table->table, key);
+		case XUCKOON:
+			return xuckoon_hash_table_get(table->table, key);
+		case AUTO:
+			return adaptive_hash_table_get(table->table, key);
+		default:
+			return NULL;
+	}
+}
+
+// lookup the value stored with 'key' inside 'table', copying it into *value
+// (unless 'value' is NULL)
+// returns true if found, false if not (leaving *value untouched)
+bool hash_table_get(HashTable *table, int64 key, int64 *value) {
+	int64 *stored = hash_table_find_value(table, key);
+	if (stored == NULL) {
+		return false;
+	}
+	if (value != NULL) {
+		*value = *stored;
+	}
+	return true;
+}
+
+// replace the value stored with 'key' inside 'table' by 'value', if 'key' is
+// in there (does not insert 'key' otherwise)
+// returns true if the value was updated, false if 'key' was not found
+bool hash_table_update(HashTable *table, int64 key, int64 value) {
+	int64 *stored = hash_table_find_value(table, key);
+	if (stored == NULL) {
+		return false;
+	}
+	*stored = value;
+	return true;
+}
+
+// set up 'iter' to visit every entry inside 'table'
+void hash_table_iter_begin(HashTable *table, HashTableIter *iter) {
+	assert(table != NULL);
+	assert(iter != NULL);
+
+	iter->table = table;
+	iter->cursor.table = 0;
+	iter->cursor.address = 0;
+	iter->cursor.index = 0;
+	iter->cursor.stage = 0;
+}
+
+// advance 'iter' to the next entry inside its table
+// returns a pointer to the entry inside the table itself, or NULL once every
+// entry has been visited
+Entry *hash_table_iter_next(HashTableIter *iter) {
+	assert(iter != NULL);
+
+	// forward the call onto the relevant iteration function
+	HashTable *table = iter->table;
+	Cursor *cursor = &iter->cursor;
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_iter_next(table->table, cursor);
+		case XTNDBL1:
+			return xtndbl1_hash_table_iter_next(table->table, cursor);
+		case CUCKOO:
+			return cuckoo_hash_table_iter_next(table->table, cursor);
+		case XTNDBLN:
+			return xtndbln_hash_table_iter_next(table->table, cursor);
+		case XUCKOO:
+			return xuckoo_hash_table_iter_next(table->table, cursor);
+		case XUCKOON:
+			return xuckoon_hash_table_iter_next(table->table, cursor);
+		case AUTO:
+			return adaptive_hash_table_iter_next(table->table, cursor);
+		default:
+			return NULL;
+	}
+}
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table) {
 	assert(table != NULL);
@@ -199,6 +419,9 @@ void hash_table_print(HashTable *table) {
 		case XUCKOON:
 			xuckoon_hash_table_print(table->table);
 			break;
+		case AUTO:
+			adaptive_hash_table_print(table->table);
+			break;
 		default:
 			break;
 	}
@@ -228,7 +451,184 @@ void hash_table_stats(HashTable *table) {
 		case XUCKOON:
 			xuckoon_hash_table_stats(table->table);
 			break;
+		case AUTO:
+			adaptive_hash_table_stats(table->table);
+			break;
+		default:
+			break;
+	}
+}
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double hash_table_load_factor(HashTable *table) {
+	assert(table != NULL);
+
+	// forward the call onto the relevant load factor function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_load_factor(table->table);
+		case XTNDBL1:
+			return xtndbl1_hash_table_load_factor(table->table);
+		case CUCKOO:
+			return cuckoo_hash_table_load_factor(table->table);
+		case XTNDBLN:
+			return xtndbln_hash_table_load_factor(table->table);
+		case XUCKOO:
+			return xuckoo_hash_table_load_factor(table->table);
+		case XUCKOON:
+			return xuckoon_hash_table_load_factor(table->table);
+		case AUTO:
+			return adaptive_hash_table_load_factor(table->table);
+		default:
+			return 0;
+	}
+}
+
+// calculate exactly how many bytes of memory 'table' is currently using,
+// broken down by what they're used for
+MemoryUsage hash_table_memory_usage(HashTable *table) {
+	assert(table != NULL);
+
+	// forward the call onto the relevant memory usage function
+	MemoryUsage usage = { 0 };
+	switch (table->type) {
+		case LINEAR:
+			usage = linear_hash_table_memory_usage(table->table);
+			break;
+		case XTNDBL1:
+			usage = xtndbl1_hash_table_memory_usage(table->table);
+			break;
+		case CUCKOO:
+			usage = cuckoo_hash_table_memory_usage(table->table);
+			break;
+		case XTNDBLN:
+			usage = xtndbln_hash_table_memory_usage(table->table);
+			break;
+		case XUCKOO:
+			usage = xuckoo_hash_table_memory_usage(table->table);
+			break;
+		case XUCKOON:
+			usage = xuckoon_hash_table_memory_usage(table->table);
+			break;
+		case AUTO:
+			usage = adaptive_hash_table_memory_usage(table->table);
+			break;
+		default:
+			break;
+	}
+
+	// plus the wrapper struct itself
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+	return usage;
+}
+
+// save 'table' to a binary snapshot file at 'path', preserving its internal
+// layout (slot arrays, or table of bucket pointers plus buckets)
+// returns true if the snapshot was written successfully, false if not
+bool hash_table_save(HashTable *table, const char *path) {
+	assert(table != NULL);
+
+	// an adaptive table is saved as whichever layout it has settled on
+	if (table->type == AUTO) {
+		return hash_table_save(adaptive_hash_table_settle(table->table), path);
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	// the header records the table type, so we know which load function to
+	// call later
+	snapshot_write_header(file, table->type);
+
+	// call the relevant save function
+	switch (table->type) {
+		case LINEAR:
+			linear_hash_table_save(table->table, file);
+			break;
+		case XTNDBL1:
+			xtndbl1_hash_table_save(table->table, file);
+			break;
+		case CUCKOO:
+			cuckoo_hash_table_save(table->table, file);
+			break;
+		case XTNDBLN:
+			xtndbln_hash_table_save(table->table, file);
+			break;
+		case XUCKOO:
+			xuckoo_hash_table_save(table->table, file);
+			break;
+		case XUCKOON:
+			xuckoon_hash_table_save(table->table, file);
+			break;
+		default:
+			break;
+	}
+
+	// check that everything made it out to the file
+	bool ok = !ferror(file);
+	if (fclose(file) != 0) {
+		ok = false;
+	}
+	return ok;
+}
+
+// load a table from a snapshot file at 'path' written by hash_table_save()
+// returns the table's pointer, or NULL (after printing why to stderr) if
+// 'path' is not a valid snapshot, or has been cut short or corrupted
+HashTable *hash_table_load(const char *path) {
+
+	// map the file into memory and find out what kind of table is inside
+	Snapshot *snapshot = snapshot_open(path);
+	if (snapshot == NULL) {
+		fprintf(stderr, "%s: can't open snapshot (missing, unreadable or too "
+			"short)\n", path);
+		return NULL;
+	}
+	TableType type = snapshot_read_header(snapshot);
+
+	// allocate space for the table wrapper
+	HashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->type = type;
+	table->snapshot = snapshot;
+
+	// load the table itself, straight out of the snapshot
+	switch (type) {
+		case LINEAR:
+			table->table = linear_hash_table_load(snapshot);
+			break;
+		case XTNDBL1:
+			table->table = xtndbl1_hash_table_load(snapshot);
+			break;
+		case CUCKOO:
+			table->table = cuckoo_hash_table_load(snapshot);
+			break;
+		case XTNDBLN:
+			table->table = xtndbln_hash_table_load(snapshot);
+			break;
+		case XUCKOO:
+			table->table = xuckoo_hash_table_load(snapshot);
+			break;
+		case XUCKOON:
+			table->table = xuckoon_hash_table_load(snapshot);
+			break;
 		default:
+			table->table = NULL;
+			snapshot_fail(snapshot, "unknown table type");
 			break;
 	}
+
+	// not a snapshot we understand, or one that's been cut short or
+	// corrupted? error. release memory and return NULL
+	if (table->table == NULL) {
+		fprintf(stderr, "%s: can't load snapshot: %s\n", path,
+			snapshot->error);
+		snapshot_close(snapshot);
+		free(table);
+		return NULL;
+	}
+
+	return table;
 }
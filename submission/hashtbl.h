@@ -11,11 +11,12 @@
 
 #include <stdbool.h>
 #include "inthash.h"
+#include "memusage.h"
 
 // enumerated type containing constants for the various types of hash table
 // supported
 typedef enum type {
-	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO, XUCKOON
+	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO, XUCKOON, AUTO
 } TableType;
 
 // converts from a string representation to a TableType constant:
@@ -25,17 +26,34 @@ typedef enum type {
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
 // "xuckoon"		->	XUCKOON
+// "auto"			->	AUTO (adapts its layout to the workload)
 TableType strtotype(char *str);
 
 typedef struct table HashTable;
 
 // initialise a hash table of type 'type' with initial size 'size',
 // and return its pointer
-HashTable *new_hash_table(TableType type, int size);
+HashTable *new_hash_table(TableType type, size64 size);
+
+// build a hash table of type 'type' containing the 'n' keys in 'keys' (which
+// may contain duplicates), sized up front to hold them all and filled in
+// parallel by 'nthreads' threads. 'size' is the bucket size for the multi-key
+// bucket types, as in new_hash_table(); the other types size themselves from
+// 'n' and ignore it
+HashTable *hash_table_bulk_load(TableType type, int size, int64 *keys,
+	size64 n, int nthreads);
 
 // free all memory associated with 'table'
 void free_hash_table(HashTable *table);
 
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), preallocating slots, or buckets and a deeper table of pointers to
+// them, so that inserting that many keys does not need to grow the table
+// along the way (though single-key bucket tables still double whenever two
+// keys share every bit of their table of bucket pointers). the same for every
+// type (unlike the 'size' given to new_hash_table()). never shrinks the table
+void hash_table_reserve(HashTable *table, size64 nkeys);
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool hash_table_insert(HashTable *table, int64 key);
@@ -44,10 +62,72 @@ bool hash_table_insert(HashTable *table, int64 key);
 // returns true if found, false if not
 bool hash_table_lookup(HashTable *table, int64 key);
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool hash_table_put(HashTable *table, int64 key, int64 value);
+
+// lookup the value stored with 'key' inside 'table', copying it into *value
+// (unless 'value' is NULL)
+// returns true if found, false if not (leaving *value untouched)
+bool hash_table_get(HashTable *table, int64 key, int64 *value);
+
+// find where the value for 'key' is stored inside 'table'
+// returns a pointer to the value inside the table (only valid until the next
+// insertion, or for AUTO tables, which move keys on lookups too, the next
+// operation of any kind), or NULL if not found
+int64 *hash_table_find_value(HashTable *table, int64 key);
+
+// replace the value stored with 'key' inside 'table' by 'value', if 'key' is
+// in there (does not insert 'key' otherwise)
+// returns true if the value was updated, false if 'key' was not found
+bool hash_table_update(HashTable *table, int64 key, int64 value);
+
+// an iterator over the entries inside a table, which can live on the stack.
+// set it up with hash_table_iter_begin(), then call hash_table_iter_next()
+// until it returns NULL
+typedef struct iter {
+	HashTable *table;	// the table being iterated over
+	Cursor cursor;		// where we're up to inside it
+} HashTableIter;
+
+// set up 'iter' to visit every entry inside 'table'
+void hash_table_iter_begin(HashTable *table, HashTableIter *iter);
+
+// advance 'iter' to the next entry inside its table
+// returns a pointer to the entry inside the table itself, without copying it,
+// or NULL once every entry has been visited. the entry's value may be changed
+// through this pointer, but not its key. inserting into the table while
+// iterating (or for AUTO tables, any other operation) invalidates both the
+// pointer and the iterator
+Entry *hash_table_iter_next(HashTableIter *iter);
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table);
 
 // print some statistics about 'table' to stdout
 void hash_table_stats(HashTable *table);
 
+// how full 'table' is: the fraction of its key slots currently holding a key
+double hash_table_load_factor(HashTable *table);
+
+// calculate exactly how many bytes of memory 'table' is currently using,
+// broken down into slots, in-use flags, tables of bucket pointers, bucket
+// headers, keys and values inside buckets, and overhead (structs and the
+// allocator's own bookkeeping). see memory_total() for the grand total
+MemoryUsage hash_table_memory_usage(HashTable *table);
+
+// save 'table' to a binary snapshot file at 'path', preserving its internal
+// layout (slot arrays, or table of bucket pointers plus buckets)
+// returns true if the snapshot was written successfully, false if not
+bool hash_table_save(HashTable *table, const char *path);
+
+// load a table from a snapshot file at 'path' written by hash_table_save().
+// the file is mapped into memory and the table serves lookups straight from
+// it, without re-inserting any keys (changes made to the table afterwards are
+// never written back to the file)
+// returns the table's pointer, or NULL (after printing why to stderr) if
+// 'path' is not a valid snapshot, or has been cut short or corrupted
+HashTable *hash_table_load(const char *path);
+
 #endif
@@ -0,0 +1,86 @@
+/* * * * * * * * *
+ * Module for allocating the large arrays inside hash tables (slots, in-use
+ * flags, and tables of bucket pointers) so that the kernel can back them with
+ * huge pages. a table of billions of slots probed at random would otherwise
+ * miss in the TLB on nearly every access, with ordinary 4KB pages
+ *
+ * large arrays are aligned to huge pages with posix_memalign() and marked with
+ * madvise(MADV_HUGEPAGE), which asks for huge pages even when transparent huge
+ * pages are only enabled on request. they can still be freed with free()
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _DEFAULT_SOURCE  // for posix_memalign, madvise
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>  // for memset, memcpy
+#include <assert.h>
+#include <sys/mman.h>
+
+#include "hugemem.h"
+
+// allocate an uninitialised array of 'bytes' bytes, aligned to (and filling)
+// whole huge pages if it is at least HUGE_PAGE_SIZE bytes long
+// returns NULL if there's not enough memory, like malloc()
+void *huge_malloc(size_t bytes) {
+	if (bytes < HUGE_PAGE_SIZE) {
+		return malloc(bytes > 0 ? bytes : 1);
+	}
+
+	// round up to whole huge pages, so the last one isn't shared with
+	// anything else
+	size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE
+		* HUGE_PAGE_SIZE;
+	void *block;
+	if (posix_memalign(&block, HUGE_PAGE_SIZE, rounded) != 0) {
+		return NULL;
+	}
+
+#ifdef MADV_HUGEPAGE
+	// only a hint: if the kernel won't, ordinary pages work just the same
+	madvise(block, rounded, MADV_HUGEPAGE);
+#endif
+	return block;
+}
+
+// allocate an array of 'n' elements of 'size' bytes each, all zero, as
+// huge_malloc() does
+// returns NULL if there's not enough memory, like calloc()
+void *huge_calloc(size_t n, size_t size) {
+	assert(size == 0 || n <= SIZE_MAX / size);
+
+	size_t bytes = n * size;
+	if (bytes < HUGE_PAGE_SIZE) {
+		return calloc(n > 0 ? n : 1, size > 0 ? size : 1);
+	}
+
+	void *block = huge_malloc(bytes);
+	if (block != NULL) {
+		memset(block, 0, bytes);
+	}
+	return block;
+}
+
+// resize the array at 'block' (allocated by these functions, holding 'old'
+// bytes) to hold 'bytes' bytes, keeping its contents, as huge_malloc() would
+// have allocated it. 'block' is freed (unless it is returned)
+// returns NULL if there's not enough memory, like realloc()
+void *huge_realloc(void *block, size_t old, size_t bytes) {
+	if (bytes < HUGE_PAGE_SIZE) {
+		return realloc(block, bytes > 0 ? bytes : 1);
+	}
+
+	// realloc() wouldn't keep the alignment, so move the contents by hand
+	void *resized = huge_malloc(bytes);
+	if (resized == NULL) {
+		return NULL;
+	}
+	if (block != NULL) {
+		memcpy(resized, block, (old < bytes) ? old : bytes);
+		free(block);
+	}
+	return resized;
+}
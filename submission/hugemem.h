@@ -0,0 +1,38 @@
+/* * * * * * * * *
+ * Module for allocating the large arrays inside hash tables (slots, in-use
+ * flags, and tables of bucket pointers) so that the kernel can back them with
+ * huge pages. a table of billions of slots probed at random would otherwise
+ * miss in the TLB on nearly every access, with ordinary 4KB pages
+ *
+ * the memory these functions return is freed with free(), like any other
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef HUGEMEM_H
+#define HUGEMEM_H
+
+#include <stddef.h>
+
+// the size of a huge page (on x86-64 linux, with transparent huge pages).
+// arrays smaller than this are allocated as usual
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// allocate an uninitialised array of 'bytes' bytes, aligned to (and filling)
+// whole huge pages if it is at least HUGE_PAGE_SIZE bytes long
+// returns NULL if there's not enough memory, like malloc()
+void *huge_malloc(size_t bytes);
+
+// allocate an array of 'n' elements of 'size' bytes each, all zero, as
+// huge_malloc() does
+// returns NULL if there's not enough memory, like calloc()
+void *huge_calloc(size_t n, size_t size);
+
+// resize the array at 'block' (allocated by these functions, holding 'old'
+// bytes) to hold 'bytes' bytes, keeping its contents, as huge_malloc() would
+// have allocated it. 'block' is freed (unless it is returned)
+// returns NULL if there's not enough memory, like realloc()
+void *huge_realloc(void *block, size_t old, size_t bytes);
+
+#endif
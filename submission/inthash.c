@@ -1,21 +1,37 @@
 /* * * * * * * * *
- * Module containing hash functions for 64-bit unsigned integers
+ * Module containing hash functions for 64-bit unsigned integers, both the
+ * original two fixed functions and seedable families of them
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
 #include "inthash.h"
 
+// the vector kernels for hasher_hash_batch() are compiled for AVX2 wherever
+// the compiler can target it, whatever the rest of the program is compiled
+// for. whether the cpu running the program has AVX2 is checked at run time
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_AVX2_KERNELS
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
 // constants for first hash function
 #define A1 885390553
 #define B1 639360243
-#define p1 2147483629
+#define p1 HASH_PRIME1
 
 // constants for second hash function
 #define A2 853977193
 #define B2 306837493
-#define p2 2147483563
+#define p2 HASH_PRIME2
 
 // first available hash function
 int h1(int64 k) {
@@ -26,3 +42,434 @@ int h1(int64 k) {
 int h2(int64 k) {
 	return (A2 * k + B2) % p2;
 }
+
+// 'base' to the power of 'exponent', modulo 'modulus' (below 2^32)
+static int64 power_mod(int64 base, int64 exponent, int64 modulus) {
+	int64 result = 1;
+	base %= modulus;
+	while (exponent > 0) {
+		if (exponent & 1) {
+			result = result * base % modulus;
+		}
+		base = base * base % modulus;
+		exponent >>= 1;
+	}
+	return result;
+}
+
+// a key (below p1) that h1() hashes to 'hash' (below p1): since A1 * key + B1
+// can't overflow for such keys, it's (hash - B1) / A1, working modulo p1
+int64 h1_preimage(int hash) {
+	assert(hash >= 0 && hash < p1);
+	int64 inverse = power_mod(A1, p1 - 2, p1);	// by fermat's little theorem
+	return ((int64) hash + p1 - B1) % p1 * inverse % p1;
+}
+
+
+/* * * *
+ * hash families
+ */
+
+// added to the splitmix64 generator's state at each step
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+
+// the family new tables hash with
+static HashFamily default_family = HASH_MODPRIME;
+
+// where new tables' seeds come from: the splitmix64 generator at
+// 'seed_state' (0 until it's first needed), unless seeds have been fixed
+static int64 seed_state = 0;
+static bool fixed_seeds = false;
+static int64 fixed_seed;
+
+// the names of each family, for converting to and from strings
+static const char *family_names[NUM_HASH_FAMILIES] = {
+	"modprime", "multshift", "tabulation", "mixer"
+};
+
+// splitmix64's output function, scrambling the generator state 'z'
+static int64 mix(int64 z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// the next pseudo-random word from the splitmix64 generator at 'state', for
+// turning one seed into as many constants as a family needs
+static int64 splitmix(int64 *state) {
+	return mix(*state += GOLDEN_GAMMA);
+}
+
+// a random (non-zero) starting state for the seed generator, from the
+// operating system if it can provide one, or else from the time and the
+// address space layout
+static int64 random_state(void) {
+	int64 state = 0;
+	FILE *urandom = fopen("/dev/urandom", "rb");
+	if (urandom != NULL) {
+		if (fread(&state, sizeof state, 1, urandom) != 1) {
+			state = 0;
+		}
+		fclose(urandom);
+	}
+	if (state == 0) {
+		state = mix((int64) time(NULL) ^ (int64) clock()
+			^ (int64) (size_t) &state);
+	}
+	return state | 1;
+}
+
+// set up 'hasher' as the member of 'family' chosen by 'seed'
+void hasher_init(Hasher *hasher, HashFamily family, int64 seed) {
+	assert(hasher);
+	assert(family < NUM_HASH_FAMILIES);
+
+	hasher->family = family;
+	hasher->seed = seed;
+	hasher->tables = NULL;
+
+	int64 state = seed;
+	int i;
+	switch (family) {
+		case HASH_MODPRIME:
+			if (seed == 0) {
+				// h1() and h2() exactly
+				int64 params[4] = {A1, B1, A2, B2};
+				memcpy(hasher->params, params, sizeof params);
+			} else {
+				hasher->params[0] = 1 + splitmix(&state) % (p1 - 1);
+				hasher->params[1] = splitmix(&state) % p1;
+				hasher->params[2] = 1 + splitmix(&state) % (p2 - 1);
+				hasher->params[3] = splitmix(&state) % p2;
+			}
+			break;
+
+		case HASH_TABULATION:
+			hasher->tables = malloc(HASH_TABULATION_TABLES
+				* sizeof *hasher->tables);
+			assert(hasher->tables);
+			for (i = 0; i < HASH_TABULATION_TABLES * 256; i++) {
+				hasher->tables[i / 256][i % 256] = splitmix(&state);
+			}
+			break;
+
+		default:
+			for (i = 0; i < 4; i++) {
+				hasher->params[i] = splitmix(&state);
+			}
+			break;
+	}
+}
+
+// set up 'hasher' as a new hash function for a table whose keys collide far
+// more than they should under 'old'
+void hasher_init_next(Hasher *hasher, Hasher *old) {
+	assert(hasher);
+	assert(old);
+
+	HashFamily family = old->family;
+	if (family == HASH_MODPRIME) {
+		family = HASH_MULTSHIFT;
+	}
+
+	// with fixed seeds, the next seed follows from the last one
+	int64 seed;
+	if (fixed_seeds) {
+		int64 state = old->seed;
+		seed = splitmix(&state);
+	} else {
+		seed = hash_new_seed();
+	}
+	hasher_init(hasher, family, seed);
+}
+
+// free all memory associated with 'hasher'
+void hasher_free(Hasher *hasher) {
+	assert(hasher);
+	free(hasher->tables);
+	hasher->tables = NULL;
+}
+
+
+
+/* * * *
+ * hashing many keys at once
+ */
+
+#ifdef HAVE_AVX2_KERNELS
+
+// each kernel hashes the 4 keys in a vector at once, exactly as the scalar
+// functions in inthash.h would
+
+// the bottom 64 bits of each product of 'a' and 'b' (which AVX2 can only
+// multiply 32 bits at a time)
+AVX2 static __m256i mullo64(__m256i a, __m256i b) {
+	__m256i low = _mm256_mul_epu32(a, b);
+	__m256i cross = _mm256_add_epi64(
+		_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+		_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+// the top 64 bits of each full 128-bit product of 'a' and 'b', by long
+// multiplication, 32 bits at a time
+AVX2 static __m256i mulhi64(__m256i a, __m256i b) {
+	const __m256i mask = _mm256_set1_epi64x(0xffffffff);
+	__m256i a1 = _mm256_srli_epi64(a, 32), b1 = _mm256_srli_epi64(b, 32);
+	__m256i p00 = _mm256_mul_epu32(a, b), p01 = _mm256_mul_epu32(a, b1);
+	__m256i p10 = _mm256_mul_epu32(a1, b), p11 = _mm256_mul_epu32(a1, b1);
+	__m256i middle = _mm256_add_epi64(_mm256_srli_epi64(p00, 32),
+		_mm256_add_epi64(_mm256_and_si256(p01, mask),
+			_mm256_and_si256(p10, mask)));
+	__m256i high = _mm256_add_epi64(p11, _mm256_add_epi64(
+		_mm256_srli_epi64(p01, 32), _mm256_srli_epi64(p10, 32)));
+	return _mm256_add_epi64(high, _mm256_srli_epi64(middle, 32));
+}
+
+// each of 'x' modulo 'prime', which must be 2^31 - c for some small c: with
+// no vector division, the bits above 2^32 and then 2^31 are folded down
+// (2^32 and 2^31 being 2c and c, modulo the prime), leaving at most one
+// subtraction to do
+AVX2 static __m256i mod_prime(__m256i x, int64 prime) {
+	const int64 c = (1LL << 31) - prime;
+	x = _mm256_add_epi64(
+		_mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_set1_epi64x(2 * c)),
+		_mm256_and_si256(x, _mm256_set1_epi64x(0xffffffff)));
+	x = _mm256_add_epi64(
+		_mm256_mul_epu32(_mm256_srli_epi64(x, 31), _mm256_set1_epi64x(c)),
+		_mm256_and_si256(x, _mm256_set1_epi64x(0x7fffffff)));
+	__m256i over = _mm256_cmpgt_epi64(x, _mm256_set1_epi64x(prime - 1));
+	return _mm256_sub_epi64(x,
+		_mm256_and_si256(over, _mm256_set1_epi64x(prime)));
+}
+
+// hash_modprime() on 4 keys
+AVX2 static __m256i modprime4(const Hasher *hasher, __m256i keys) {
+	const int64 *params = hasher->params;
+	__m256i first = mod_prime(_mm256_add_epi64(
+		mullo64(keys, _mm256_set1_epi64x(params[0])),
+		_mm256_set1_epi64x(params[1])), HASH_PRIME1);
+	__m256i second = mod_prime(_mm256_add_epi64(
+		mullo64(keys, _mm256_set1_epi64x(params[2])),
+		_mm256_set1_epi64x(params[3])), HASH_PRIME2);
+	__m256i tops = _mm256_or_si256(
+		_mm256_slli_epi64(_mm256_srli_epi64(second, 30), 31),
+		_mm256_slli_epi64(_mm256_srli_epi64(first, 30), 63));
+	return _mm256_or_si256(_mm256_or_si256(first, tops),
+		_mm256_slli_epi64(second, 32));
+}
+
+// hash_multshift() on 4 keys
+AVX2 static __m256i multshift4(const Hasher *hasher, __m256i keys) {
+	const int64 *params = hasher->params;
+	__m256i a0 = _mm256_set1_epi64x(params[0]);
+	__m256i b0 = _mm256_set1_epi64x(params[1]);
+	__m256i low = mullo64(keys, a0);
+	__m256i high = mulhi64(keys, a0);
+
+	// the carry out of low + B's bottom half (comparing unsigned numbers by
+	// flipping their sign bits first) is -1 where it happens, and 0 elsewhere
+	const __m256i sign = _mm256_set1_epi64x(1ULL << 63);
+	__m256i sum = _mm256_add_epi64(low, b0);
+	__m256i carry = _mm256_cmpgt_epi64(_mm256_xor_si256(low, sign),
+		_mm256_xor_si256(sum, sign));
+
+	high = _mm256_add_epi64(high,
+		mullo64(keys, _mm256_set1_epi64x(params[2])));
+	high = _mm256_add_epi64(high, _mm256_set1_epi64x(params[3]));
+	return _mm256_sub_epi64(high, carry);
+}
+
+// hash_tabulation() on 4 keys, gathering each byte's words from its table
+AVX2 static __m256i tabulation4(const Hasher *hasher, __m256i keys) {
+	const __m256i byte = _mm256_set1_epi64x(0xff);
+	__m256i hash = _mm256_setzero_si256();
+	int i;
+	for (i = 0; i < HASH_TABULATION_TABLES; i++) {
+		__m256i index = _mm256_and_si256(keys, byte);
+		hash = _mm256_xor_si256(hash, _mm256_i64gather_epi64(
+			(const long long *) hasher->tables[i], index, 8));
+		keys = _mm256_srli_epi64(keys, 8);
+	}
+	return hash;
+}
+
+// hash_mixer() on 4 keys
+AVX2 static __m256i mixer4(const Hasher *hasher, __m256i keys) {
+	const __m256i prime = _mm256_set1_epi64x(HASH_MIX_PRIME);
+	__m256i hash = _mm256_xor_si256(keys,
+		_mm256_set1_epi64x(hasher->params[0]));
+	__m256i rotated = _mm256_xor_si256(
+		_mm256_or_si256(_mm256_slli_epi64(hash, 49),
+			_mm256_srli_epi64(hash, 15)),
+		_mm256_or_si256(_mm256_slli_epi64(hash, 24),
+			_mm256_srli_epi64(hash, 40)));
+	hash = mullo64(_mm256_xor_si256(hash, rotated), prime);
+	hash = _mm256_xor_si256(hash, _mm256_add_epi64(
+		_mm256_srli_epi64(hash, 35), _mm256_set1_epi64x(sizeof (int64))));
+	hash = mullo64(hash, prime);
+	return _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 28));
+}
+
+// hash as many of the 'n' keys in 'keys' as fit in whole vectors into
+// 'hashes' with 'kernel', leaving 'i' at how many that was
+#define HASH_VECTORS(kernel, hasher, keys, hashes, n, i) \
+	for (i = 0; i + 4 <= n; i += 4) { \
+		__m256i vector = _mm256_loadu_si256((const __m256i *) (keys + i)); \
+		_mm256_storeu_si256((__m256i *) (hashes + i), kernel(hasher, vector)); \
+	}
+
+// hash as many of the 'n' keys in 'keys' as fit in whole vectors into
+// 'hashes', returning how many that was. each family gets a loop of its own,
+// so that its kernel can be inlined into it
+AVX2 static int hash_batch_avx2(const Hasher *hasher, const int64 *keys,
+	int64 *hashes, int n) {
+	int i;
+	switch (hasher->family) {
+		case HASH_MODPRIME:
+			HASH_VECTORS(modprime4, hasher, keys, hashes, n, i);
+			break;
+		case HASH_MULTSHIFT:
+			HASH_VECTORS(multshift4, hasher, keys, hashes, n, i);
+			break;
+		case HASH_TABULATION:
+			HASH_VECTORS(tabulation4, hasher, keys, hashes, n, i);
+			break;
+		default:
+			HASH_VECTORS(mixer4, hasher, keys, hashes, n, i);
+			break;
+	}
+	return i;
+}
+
+// does the cpu running this program have AVX2? (asked once)
+static bool have_avx2(void) {
+	static int avx2 = -1;
+	if (avx2 < 0) {
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return avx2;
+}
+
+#endif
+
+// hash each of the 'n' keys in 'keys' to 64 bits with 'hasher', storing the
+// hash values in 'hashes'
+void hasher_hash_batch(Hasher *hasher, const int64 *keys, int64 *hashes,
+	int n) {
+	assert(hasher);
+
+	int i = 0;
+#ifdef HAVE_AVX2_KERNELS
+	if (have_avx2()) {
+		i = hash_batch_avx2(hasher, keys, hashes, n);
+	}
+#endif
+
+	// any keys left over (or all of them, without AVX2) one at a time
+	for (; i < n; i++) {
+		hashes[i] = hasher_hash(hasher, keys[i]);
+	}
+}
+
+// the hash value under 'hasher' of the key in each of the 'n' entries in
+// 'entries', stored in 'hashes': the values cached in the entries if entries
+// keep them, or else worked out a batch at a time
+void hasher_hash_entries(Hasher *hasher, const Entry *entries, int64 *hashes,
+	int n) {
+	int i;
+#if CACHE_HASHES
+	for (i = 0; i < n; i++) {
+		hashes[i] = entries[i].hash;
+	}
+#else
+	int64 keys[HASH_BATCH];
+	for (i = 0; i < n; i += HASH_BATCH) {
+		int batch = (n - i < HASH_BATCH) ? n - i : HASH_BATCH;
+		int j;
+		for (j = 0; j < batch; j++) {
+			keys[j] = entries[i + j].key;
+		}
+		hasher_hash_batch(hasher, keys, hashes + i, batch);
+	}
+#endif
+}
+
+// work out the hash values cached in the 'n' entries in 'entries' afresh with
+// 'hasher' (after their table has changed hash function), if entries keep them
+void hasher_rehash_entries(Hasher *hasher, Entry *entries, int n) {
+#if CACHE_HASHES
+	int64 keys[HASH_BATCH], hashes[HASH_BATCH];
+	int i;
+	for (i = 0; i < n; i += HASH_BATCH) {
+		int batch = (n - i < HASH_BATCH) ? n - i : HASH_BATCH;
+		int j;
+		for (j = 0; j < batch; j++) {
+			keys[j] = entries[i + j].key;
+		}
+		hasher_hash_batch(hasher, keys, hashes, batch);
+		for (j = 0; j < batch; j++) {
+			entries[i + j].hash = hashes[j];
+		}
+	}
+#endif
+}
+
+// how many bytes 'hasher' has allocated (in hasher->tables)
+size_t hasher_table_bytes(Hasher *hasher) {
+	return (hasher->tables != NULL)
+		? HASH_TABULATION_TABLES * sizeof *hasher->tables : 0;
+}
+
+// the family that new tables should hash with from now on
+void hash_set_default_family(HashFamily family) {
+	assert(family < NUM_HASH_FAMILIES);
+	default_family = family;
+}
+
+// the family that new tables should hash with
+HashFamily hash_default_family(void) {
+	return default_family;
+}
+
+// a seed for a new table's hash function: fresh and random, unless seeds have
+// been fixed
+int64 hash_new_seed(void) {
+	if (fixed_seeds) {
+		return fixed_seed;
+	}
+
+	// start the generator on first use (if two threads race to do it, only
+	// one of their states is kept)
+	int64 state = __atomic_load_n(&seed_state, __ATOMIC_RELAXED);
+	if (state == 0) {
+		__atomic_compare_exchange_n(&seed_state, &state, random_state(),
+			false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+	return mix(__atomic_add_fetch(&seed_state, GOLDEN_GAMMA,
+		__ATOMIC_RELAXED));
+}
+
+// give every table from now on seed 'seed' instead of a random one
+void hash_fix_seed(int64 seed) {
+	fixed_seeds = true;
+	fixed_seed = seed;
+}
+
+// convert a string to a hash family, or NOFAMILY if it's not one
+HashFamily strtofamily(const char *name) {
+	int family;
+	for (family = 0; family < NUM_HASH_FAMILIES; family++) {
+		if (strcmp(name, family_names[family]) == 0) {
+			return family;
+		}
+	}
+	return NOFAMILY;
+}
+
+// the name of 'family'
+const char *familytostr(HashFamily family) {
+	assert(family < NUM_HASH_FAMILIES);
+	return family_names[family];
+}
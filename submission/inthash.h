@@ -1,6 +1,14 @@
 /* * * * * * * * *
- * Module containing hash functions for 64-bit unsigned integers
- * 
+ * Module containing hash functions for 64-bit unsigned integers, both the
+ * original two fixed functions and seedable families of them
+ *
+ * hashing a single key with a family is defined here in the header, so that
+ * it can be inlined into each table's operations. hashing many keys at once
+ * (see hasher_hash_batch) uses vector instructions where the cpu has them
+ *
+ * tables can also keep each key's hash value in its entry (see CACHE_HASHES),
+ * so that entries can be moved around as a table grows without hashing their
+ * keys again
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
@@ -10,15 +18,48 @@
 #define INTHASH_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
-// the maximum allowable table size; 2^27 = ~134 million entries
-// a table with this many 8 byte entries (e.g. pointers or 64-bit integers)
-// would take up 2^27 * 8 bytes = 2^30 bytes = 1GB of memory
-#define MAX_TABLE_SIZE 134217728
+// the maximum allowable table size; 2^40 = ~1.1 trillion entries, more than
+// any one machine could hold (a table with this many 16 byte entries would
+// take up 2^44 bytes = 16TB of memory). it only stops runaway growth
+#define MAX_TABLE_SIZE (1LL << 40)
 
 // alias for unsigned 64-bit integer type
 typedef uint64_t int64;
 
+// signed 64-bit integer type, for table sizes, addresses, and counts of keys,
+// which can all pass 2^31 (signed so that they can be counted down and
+// subtracted as freely as ints)
+typedef int64_t size64;
+
+// whether entries keep their key's hash value alongside it, chosen when
+// building with make CACHE=1 (see Makefile). moving an entry then costs no
+// hashing, at the price of 8 more bytes per entry
+#ifndef CACHE_HASHES
+#define CACHE_HASHES 0
+#endif
+
+// a key along with the 64-bit value stored next to it inside a table
+// (larger fixed-size records can be stored elsewhere and referred to by value)
+typedef struct entry {
+	int64 key;		// the key itself
+	int64 value;	// the value associated with this key
+#if CACHE_HASHES
+	int64 hash;		// the key's hash value under its table's hasher
+#endif
+} Entry;
+
+// a position inside a table, for iterating over its entries in place. each
+// table uses these fields however suits its layout
+typedef struct cursor {
+	int table;		// which inner table (for tables made of more than one)
+	size64 address;	// which slot, or which address in the table of buckets
+	int index;		// which position within a multi-key bucket
+	int stage;		// which table to walk, for tables wrapping several others
+} Cursor;
+
 
 // the following functions take a 64-bit integer key and return a 32-bit signed 
 // integer hash, calculated as ( A * key + B ) % p where p is a large prime.
@@ -36,4 +77,215 @@ int h1(int64 k);
 // second available hash function
 int h2(int64 k);
 
+// a key (below 2^31) that h1() hashes to 'hash', which must be below h1()'s
+// prime (2147483629), for making keys collide on purpose
+int64 h1_preimage(int hash);
+
+
+// families of hash functions for tables to choose between. each family has
+// many members, and each table picks out its own member with a 64-bit seed.
+// every member hashes a key to 64 bits, from which two hash values can be
+// taken (see HASH_FIRST and HASH_SECOND)
+typedef enum hash_family {
+	HASH_MODPRIME,		// h1() and h2() above, one in each half, with seed 0
+						// (other seeds choose other constants). uses two
+						// 64-bit modulos, and gives only 31 bits per half
+						// (the 32nd copied from the other half's 31st)
+	HASH_MULTSHIFT,		// multiply-shift: the top 64 bits of A * key + B
+						// (mod 2^128) for random 128-bit A and B. one wide
+						// multiplication, and 2-independent
+	HASH_TABULATION,	// simple tabulation: each byte of the key looks up a
+						// random word in a table of its own, and the words
+						// are xored together. 3-independent, which suits
+						// cuckoo hashing, but needs 16KB of tables
+	HASH_MIXER,			// xxh3-style mixer: the seeded key is scrambled with
+						// rotations, multiplications and xor-shifts. no
+						// guarantees, but the fastest of all
+	NUM_HASH_FAMILIES,
+	NOFAMILY = NUM_HASH_FAMILIES
+} HashFamily;
+
+// one member of a hash family, usually belonging to a single table
+typedef struct hasher {
+	HashFamily family;
+	int64 seed;				// which member of the family this is
+	int64 params[4];		// the constants the seed chose (see inthash.c)
+	int64 (*tables)[256];	// simple tabulation's tables, one per byte of a
+							// key (NULL for the other families)
+} Hasher;
+
+// two 64-bit hash values taken from the 64-bit hash value 'hash': 'hash'
+// itself, and 'hash' with its two halves swapped. a table with a power of two
+// size up to 2^32 addresses only the bottom bits of each, and so sees two
+// independent values, one from each half. larger tables use bits of both
+#define HASH_FIRST(hash)  ((int64) (hash))
+#define HASH_SECOND(hash) ((int64) (hash) >> 32 | (int64) (hash) << 32)
+
+// the primes h1() and h2() (and so HASH_MODPRIME) work modulo
+#define HASH_PRIME1 2147483629
+#define HASH_PRIME2 2147483563
+
+// how many byte tables simple tabulation uses: one per byte of a 64-bit key
+#define HASH_TABULATION_TABLES 8
+
+// multiplier used by the mixer (from xxh3)
+#define HASH_MIX_PRIME 0x9FB21C651E98DF25ULL
+
+// how many keys it's worth hashing at once with hasher_hash_batch(), for
+// callers working through a long array of keys in blocks
+#define HASH_BATCH 256
+
+// set up 'hasher' as the member of 'family' chosen by 'seed'
+void hasher_init(Hasher *hasher, HashFamily family, int64 seed);
+
+// set up 'hasher' as a new hash function for a table whose keys collide far
+// more than they should under 'old': another member of the same family,
+// except that HASH_MODPRIME (under which keys a multiple of its prime apart
+// collide whatever the seed) gives way to HASH_MULTSHIFT
+void hasher_init_next(Hasher *hasher, Hasher *old);
+
+// free all memory associated with 'hasher'
+void hasher_free(Hasher *hasher);
+
+// hash each of the 'n' keys in 'keys' to 64 bits with 'hasher', storing the
+// hash values in 'hashes' (exactly as hasher_hash() would, only faster)
+void hasher_hash_batch(Hasher *hasher, const int64 *keys, int64 *hashes,
+	int n);
+
+// the hash value under 'hasher' of the key in each of the 'n' entries in
+// 'entries', stored in 'hashes': the values cached in the entries if entries
+// keep them, or else worked out a batch at a time
+void hasher_hash_entries(Hasher *hasher, const Entry *entries, int64 *hashes,
+	int n);
+
+// work out the hash values cached in the 'n' entries in 'entries' afresh with
+// 'hasher' (after their table has changed hash function), if entries keep them
+void hasher_rehash_entries(Hasher *hasher, Entry *entries, int n);
+
+// how many bytes 'hasher' has allocated (in hasher->tables)
+size_t hasher_table_bytes(Hasher *hasher);
+
+// the family that new tables should hash with from now on (HASH_MODPRIME, to
+// begin with)
+void hash_set_default_family(HashFamily family);
+HashFamily hash_default_family(void);
+
+// a seed for a new table's hash function. each call gives a fresh random
+// seed (the generator itself seeded by the operating system), so that which
+// keys collide differs from table to table and from run to run, and can't
+// be worked out in advance. safe to call from several threads at once
+int64 hash_new_seed(void);
+
+// give every table from now on seed 'seed' instead, for repeatable runs.
+// tables that have to change seed then choose their next seed predictably,
+// too. under seed 0, HASH_MODPRIME's two halves hold h1() and h2(), but tables
+// take addresses from the whole 64-bit hash, and grow and reseed by rules of
+// their own, so not even seed 0 puts keys where h1() and h2() alone would
+void hash_fix_seed(int64 seed);
+
+// convert a string to a hash family ("modprime", "multshift", "tabulation"
+// or "mixer"), or NOFAMILY if it's not one of those
+HashFamily strtofamily(const char *name);
+
+// the name of 'family'
+const char *familytostr(HashFamily family);
+
+
+/* * * *
+ * hashing single keys (inline)
+ */
+
+// the full 128-bit product of 'x' and 'y', as its top and bottom 64 bits
+static inline void hash_multiply(int64 x, int64 y, int64 *high, int64 *low) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 product = (unsigned __int128) x * y;
+	*high = product >> 64;
+	*low = product;
+#else
+	// long multiplication, 32 bits at a time
+	int64 x0 = x & 0xffffffff, x1 = x >> 32;
+	int64 y0 = y & 0xffffffff, y1 = y >> 32;
+	int64 p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+	int64 middle = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+	*high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+	*low = (middle << 32) | (p00 & 0xffffffff);
+#endif
+}
+
+// (A1 * key + B1) % p1 in the bottom half, and (A2 * key + B2) % p2 in the
+// top, with the constants in params[0..3]. both are below 2^31, so the top
+// bit of each half is copied from the top bit of the other, which tables with
+// 2^32 addresses or more (or extendible tables 32 bits deep) would otherwise
+// never see set
+static inline int64 hash_modprime(const Hasher *hasher, int64 key) {
+	const int64 *params = hasher->params;
+	int64 first = (params[0] * key + params[1]) % HASH_PRIME1;
+	int64 second = (params[2] * key + params[3]) % HASH_PRIME2;
+	return first | (second >> 30) << 31 | second << 32 | (first >> 30) << 63;
+}
+
+// the top 64 bits of A * key + B (mod 2^128), where A and B are 128-bit
+// numbers with their bottom halves in params[0..1] and their top halves in
+// params[2..3]
+static inline int64 hash_multshift(const Hasher *hasher, int64 key) {
+	const int64 *params = hasher->params;
+	int64 high, low;
+	hash_multiply(params[0], key, &high, &low);
+	int64 carry = (low + params[1] < low);
+	return high + params[2] * key + params[3] + carry;
+}
+
+// the random words that each byte of 'key' looks up, xored together
+static inline int64 hash_tabulation(const Hasher *hasher, int64 key) {
+	int64 hash = 0;
+	int i;
+	for (i = 0; i < HASH_TABULATION_TABLES; i++) {
+		hash ^= hasher->tables[i][(key >> (8 * i)) & 0xff];
+	}
+	return hash;
+}
+
+// xxh3's 'rrmxmx' finaliser applied to 'key' xored with params[0]. it's a
+// bijection, so no two keys share a hash value
+static inline int64 hash_mixer(const Hasher *hasher, int64 key) {
+	int64 hash = key ^ hasher->params[0];
+	hash ^= ((hash << 49) | (hash >> 15)) ^ ((hash << 24) | (hash >> 40));
+	hash *= HASH_MIX_PRIME;
+	hash ^= (hash >> 35) + sizeof key;
+	hash *= HASH_MIX_PRIME;
+	return hash ^ (hash >> 28);
+}
+
+// hash 'key' to 64 bits with 'hasher'
+static inline int64 hasher_hash(const Hasher *hasher, int64 key) {
+	switch (hasher->family) {
+		case HASH_MODPRIME:
+			return hash_modprime(hasher, key);
+		case HASH_MULTSHIFT:
+			return hash_multshift(hasher, key);
+		case HASH_TABULATION:
+			return hash_tabulation(hasher, key);
+		default:
+			return hash_mixer(hasher, key);
+	}
+}
+
+// the hash value under 'hasher' of the key in 'entry': the one cached in the
+// entry if entries keep them, or else worked out afresh
+static inline int64 entry_hash(const Hasher *hasher, const Entry *entry) {
+#if CACHE_HASHES
+	return entry->hash;
+#else
+	return hasher_hash(hasher, entry->key);
+#endif
+}
+
+// remember that the key in 'entry' hashes to 'hash', if entries keep their
+// hash values
+static inline void entry_set_hash(Entry *entry, int64 hash) {
+#if CACHE_HASHES
+	entry->hash = hash;
+#endif
+}
+
 #endif
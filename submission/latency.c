@@ -0,0 +1,267 @@
+/* * * * * * * * *
+ * Module for recording how long a table's operations take: a sample of them
+ * is timed, and the times are kept in histograms (one per kind of operation)
+ * with buckets that grow with the times they hold, so that percentiles far
+ * out into the tail can be read off cheaply and to within a few percent
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>  // for memset
+#include <assert.h>
+#include <time.h>
+
+#include "latency.h"
+
+#if STATS_LEVEL >= STATS_COUNTERS
+// the names of each kind of operation, for printing
+static const char *op_names[NUM_OP_KINDS] = {
+	"lookup (hit)", "lookup (miss)", "insert", "resize"
+};
+#endif
+
+#if STATS_LEVEL >= STATS_FULL
+
+// times are bucketed by their highest set bit, and then split further by the
+// SUB_BITS bits below it, so each bucket is at most 1/2^SUB_BITS (12.5%) as
+// wide as the times it holds. times under SUB_BUCKETS ns get a bucket each
+#define SUB_BITS 3
+#define SUB_BUCKETS (1 << SUB_BITS)
+// times of 2^(MAX_SHIFT + SUB_BITS + 1) ns (about 17 seconds) or more all share
+// the last bucket
+#define MAX_SHIFT 30
+#define NUM_BUCKETS ((MAX_SHIFT + 2) * SUB_BUCKETS)
+
+// the times recorded for one kind of operation
+struct histogram {
+	int64 counts[NUM_BUCKETS];	// how many times fell in each bucket
+	int64 total;				// how many times altogether
+	int64 max;					// the longest time, in nanoseconds
+};
+
+// how many operations make up each sample of one timed operation (or 0 to
+// time nothing), shared by every table
+static int sample_period = DEFAULT_SAMPLE_PERIOD;
+
+
+/* * *
+ * helper functions
+ */
+
+// the current time in nanoseconds, from the monotonic clock (which is read
+// without entering the kernel on linux, so costs tens of nanoseconds rather
+// than the system call clock() can take)
+static int64 now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// which bucket a time of 'ns' nanoseconds falls in
+static int bucket_of(int64 ns) {
+	if (ns < SUB_BUCKETS) {
+		return ns;
+	}
+
+	// find the highest set bit, then keep the SUB_BITS bits below it
+	int high = SUB_BITS;
+	while (high < 63 && (ns >> (high + 1)) != 0) {
+		high++;
+	}
+	int shift = high - SUB_BITS;
+	if (shift > MAX_SHIFT) {
+		return NUM_BUCKETS - 1;
+	}
+	return (shift + 1) * SUB_BUCKETS + ((ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+// the time in the middle of bucket 'bucket', in nanoseconds
+static int64 bucket_middle(int bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	int shift = bucket / SUB_BUCKETS - 1;
+	int64 low = (int64) (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	return low + ((1LL << shift) >> 1);
+}
+
+// the time below which a fraction 'q' of the times in 'histogram' fall, in
+// nanoseconds (or the longest time, if that's lower)
+static int64 percentile(Histogram *histogram, double q) {
+	int64 rank = (int64) (q * histogram->total + 0.999999);
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	int64 seen = 0;
+	int bucket;
+	for (bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+		seen += histogram->counts[bucket];
+		if (seen >= rank) {
+			int64 middle = bucket_middle(bucket);
+			return (middle < histogram->max) ? middle : histogram->max;
+		}
+	}
+	return histogram->max;
+}
+
+
+/* * *
+ * all functions
+ */
+
+// time 1 in every 'period' operations from now on, in every table
+void latency_set_sample_period(int period) {
+	assert(period >= 0);
+	sample_period = period;
+}
+
+// set up 'latency' with no times recorded
+void latency_init(Latency *latency) {
+	assert(latency);
+	latency->nops = 0;
+	latency->histograms = NULL;
+}
+
+// free all memory associated with 'latency'
+void latency_free(Latency *latency) {
+	assert(latency);
+	free(latency->histograms);
+	latency->histograms = NULL;
+}
+
+// start timing an operation with 'timer', if it's one of the operations
+// chosen to be timed
+void latency_begin(Latency *latency, LatencyTimer *timer) {
+	// the first operation chosen is the last of the first period, so that a
+	// table which only ever sees a handful of operations needs no histograms
+	latency->nops++;
+	timer->sampled = (sample_period > 0 && latency->nops % sample_period == 0);
+	if (timer->sampled) {
+		timer->start = now();
+	}
+}
+
+// start timing an operation with 'timer', chosen or not
+void latency_begin_always(LatencyTimer *timer) {
+	timer->sampled = (sample_period > 0);
+	if (timer->sampled) {
+		timer->start = now();
+	}
+}
+
+// finish timing the operation 'timer' is timing (if it is), recording its
+// time in 'latency' as an operation of kind 'kind'
+void latency_end(Latency *latency, LatencyTimer *timer, OpKind kind) {
+	if (!timer->sampled) {
+		return;
+	}
+	int64 ns = now() - timer->start;
+
+	if (latency->histograms == NULL) {
+		latency->histograms = calloc(NUM_OP_KINDS,
+			sizeof *latency->histograms);
+		assert(latency->histograms);
+	}
+
+	Histogram *histogram = &latency->histograms[kind];
+	histogram->counts[bucket_of(ns)]++;
+	histogram->total++;
+	if (ns > histogram->max) {
+		histogram->max = ns;
+	}
+}
+
+// count the memory used by 'latency' towards usage->overhead
+void latency_memory_usage(Latency *latency, MemoryUsage *usage) {
+	if (latency->histograms != NULL) {
+		memory_count(usage, &usage->overhead, latency->histograms,
+			NUM_OP_KINDS * sizeof *latency->histograms, NULL);
+	}
+}
+
+// print how many times have been recorded of each kind of operation, along
+// with their median, 99th and 99.9th percentiles, to stdout
+void latency_print(Latency *latency) {
+	assert(latency);
+
+	if (sample_period == 0) {
+		printf("operation times: not recorded\n");
+		return;
+	}
+	printf("operation times (1 in %d timed, resizes all timed):\n",
+		sample_period);
+	if (latency->histograms == NULL) {
+		printf("    none yet\n");
+		return;
+	}
+
+	printf("    %-14s %8s %10s %10s %10s %10s\n", "operation", "timed",
+		"p50 (ns)", "p99 (ns)", "p99.9 (ns)", "max (ns)");
+	int kind;
+	for (kind = 0; kind < NUM_OP_KINDS; kind++) {
+		Histogram *histogram = &latency->histograms[kind];
+		if (histogram->total == 0) {
+			continue;
+		}
+		printf("    %-14s %8llu %10llu %10llu %10llu %10llu\n",
+			op_names[kind], (unsigned long long) histogram->total,
+			(unsigned long long) percentile(histogram, 0.5),
+			(unsigned long long) percentile(histogram, 0.99),
+			(unsigned long long) percentile(histogram, 0.999),
+			(unsigned long long) histogram->max);
+	}
+}
+
+#else
+
+/* * *
+ * all functions, below full statistics (where nothing is timed)
+ */
+
+// there's nothing to time, so 'period' is ignored
+void latency_set_sample_period(int period) {
+	assert(period >= 0);
+}
+
+// set up 'latency' with no operations counted
+void latency_init(Latency *latency) {
+	assert(latency);
+	memset(latency, 0, sizeof *latency);
+}
+
+// nothing to free: everything lives inside 'latency' itself
+void latency_free(Latency *latency) {
+	assert(latency);
+}
+
+// nothing to count: everything lives inside 'latency' itself, which is part
+// of its table's struct
+void latency_memory_usage(Latency *latency, MemoryUsage *usage) {
+}
+
+// print how many operations of each kind there have been (if counted) to
+// stdout
+void latency_print(Latency *latency) {
+	assert(latency);
+
+#if STATS_LEVEL >= STATS_COUNTERS
+	printf("operations (not timed in a STATS=%d build):\n",
+		STATS_LEVEL);
+	int kind;
+	for (kind = 0; kind < NUM_OP_KINDS; kind++) {
+		printf("    %-14s %8llu\n", op_names[kind],
+			(unsigned long long) latency->counts[kind]);
+	}
+#else
+	printf("operation times: not recorded in a STATS=%d build\n",
+		STATS_LEVEL);
+#endif
+}
+
+#endif
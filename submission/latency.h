@@ -0,0 +1,124 @@
+/* * * * * * * * *
+ * Module for recording how long a table's operations take: a sample of them
+ * is timed, and the times are kept in histograms (one per kind of operation)
+ * with buckets that grow with the times they hold, so that percentiles far
+ * out into the tail can be read off cheaply and to within a few percent
+ *
+ * below full statistics (see stats.h) nothing is timed: with counters, only
+ * how many operations of each kind there have been is kept, and with no
+ * statistics nothing is kept at all. the calls made on every operation are
+ * then macros, so as to cost nothing even in an unoptimised build
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include "inthash.h"
+#include "memusage.h"
+#include "stats.h"
+
+// how many operations make up each sample of one timed operation, by default
+#define DEFAULT_SAMPLE_PERIOD 16
+
+// the kinds of operation whose times are recorded separately
+typedef enum op_kind {
+	OP_HIT,			// a lookup which found its key
+	OP_MISS,		// a lookup which didn't
+	OP_INSERT,		// an insertion (including any resizing it led to)
+	OP_RESIZE,		// growing the table, or a table of bucket pointers
+	NUM_OP_KINDS
+} OpKind;
+
+#if STATS_LEVEL >= STATS_FULL
+
+typedef struct histogram Histogram;
+
+// the times recorded for one table. lives inside the table's own struct
+typedef struct latency {
+	int64 nops;				// how many operations have begun (to pick samples)
+	Histogram *histograms;	// one per kind of operation, or NULL until the
+							// first time is recorded
+} Latency;
+
+// one operation being timed, which can live on the stack
+typedef struct latency_timer {
+	bool sampled;	// is this operation being timed at all?
+	int64 start;	// when it began, in nanoseconds
+} LatencyTimer;
+
+#elif STATS_LEVEL >= STATS_COUNTERS
+
+// how many operations of each kind there have been on one table
+typedef struct latency {
+	int64 counts[NUM_OP_KINDS];
+} Latency;
+
+// nothing is timed (but C has no empty structs)
+typedef struct latency_timer {
+	char unused;
+} LatencyTimer;
+
+#else
+
+// nothing is kept, or timed (but C has no empty structs)
+typedef struct latency {
+	char unused;
+} Latency;
+typedef struct latency_timer {
+	char unused;
+} LatencyTimer;
+
+#endif
+
+// time 1 in every 'period' operations from now on, in every table (or none,
+// if 'period' is 0). call before any table is in use
+void latency_set_sample_period(int period);
+
+// set up 'latency' with no times recorded
+void latency_init(Latency *latency);
+
+// free all memory associated with 'latency'
+void latency_free(Latency *latency);
+
+#if STATS_LEVEL >= STATS_FULL
+
+// start timing an operation with 'timer', if it's one of the operations on
+// the table that 'latency' belongs to that is chosen to be timed
+void latency_begin(Latency *latency, LatencyTimer *timer);
+
+// start timing an operation with 'timer', chosen or not (for rare operations
+// such as resizing, which sampling would mostly miss)
+void latency_begin_always(LatencyTimer *timer);
+
+// finish timing the operation 'timer' is timing (if it is), recording its
+// time in 'latency' as an operation of kind 'kind'
+void latency_end(Latency *latency, LatencyTimer *timer, OpKind kind);
+
+#else
+
+// (the same, but with nothing to time)
+#define latency_begin(latency, timer) ((void) (latency), (void) (timer))
+#define latency_begin_always(timer) ((void) (timer))
+#if STATS_LEVEL >= STATS_COUNTERS
+#define latency_end(latency, timer, kind) \
+	((void) (timer), (latency)->counts[kind]++)
+#else
+#define latency_end(latency, timer, kind) \
+	((void) (latency), (void) (timer), (void) (kind))
+#endif
+
+#endif
+
+// count the memory used by 'latency' towards usage->overhead
+void latency_memory_usage(Latency *latency, MemoryUsage *usage);
+
+// print how many times have been recorded of each kind of operation, along
+// with their median, 99th and 99.9th percentiles, to stdout (or just how many
+// operations there have been, below full statistics)
+void latency_print(Latency *latency);
+
+#endif
@@ -14,12 +14,31 @@
 
 #include "inthash.h"
 #include "hashtbl.h"
+#include "latency.h"
+#include "perfctr.h"
+#include "cmdinput.h"
+#include "cmdoutput.h"
+#include "cmdpipe.h"
+#include "server.h"
+#include "tables/strlinear.h"	// for byte-string keys
 
 // command line options
 #define DEFAULT_SIZE 4
 typedef struct options {
 	TableType type;
-	int initial_size;
+	size64 initial_size;
+	bool string_keys;	// use byte-string keys rather than integers?
+	int sample_period;	// time 1 in this many operations (0 for none)
+	bool profile;		// count hardware events per operation?
+	HashFamily family;	// the hash functions integer tables use
+	bool fixed_seed;	// seed every table's hash function with 'seed',
+	int64 seed;			// rather than a random seed of its own?
+	bool quiet;			// count results rather than printing each one?
+	char *bitmap_path;	// where to write a bitmap of results (or NULL)
+	bool pipelined;		// read integer commands on a thread of their own?
+	char *address;		// serve the table here, rather than interpreting
+						// commands (or NULL)
+	int nworkers;		// how many threads to serve it with
 } Options;
 Options get_options(int argc, char** argv);
 
@@ -28,57 +47,280 @@ Options get_options(int argc, char** argv);
 
 #define INSERT 'i'
 #define LOOKUP 'l'
+#define DELETE 'd'
 #define PRINT  'p'
 #define STATS  's'
 #define HELP   'h'
 #define QUIT   'q'
-#define MAX_LINE_LEN 80
-int get_command(char *operation, int64 *key);
+// how many commands to take from the parser thread at a time, when pipelined
+#define BATCH_SIZE 256
+
+
+// hardware event counts, when profiling (see perfctr.h)
+
+#define PROFILE_INSERT 0
+#define PROFILE_LOOKUP 1
+#define PROFILE_KINDS  2
+typedef struct profile {
+	PerfCounters counters;
+	PerfTally tallies[PROFILE_KINDS];	// one per kind of operation
+} Profile;
+void profile_start(Profile *profile);
+void profile_stop(Profile *profile, int kind);
+void profile_print(Profile *profile);
 
 
 // main program
 
-void run_interpreter(HashTable *table);
+bool run_command(HashTable *table, Command *command, CommandWriter *output,
+	Profile *profile);
+void run_interpreter(HashTable *table, CommandReader *input, bool pipelined,
+	CommandWriter *output, Profile *profile);
+void run_str_interpreter(StrHashTable *table, CommandReader *input,
+	CommandWriter *output, Profile *profile);
 
 int main(int argc, char **argv) {
 
 	// get command line options (to determine table type, size, etc.)
 	Options options = get_options(argc, argv);
+	latency_set_sample_period(options.sample_period);
+	hash_set_default_family(options.family);
+	if (options.fixed_seed) {
+		hash_fix_seed(options.seed);
+	}
 
-	// create hashtable (of given type)
-	HashTable *table = new_hash_table(options.type, options.initial_size);
+	// serve the table to other processes instead, if asked
+	if (options.address != NULL) {
+		if (!run_server(options.address, options.type, options.initial_size,
+				options.nworkers)) {
+			perror(options.address);
+			exit(EXIT_FAILURE);
+		}
+		return 0;
+	}
 
-	// start the interpreter loop
-	run_interpreter(table);
+	// report results to stdout (and a bitmap file, if asked) before anything
+	// else is printed, so that stdout can be given a larger buffer
+	CommandWriter *output = new_command_writer(options.quiet,
+		options.bitmap_path);
+	if (output == NULL) {
+		fprintf(stderr, "couldn't create bitmap file %s\n",
+			options.bitmap_path);
+		exit(EXIT_FAILURE);
+	}
 
-	// done!
-	free_hash_table(table);
+	// open the hardware counters, if profiling
+	Profile storage, *profile = NULL;
+	if (options.profile) {
+		profile = &storage;
+		if (!perf_counters_open(&profile->counters)) {
+			fprintf(stderr, "no hardware counters available "
+				"(is perf_event_paranoid too high?)\n");
+		}
+		int kind;
+		for (kind = 0; kind < PROFILE_KINDS; kind++) {
+			perf_tally_init(&profile->tallies[kind]);
+		}
+	}
+
+	// read commands from stdin (mapping it into memory, if it's a file)
+	CommandReader *input = new_command_reader(stdin);
+	if (input == NULL) {
+		exit(EXIT_FAILURE);
+	}
+	if (options.string_keys && command_reader_is_binary(input)) {
+		fprintf(stderr, "binary command files can't hold string keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// string keys get their own table and interpreter loop
+	if (options.string_keys) {
+		StrHashTable *table = new_str_hash_table(options.initial_size);
+		run_str_interpreter(table, input, output, profile);
+		free_str_hash_table(table);
+	} else {
+
+		// create hashtable (of given type)
+		HashTable *table = new_hash_table(options.type, options.initial_size);
+
+		// start the interpreter loop
+		run_interpreter(table, input, options.pipelined, output, profile);
+
+		// done!
+		free_hash_table(table);
+	}
+	free_command_reader(input);
+	free_command_writer(output);
+
+	if (profile != NULL) {
+		perf_counters_close(&profile->counters);
+	}
 	return 0;
 }
 
+// begin counting hardware events for an operation (if profiling)
+void profile_start(Profile *profile) {
+	if (profile != NULL) {
+		perf_counters_start(&profile->counters);
+	}
+}
+
+// finish counting hardware events for an operation of kind 'kind' (if
+// profiling)
+void profile_stop(Profile *profile, int kind) {
+	if (profile != NULL) {
+		perf_counters_stop(&profile->counters, &profile->tallies[kind], 1);
+	}
+}
+
+// print the hardware events counted per operation (if profiling)
+void profile_print(Profile *profile) {
+	static const char *names[PROFILE_KINDS] = { "insert", "lookup" };
+	if (profile != NULL) {
+		perf_tally_print(&profile->counters, profile->tallies, names,
+			PROFILE_KINDS);
+	}
+}
+
 // print out the valid operations
 void print_operations() {
 	printf(" %c number: insert 'number' into table\n",  INSERT);
 	printf(" %c number: lookup is 'number' in table\n", LOOKUP);
+	printf(" %c number: delete 'number' (not supported: no table here ever "
+		"removes keys)\n", DELETE);
 	printf(" %c: print table\n", PRINT);
 	printf(" %c: print stats\n", STATS);
 	printf(" %c: quit\n", QUIT);
 }
 
-// run the interpreter, reading and performing commands until 'quit'
-void run_interpreter(HashTable *table) {
+// carry out 'command' on 'table', reporting its result to 'output'
+// returns false if it was 'quit'
+bool run_command(HashTable *table, Command *command, CommandWriter *output,
+	Profile *profile) {
+	int argc = command->argc;
+	char op = command->operation;
+	int64 key = command->key;
+	if (argc < 1) {
+		return true; // no valid command entered, get another
+	}
+
+	// execute the command
+	switch (op) {
+		case INSERT:
+			if (argc < 2) {
+				// insert commands must have an argument
+				printf("syntax: %c number\n", INSERT);
+
+			} else {
+				// perform the insertion
+				profile_start(profile);
+				bool inserted = hash_table_insert(table, key);
+				profile_stop(profile, PROFILE_INSERT);
+				command_writer_insert(output, key, inserted);
+			}
+			break;
+
+		case LOOKUP:
+			if (argc < 2) {
+				// lookup commands must have an argument
+				printf("syntax: %c number\n", LOOKUP);
+
+			} else {
+				// perform the lookup
+				profile_start(profile);
+				bool found = hash_table_lookup(table, key);
+				profile_stop(profile, PROFILE_LOOKUP);
+				command_writer_lookup(output, key, found);
+			}
+			break;
+
+		case DELETE:
+			// keys are only ever added, so all there is to do is say so
+			printf("delete not supported\n");
+			break;
+
+		case PRINT:
+			// perform the print table
+			hash_table_print(table);
+			break;
+
+		case STATS:
+			// perform the print stats
+			hash_table_stats(table);
+			profile_print(profile);
+			command_writer_print_counts(output);
+			break;
+
+		default:
+			// display error
+			printf("unknown operation '%c'\n", op);
+			// fall through!
+		case HELP:
+			// list available options
+			printf("available operations:\n");
+			print_operations();
+			break;
+
+		case QUIT:
+			// leave the interpreter loop
+			command_writer_print_counts(output);
+			printf("exiting\n");
+			return false;
+	}
+	return true;
+}
+
+// run the interpreter, reading commands from 'input' (on a thread of their own
+// if 'pipelined') and performing them (reporting their results to 'output')
+// until 'quit' (or the end of the input)
+void run_interpreter(HashTable *table, CommandReader *input, bool pipelined,
+	CommandWriter *output, Profile *profile) {
+
+	// print a prompt at the beginning
+	printf("enter a command (h for help):\n");
+
+	// then loop, getting and executing commands, until 'quit'
+	if (!pipelined) {
+		Command command;
+		do {
+			command.argc = command_reader_next(input, &command.operation,
+				&command.key);
+		} while (run_command(table, &command, output, profile));
+		return;
+	}
+
+	// or take commands a batch at a time from the parser thread
+	CommandPipe *pipe = new_command_pipe(input);
+	Command batch[BATCH_SIZE];
+	bool running = true;
+	while (running) {
+		int n = command_pipe_next_batch(pipe, batch, BATCH_SIZE);
+		int i;
+		for (i = 0; i < n && running; i++) {
+			running = run_command(table, &batch[i], output, profile);
+		}
+	}
+	free_command_pipe(pipe);
+}
+
+// run the interpreter on byte-string keys, reading commands from 'input' and
+// performing them (reporting their results to 'output') until 'quit' (or the
+// end of the input)
+void run_str_interpreter(StrHashTable *table, CommandReader *input,
+	CommandWriter *output, Profile *profile) {
 
 	// print a prompt at the beginning
 	printf("enter a command (h for help):\n");
 
 	char op;
-	int64 key;
+	char key[MAX_LINE_LEN];
+	int len;
 
 	// then loop, getting and executing commands, until 'quit'
 	while (true) {
 
-		// read a command, storing results in op and key variables
-		int argc = get_command(&op, &key);
+		// read a command, storing results in op, key and len variables
+		int argc = command_reader_next_str(input, &op, key, &len);
 		if (argc < 1) {
 			continue; // no valid command entered, get another
 		}
@@ -88,41 +330,46 @@ void run_interpreter(HashTable *table) {
 			case INSERT:
 				if (argc < 2) {
 					// insert commands must have an argument
-					printf("syntax: %c number\n", INSERT);
+					printf("syntax: %c string\n", INSERT);
 
 				} else {
 					// perform the insertion
-					if (hash_table_insert(table, key)) {
-						printf("%llu inserted\n", key);
-					} else {
-						printf("%llu already in table\n", key);
-					}
+					profile_start(profile);
+					bool inserted = str_hash_table_insert(table, key, len);
+					profile_stop(profile, PROFILE_INSERT);
+					command_writer_str_insert(output, key, inserted);
 				}
 				break;
 
 			case LOOKUP:
 				if (argc < 2) {
 					// lookup commands must have an argument
-					printf("syntax: %c number\n", LOOKUP);
+					printf("syntax: %c string\n", LOOKUP);
 
 				} else {
 					// perform the lookup
-					if (hash_table_lookup(table, key)) {
-						printf("%llu found\n", key);
-					} else {
-						printf("%llu not found\n", key);
-					}
+					profile_start(profile);
+					bool found = str_hash_table_lookup(table, key, len);
+					profile_stop(profile, PROFILE_LOOKUP);
+					command_writer_str_lookup(output, key, found);
 				}
 				break;
 
+			case DELETE:
+				// keys are only ever added, so all there is to do is say so
+				printf("delete not supported\n");
+				break;
+
 			case PRINT:
 				// perform the print table
-				hash_table_print(table);
+				str_hash_table_print(table);
 				break;
 
 			case STATS:
 				// perform the print stats
-				hash_table_stats(table);
+				str_hash_table_stats(table);
+				profile_print(profile);
+				command_writer_print_counts(output);
 				break;
 
 			default:
@@ -137,52 +384,64 @@ void run_interpreter(HashTable *table) {
 
 			case QUIT:
 				// leave the interpreter loop
+				command_writer_print_counts(output);
 				printf("exiting\n");
 				return;
 		}
 	}
 }
 
-// reads a line from stdin, parses it into an operation character and possibly
-// a long long uinteger argument. store results in *operation and *key, resp.
-//
-// returns the number of tokens successfully read (e.g. 0 for none,
-// 1 for operation only, 2 for both operation and integer)
-int get_command(char *operation, int64 *key) {
-
-	// read a line from stdin, up to MAX_LINE_LENGTH, into character buffer
-	char line[MAX_LINE_LEN];
-	fgets(line, MAX_LINE_LEN, stdin);
-	line[strlen(line)-1] = '\0'; // strip trailing newline
-
-	// attempt to parse the line string into *operation and *key
-	int argc = sscanf(line, "%c %llu", operation, key);
-	// note: since llu is unsigned, a command like 'i -1' will overflow,
-	// resulting in *key = 18446744073709551615 (2^64-1). this is a feature.
-
-	// return the number of variables successfully read, as required
-	return argc;
-}
-
-
-
-
 // scans command line arguments for program options,
 // prints usage info and exits if commands are missing or otherwise invalid
 Options get_options(int argc, char** argv) {
 
 	// create the Options structure with defaults
-	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE };
+	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE,
+		.string_keys = false, .sample_period = DEFAULT_SAMPLE_PERIOD,
+		.profile = false, .family = HASH_MODPRIME, .fixed_seed = false,
+		.quiet = false, .bitmap_path = NULL, .pipelined = false,
+		.address = NULL, .nworkers = 1 };
 
 	// use C's built-in getopt function to scan inputs by flag
 	char option;
-	while ((option = getopt(argc, argv, "t:s:")) != EOF){
+	while ((option = getopt(argc, argv, "t:s:k:l:pf:S:qB:PL:w:")) != EOF){
 		switch (option){
 			case 't': // set hash table type
 				options.type = strtotype(optarg);
 				break;
 			case 's': // set hash table size
-				options.initial_size = atoi(optarg);
+				options.initial_size = strtoll(optarg, NULL, 10);
+				break;
+			case 'k': // set key type
+				options.string_keys = (strcmp("string", optarg) == 0);
+				break;
+			case 'l': // set how often to time operations
+				options.sample_period = atoi(optarg);
+				break;
+			case 'p': // count hardware events per operation
+				options.profile = true;
+				break;
+			case 'f': // set hash function family
+				options.family = strtofamily(optarg);
+				break;
+			case 'S': // fix the hash function seed, for repeatable runs
+				options.fixed_seed = true;
+				options.seed = strtoull(optarg, NULL, 0);
+				break;
+			case 'q': // count results rather than printing each one
+				options.quiet = true;
+				break;
+			case 'B': // write a bitmap of results
+				options.bitmap_path = optarg;
+				break;
+			case 'P': // read commands on a thread of their own
+				options.pipelined = true;
+				break;
+			case 'L': // serve the table on a socket
+				options.address = optarg;
+				break;
+			case 'w': // set how many threads serve it
+				options.nworkers = atoi(optarg);
 				break;
 			default:
 				break;
@@ -192,8 +451,8 @@ Options get_options(int argc, char** argv) {
 	// validation and printing error / usage messages
 	bool valid = true;
 
-	// check part validity
-	if(options.type == NOTYPE){
+	// check part validity (string keys always use their own table)
+	if(options.type == NOTYPE && !options.string_keys){
 		fprintf(stderr,
 			"please specify which table type to use, using the -t flag:\n");
 		fprintf(stderr, " -t linear:  linear hash table\n");
@@ -204,6 +463,10 @@ Options get_options(int argc, char** argv) {
 		fprintf(stderr, " -t 3 or xuckoo:  extendible cuckoo table (part 3)\n");
 		fprintf(stderr,
 			" -t xuckoon: multi-key extendible cuckoo table (bonus)\n");
+		fprintf(stderr,
+			" -t auto:    adaptive table, changing type to suit workload\n");
+		fprintf(stderr,
+			"or use byte-string keys instead, using -k string\n");
 		valid = false;
 	}
 
@@ -214,6 +477,39 @@ Options get_options(int argc, char** argv) {
 		valid = false;
 	}
 
+	// validate hash function family
+	if(options.family == NOFAMILY) {
+		fprintf(stderr, "please specify a hash function family using the -f "
+			"flag: modprime, multshift, tabulation or mixer\n");
+		valid = false;
+	}
+
+	// validate pipelining (byte-string commands are always read in turn)
+	if(options.pipelined && options.string_keys) {
+		fprintf(stderr, "-P (reading commands on a separate thread) only "
+			"works with integer keys\n");
+		valid = false;
+	}
+
+	// validate serving (which takes only integer keys)
+	if(options.address != NULL && options.string_keys) {
+		fprintf(stderr, "-L (serving the table on a socket) only works with "
+			"integer keys\n");
+		valid = false;
+	}
+	if(options.nworkers < 1 || options.nworkers > MAX_WORKERS) {
+		fprintf(stderr, "please specify between 1 and %d worker threads "
+			"using the -w flag\n", MAX_WORKERS);
+		valid = false;
+	}
+
+	// validate sampling period
+	if(options.sample_period < 0) {
+		fprintf(stderr, "please specify how often to time operations (1 in "
+			"every n, or 0 for never) using the -l flag\n");
+		valid = false;
+	}
+
 	// check overall validity before continuing
 	if(!valid){
 		exit(EXIT_FAILURE);
@@ -0,0 +1,68 @@
+/* * * * * * * * *
+ * Module for measuring exactly how much memory a table is using, broken down
+ * by what that memory is used for, including the allocator's own overhead on
+ * every block
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#ifdef __GLIBC__
+#include <malloc.h>  // for malloc_usable_size
+#endif
+
+#include "memusage.h"
+
+// how many bytes the allocator really set aside for the block at 'block',
+// which was allocated with room for 'bytes' bytes
+static size_t allocated_size(const void *block, size_t bytes) {
+#ifdef __GLIBC__
+	// glibc keeps one size word in front of each block, and rounds the rest
+	// up; the usable size tells us by how much
+	(void) bytes;
+	return malloc_usable_size((void *) block) + sizeof (size_t);
+#else
+	// otherwise, assume a size word in front and 16 byte alignment
+	(void) block;
+	return (bytes + sizeof (size_t) + 15) / 16 * 16;
+#endif
+}
+
+// count the block at 'block' holding 'bytes' bytes towards *field of 'usage',
+// and whatever else the allocator spent on it towards usage->overhead
+void memory_count(MemoryUsage *usage, size_t *field, const void *block,
+	size_t bytes, Snapshot *snapshot) {
+	assert(usage);
+	assert(field);
+
+	*field += bytes;
+	if (block != NULL && !snapshot_owns(snapshot, block)) {
+		usage->overhead += allocated_size(block, bytes) - bytes;
+	}
+}
+
+// count the tables 'hasher' has allocated (if any) towards usage->overhead
+void memory_count_hasher(MemoryUsage *usage, Hasher *hasher) {
+	memory_count(usage, &usage->overhead, hasher->tables,
+		hasher_table_bytes(hasher), NULL);
+}
+
+// add every count in 'more' to 'usage'
+void memory_add(MemoryUsage *usage, MemoryUsage more) {
+	assert(usage);
+
+	usage->slots += more.slots;
+	usage->inuse += more.inuse;
+	usage->directory += more.directory;
+	usage->headers += more.headers;
+	usage->entries += more.entries;
+	usage->overhead += more.overhead;
+}
+
+// the total number of bytes counted in 'usage'
+size_t memory_total(MemoryUsage usage) {
+	return usage.slots + usage.inuse + usage.directory + usage.headers
+		+ usage.entries + usage.overhead;
+}
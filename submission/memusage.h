@@ -0,0 +1,45 @@
+/* * * * * * * * *
+ * Module for measuring exactly how much memory a table is using, broken down
+ * by what that memory is used for, including the allocator's own overhead on
+ * every block
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef MEMUSAGE_H
+#define MEMUSAGE_H
+
+#include <stddef.h>
+#include "snapshot.h"
+
+// a breakdown of the memory used by a table, in bytes. blocks which live
+// inside a snapshot are counted too (as mapped file pages, with no allocator
+// overhead)
+typedef struct memory_usage {
+	size_t slots;		// arrays of slots holding keys and their values
+	size_t inuse;		// arrays of flags marking which slots are in use
+	size_t directory;	// tables of pointers to buckets
+	size_t headers;		// buckets, apart from the keys and values inside them
+	size_t entries;		// keys and values stored in buckets
+	size_t overhead;	// table structs, and the allocator's bookkeeping and
+						// rounding around every block
+} MemoryUsage;
+
+// count the block at 'block' holding 'bytes' bytes towards *field of 'usage',
+// and whatever else the allocator spent on it towards usage->overhead. blocks
+// inside 'snapshot' (which may be NULL) were never allocated, so they cost
+// nothing extra
+void memory_count(MemoryUsage *usage, size_t *field, const void *block,
+	size_t bytes, Snapshot *snapshot);
+
+// count the tables 'hasher' has allocated (if any) towards usage->overhead
+void memory_count_hasher(MemoryUsage *usage, Hasher *hasher);
+
+// add every count in 'more' to 'usage'
+void memory_add(MemoryUsage *usage, MemoryUsage more);
+
+// the total number of bytes counted in 'usage'
+size_t memory_total(MemoryUsage usage);
+
+#endif
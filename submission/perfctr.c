@@ -0,0 +1,251 @@
+/* * * * * * * * *
+ * Module for counting hardware events (cache misses, TLB misses, branch
+ * misses, ...) during batches of hash table operations, using linux's
+ * perf_event_open, so that the cost of each table layout can be seen per
+ * operation rather than just in time
+ *
+ * each event gets a counter of its own rather than joining a group: a group
+ * only counts while the cpu has room for all of its events at once, which
+ * (with a watchdog holding a counter, say) may be never. lone counters are
+ * instead shared out by the kernel, and their counts scaled up to match
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _GNU_SOURCE  // for syscall
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfctr.h"
+
+// the names of each event, for printing
+static const char *counter_names[NUM_COUNTERS] = {
+	"cycles", "instrs", "L1d-miss", "LLC-miss", "dTLB-miss", "br-miss",
+	"faults"
+};
+
+
+/* * *
+ * helper functions
+ */
+
+#ifdef __linux__
+
+// the perf_event_attr type and config fields selecting events of kind 'kind'
+static void event_of(CounterKind kind, unsigned *type,
+	unsigned long long *config) {
+	// cache events are named by which cache, which operation, and which result
+	const unsigned long long read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8)
+		| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+	switch (kind) {
+		case CTR_CYCLES:
+			*type = PERF_TYPE_HARDWARE;
+			*config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case CTR_INSTRUCTIONS:
+			*type = PERF_TYPE_HARDWARE;
+			*config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case CTR_L1D_MISSES:
+			*type = PERF_TYPE_HW_CACHE;
+			*config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+			break;
+		case CTR_LLC_MISSES:
+			*type = PERF_TYPE_HARDWARE;
+			*config = PERF_COUNT_HW_CACHE_MISSES;
+			break;
+		case CTR_DTLB_MISSES:
+			*type = PERF_TYPE_HW_CACHE;
+			*config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+			break;
+		case CTR_BRANCH_MISSES:
+			*type = PERF_TYPE_HARDWARE;
+			*config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+		default:
+			*type = PERF_TYPE_SOFTWARE;
+			*config = PERF_COUNT_SW_PAGE_FAULTS;
+			break;
+	}
+}
+
+// open a counter for events of kind 'kind' in this thread, in user mode only
+// returns its file descriptor, or -1 if the kernel or hardware won't allow it
+static int open_counter(CounterKind kind) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof attr);
+	attr.size = sizeof attr;
+	event_of(kind, &attr.type, &attr.config);
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+		| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// this thread (0), on any cpu (-1), in no group (-1)
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#else
+
+// perf_event_open is linux's own, so elsewhere nothing can be counted
+static int open_counter(CounterKind kind) {
+	return -1;
+}
+
+#endif
+
+// read the counter 'fd' into *reading
+static void read_counter(int fd, PerfReading *reading) {
+	unsigned long long values[3];
+	ssize_t size = read(fd, values, sizeof values);
+	assert(size == sizeof values);
+	reading->value = values[0];
+	reading->enabled = values[1];
+	reading->running = values[2];
+}
+
+
+/* * *
+ * all functions
+ */
+
+// open every counter this machine allows, counting events in this thread
+// (in user mode only) from now on
+// returns false if none could be opened
+bool perf_counters_open(PerfCounters *counters) {
+	assert(counters);
+	counters->nopen = 0;
+
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		counters->fds[kind] = open_counter(kind);
+		if (counters->fds[kind] >= 0) {
+			counters->nopen++;
+		}
+	}
+
+	return counters->nopen > 0;
+}
+
+// close every counter in 'counters'
+void perf_counters_close(PerfCounters *counters) {
+	assert(counters);
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		if (counters->fds[kind] >= 0) {
+			close(counters->fds[kind]);
+			counters->fds[kind] = -1;
+		}
+	}
+	counters->nopen = 0;
+}
+
+// is the counter for 'kind' open in 'counters'?
+bool perf_counter_available(PerfCounters *counters, CounterKind kind) {
+	return counters->fds[kind] >= 0;
+}
+
+// a short name for events of kind 'kind', for table headings
+const char *perf_counter_name(CounterKind kind) {
+	return counter_names[kind];
+}
+
+// begin a batch of operations
+void perf_counters_start(PerfCounters *counters) {
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		if (counters->fds[kind] >= 0) {
+			read_counter(counters->fds[kind], &counters->start[kind]);
+		}
+	}
+}
+
+// end the batch of operations begun by the last perf_counters_start, adding
+// the events it caused, and its 'nops' operations, to 'tally'
+void perf_counters_stop(PerfCounters *counters, PerfTally *tally, int64 nops) {
+	// read every counter before working anything out, so as to count as
+	// little of this function as possible
+	PerfReading end[NUM_COUNTERS];
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		if (counters->fds[kind] >= 0) {
+			read_counter(counters->fds[kind], &end[kind]);
+		}
+	}
+
+	tally->nops += nops;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		if (counters->fds[kind] < 0) {
+			continue;
+		}
+		PerfReading *start = &counters->start[kind];
+		int64 enabled = end[kind].enabled - start->enabled;
+		int64 running = end[kind].running - start->running;
+
+		// a counter which never got a turn on the cpu during this batch
+		// knows nothing about it, so the batch doesn't count towards it
+		if (running <= 0) {
+			continue;
+		}
+		double events = end[kind].value - start->value;
+		tally->totals[kind] += events * enabled / running;
+		tally->counted[kind] += nops;
+	}
+}
+
+// set up 'tally' with no operations counted
+void perf_tally_init(PerfTally *tally) {
+	memset(tally, 0, sizeof *tally);
+}
+
+// the average number of events of kind 'kind' per operation in 'tally'
+double perf_tally_per_op(PerfTally *tally, CounterKind kind) {
+	if (tally->counted[kind] == 0) {
+		return 0;
+	}
+	return tally->totals[kind] / tally->counted[kind];
+}
+
+// print the average events per operation in each of the 'n' tallies in
+// 'tallies', labelled by 'names', to stdout (showing "-" for counters that
+// aren't available)
+void perf_tally_print(PerfCounters *counters, PerfTally *tallies,
+	const char **names, int n) {
+	if (counters->nopen == 0) {
+		printf("hardware counters: none available\n");
+		return;
+	}
+
+	printf("hardware counters (events per operation):\n");
+	printf("    %-9s %10s", "operation", "counted");
+	int kind;
+	for (kind = 0; kind < NUM_COUNTERS; kind++) {
+		printf(" %9s", counter_names[kind]);
+	}
+	printf("\n");
+
+	int i;
+	for (i = 0; i < n; i++) {
+		printf("    %-9s %10llu", names[i],
+			(unsigned long long) tallies[i].nops);
+		for (kind = 0; kind < NUM_COUNTERS; kind++) {
+			if (!perf_counter_available(counters, kind)) {
+				printf(" %9s", "-");
+			} else {
+				printf(" %9.2f", perf_tally_per_op(&tallies[i], kind));
+			}
+		}
+		printf("\n");
+	}
+}
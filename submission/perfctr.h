@@ -0,0 +1,86 @@
+/* * * * * * * * *
+ * Module for counting hardware events (cache misses, TLB misses, branch
+ * misses, ...) during batches of hash table operations, using linux's
+ * perf_event_open, so that the cost of each table layout can be seen per
+ * operation rather than just in time
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdbool.h>
+#include "inthash.h"
+
+// the events counted, where the kernel and hardware allow it
+typedef enum counter_kind {
+	CTR_CYCLES,			// cpu cycles
+	CTR_INSTRUCTIONS,	// instructions retired
+	CTR_L1D_MISSES,		// level 1 data cache read misses
+	CTR_LLC_MISSES,		// last level cache misses
+	CTR_DTLB_MISSES,	// data TLB read misses
+	CTR_BRANCH_MISSES,	// mispredicted branches
+	CTR_PAGE_FAULTS,	// page faults (counted by the kernel, not the cpu)
+	NUM_COUNTERS
+} CounterKind;
+
+// one reading of a counter
+typedef struct perf_reading {
+	int64 value;	// how many events so far
+	int64 enabled;	// how long the counter has been enabled, in nanoseconds
+	int64 running;	// and how much of that it was actually counting (less, if
+					// the cpu had to share its counters between events)
+} PerfReading;
+
+// a set of open counters, all started and read together
+typedef struct perf_counters {
+	int fds[NUM_COUNTERS];				// each counter, or -1 if it couldn't
+										// be opened
+	int nopen;							// how many could be
+	PerfReading start[NUM_COUNTERS];	// readings when the current batch began
+} PerfCounters;
+
+// the counts from some number of batches of one kind of operation
+typedef struct perf_tally {
+	int64 nops;						// how many operations were counted
+	int64 counted[NUM_COUNTERS];	// how many of them each counter saw
+	double totals[NUM_COUNTERS];	// and how many events each counter saw
+} PerfTally;
+
+// open every counter this machine allows, counting events in this thread
+// (in user mode only) from now on
+// returns false if none could be opened, in which case 'counters' can still
+// be used, but counts nothing
+bool perf_counters_open(PerfCounters *counters);
+
+// close every counter in 'counters'
+void perf_counters_close(PerfCounters *counters);
+
+// is the counter for 'kind' open in 'counters'?
+bool perf_counter_available(PerfCounters *counters, CounterKind kind);
+
+// a short name for events of kind 'kind', for table headings
+const char *perf_counter_name(CounterKind kind);
+
+// begin a batch of operations
+void perf_counters_start(PerfCounters *counters);
+
+// end the batch of operations begun by the last perf_counters_start, adding
+// the events it caused, and its 'nops' operations, to 'tally'
+void perf_counters_stop(PerfCounters *counters, PerfTally *tally, int64 nops);
+
+// set up 'tally' with no operations counted
+void perf_tally_init(PerfTally *tally);
+
+// the average number of events of kind 'kind' per operation in 'tally'
+double perf_tally_per_op(PerfTally *tally, CounterKind kind);
+
+// print the average events per operation in each of the 'n' tallies in
+// 'tallies', labelled by 'names', to stdout (showing "-" for counters that
+// aren't available)
+void perf_tally_print(PerfCounters *counters, PerfTally *tallies,
+	const char **names, int n);
+
+#endif
@@ -0,0 +1,416 @@
+/* * * * * * * * *
+ * Module for serving a hash table to other processes on the same machine,
+ * over a Unix domain socket or a localhost TCP port (a2 -L), so that the
+ * tables can be measured the way a service embedding them would use them
+ *
+ * every worker waits on the listening socket in its own epoll set (as an
+ * exclusive waiter, so that each new connection wakes just one of them), and
+ * keeps the connections it accepts. a connection is only ever read while all
+ * replies to it have been written: a client which stops reading its replies
+ * is simply not read from, rather than buffered for without limit
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _GNU_SOURCE  // for accept4, EPOLLEXCLUSIVE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>  // for memcpy, memmove, strlen, strspn
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "server.h"
+#include "shardtbl.h"
+
+// how many bytes of requests are read from a connection at a time (so this
+// many, over REQUEST_SIZE, are answered in each batch at most)
+#define READ_SIZE (64 * 1024)
+// the most requests (and so replies) in one batch
+#define MAX_BATCH (READ_SIZE / REQUEST_SIZE)
+// how many events each worker takes from epoll at a time
+#define MAX_EVENTS 64
+// how long a worker waits for events before checking whether it's time to
+// stop, in milliseconds
+#define WAIT_MS 100
+// how many connections may wait to be accepted
+#define BACKLOG 128
+
+// a client's connection to the server
+typedef struct connection Connection;
+struct connection {
+	int fd;
+	Connection *prev, *next;	// the worker's other connections
+	char in[READ_SIZE];		// requests received but not yet handled (the
+	int nin;				// first 'nin' bytes: at most a partial request)
+	char out[MAX_BATCH];	// replies not yet written (the 'nout' bytes from
+	int nout, out_start;	// 'out_start')
+};
+
+// the table being served: one of these is NULL
+typedef struct store {
+	HashTable *table;			// a table for a single worker
+	ShardedHashTable *sharded;	// a table shared between workers
+} Store;
+
+// everything the workers share
+typedef struct server {
+	int listener;			// the listening socket
+	Store store;			// the table being served
+} Server;
+
+// a worker thread's own state
+typedef struct worker {
+	Server *server;			// the server it works for
+	int epfd;				// its epoll set
+	Connection *conns;		// the connections it has accepted
+} Worker;
+
+// set (by a signal, or by any worker) once the server should stop
+static volatile sig_atomic_t stopping = 0;
+#define STOP() __atomic_store_n(&stopping, 1, __ATOMIC_RELAXED)
+#define STOPPING() __atomic_load_n(&stopping, __ATOMIC_RELAXED)
+
+
+/* * * *
+ * helper functions
+ */
+
+// insert 'key' into the table in 'store'
+static bool store_insert(Store *store, int64 key) {
+	if (store->sharded != NULL) {
+		return sharded_hash_table_insert(store->sharded, key);
+	}
+	return hash_table_insert(store->table, key);
+}
+
+// look up 'key' in the table in 'store'
+static bool store_lookup(Store *store, int64 key) {
+	if (store->sharded != NULL) {
+		return sharded_hash_table_lookup(store->sharded, key);
+	}
+	return hash_table_lookup(store->table, key);
+}
+
+// is 'address' a port number (rather than a socket's path)?
+static bool is_port(const char *address) {
+	return address[0] != '\0'
+		&& strspn(address, "0123456789") == strlen(address);
+}
+
+// stop the server when interrupted
+static void handle_signal(int signal) {
+	STOP();
+}
+
+// handle every complete request received on 'conn', adding a reply to its
+// outgoing replies for each
+static void handle_requests(Store *store, Connection *conn) {
+	int start = 0;
+	while (conn->nin - start >= REQUEST_SIZE) {
+		char operation = conn->in[start];
+		int64 key;
+		memcpy(&key, conn->in + start + 1, sizeof key);
+		start += REQUEST_SIZE;
+
+		char reply;
+		switch (operation) {
+			case REQUEST_INSERT:
+				reply = store_insert(store, key) ? REPLY_YES : REPLY_NO;
+				break;
+			case REQUEST_LOOKUP:
+				reply = store_lookup(store, key) ? REPLY_YES : REPLY_NO;
+				break;
+			case REQUEST_DELETE:
+				reply = REPLY_UNSUPPORTED;
+				break;
+			case REQUEST_STOP:
+				STOP();
+				reply = REPLY_YES;
+				break;
+			default:
+				reply = REPLY_BAD;
+				break;
+		}
+		conn->out[conn->nout++] = reply;
+	}
+
+	// keep any partial request for when the rest of it arrives
+	conn->nin -= start;
+	memmove(conn->in, conn->in + start, conn->nin);
+}
+
+// write as many of the replies waiting on 'conn' as the socket will take
+// returns false if the connection has failed
+static bool write_replies(Connection *conn) {
+	while (conn->nout > 0) {
+		ssize_t n = send(conn->fd, conn->out + conn->out_start, conn->nout,
+			MSG_NOSIGNAL);
+		if (n < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		conn->out_start += n;
+		conn->nout -= n;
+	}
+	conn->out_start = 0;
+	return true;
+}
+
+// watch 'conn' in the epoll set 'epfd' for the socket being writable, if it
+// has replies waiting, or else readable ('op' being EPOLL_CTL_ADD the first
+// time, and EPOLL_CTL_MOD after that)
+static void watch(int epfd, Connection *conn, int op) {
+	struct epoll_event event;
+	event.events = (conn->nout > 0) ? EPOLLOUT : EPOLLIN;
+	event.data.ptr = conn;
+	int error = epoll_ctl(epfd, op, conn->fd, &event);
+	assert(error == 0);
+}
+
+// close 'conn', one of the connections of 'worker', and free it
+static void close_connection(Worker *worker, Connection *conn) {
+	if (conn->prev != NULL) {
+		conn->prev->next = conn->next;
+	} else {
+		worker->conns = conn->next;
+	}
+	if (conn->next != NULL) {
+		conn->next->prev = conn->prev;
+	}
+	close(conn->fd);  // (which also takes it out of the epoll set)
+	free(conn);
+}
+
+// accept every connection waiting on the listening socket, for 'worker'
+static void accept_connections(Worker *worker) {
+	int fd;
+	while ((fd = accept4(worker->server->listener, NULL, NULL,
+			SOCK_NONBLOCK)) >= 0) {
+		// replies go out as soon as a batch is answered (this fails harmlessly
+		// on a Unix domain socket, which never delays them)
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+
+		Connection *conn = malloc(sizeof *conn);
+		assert(conn);
+		conn->fd = fd;
+		conn->nin = conn->nout = conn->out_start = 0;
+		conn->prev = NULL;
+		conn->next = worker->conns;
+		if (worker->conns != NULL) {
+			worker->conns->prev = conn;
+		}
+		worker->conns = conn;
+		watch(worker->epfd, conn, EPOLL_CTL_ADD);
+	}
+}
+
+// respond to an event on 'conn', one of the connections of 'worker'
+static void serve(Worker *worker, Connection *conn) {
+	if (conn->nout == 0) {
+		ssize_t n = recv(conn->fd, conn->in + conn->nin,
+			READ_SIZE - conn->nin, 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			close_connection(worker, conn);
+			return;
+		}
+		if (n > 0) {
+			conn->nin += n;
+			handle_requests(&worker->server->store, conn);
+		}
+	}
+
+	if (!write_replies(conn)) {
+		close_connection(worker, conn);
+		return;
+	}
+	watch(worker->epfd, conn, EPOLL_CTL_MOD);
+}
+
+// a worker thread: serve connections until the server stops
+static void *work(void *arg) {
+	Worker *worker = arg;
+	worker->epfd = epoll_create1(0);
+	assert(worker->epfd >= 0);
+	worker->conns = NULL;
+
+	// the listening socket is the only event with no connection
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLEXCLUSIVE;
+	event.data.ptr = NULL;
+	int error = epoll_ctl(worker->epfd, EPOLL_CTL_ADD,
+		worker->server->listener, &event);
+	assert(error == 0);
+
+	struct epoll_event events[MAX_EVENTS];
+	while (!STOPPING()) {
+		int n = epoll_wait(worker->epfd, events, MAX_EVENTS, WAIT_MS);
+		int i;
+		for (i = 0; i < n; i++) {
+			Connection *conn = events[i].data.ptr;
+			if (conn == NULL) {
+				accept_connections(worker);
+			} else {
+				serve(worker, conn);
+			}
+		}
+	}
+
+	while (worker->conns != NULL) {
+		close_connection(worker, worker->conns);
+	}
+	close(worker->epfd);
+	return NULL;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// open a socket for 'address' (a port number for localhost TCP, or else the
+// path of a Unix domain socket), listening on it if 'listening', or else
+// connecting to it
+// returns the socket's file descriptor, or -1 on failure (with errno set)
+int server_open_socket(const char *address, bool listening) {
+	assert(address);
+
+	struct sockaddr_in inet;
+	struct sockaddr_un local;
+	struct sockaddr *name;
+	socklen_t length;
+	int domain;
+
+	if (is_port(address)) {
+		memset(&inet, 0, sizeof inet);
+		inet.sin_family = AF_INET;
+		inet.sin_port = htons(atoi(address));
+		inet.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		domain = AF_INET;
+		name = (struct sockaddr *) &inet;
+		length = sizeof inet;
+	} else {
+		if (strlen(address) >= sizeof local.sun_path) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		memset(&local, 0, sizeof local);
+		local.sun_family = AF_UNIX;
+		strcpy(local.sun_path, address);
+		domain = AF_UNIX;
+		name = (struct sockaddr *) &local;
+		length = sizeof local;
+	}
+
+	// a listening socket never blocks, so that workers woken for a connection
+	// another worker has already taken don't wait for the next
+	int fd = socket(domain, SOCK_STREAM | (listening ? SOCK_NONBLOCK : 0), 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	int failed;
+	if (listening) {
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+		// replace a socket left behind by an earlier server (but nothing else)
+		struct stat info;
+		if (domain == AF_UNIX && stat(address, &info) == 0
+			&& S_ISSOCK(info.st_mode)) {
+			unlink(address);
+		}
+		failed = bind(fd, name, length) != 0 || listen(fd, BACKLOG) != 0;
+	} else {
+		failed = connect(fd, name, length) != 0;
+		if (!failed && domain == AF_INET) {
+			int on = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+		}
+	}
+
+	if (failed) {
+		int error = errno;
+		close(fd);
+		errno = error;
+		return -1;
+	}
+	return fd;
+}
+
+// serve a table of type 'type' (created with initial size 'size', as in
+// new_hash_table()) on 'address' with 'nworkers' worker threads, until a
+// client sends REQUEST_STOP or the process is interrupted. then print the
+// table's statistics to stdout
+// returns false if 'address' couldn't be listened on
+bool run_server(const char *address, TableType type, size64 size,
+	int nworkers) {
+	assert(nworkers > 0 && nworkers <= MAX_WORKERS);
+
+	Server server;
+	server.listener = server_open_socket(address, true);
+	if (server.listener < 0) {
+		return false;
+	}
+
+	// one worker has the table to itself; more share one sharded table, each
+	// worker locking whichever shard a request's key falls in (with as many
+	// shards as workers, so that they seldom want the same lock at once)
+	server.store.table = NULL;
+	server.store.sharded = NULL;
+	if (nworkers == 1) {
+		server.store.table = new_hash_table(type, size);
+	} else {
+		int nshards = 1;
+		while (nshards < nworkers) {
+			nshards *= 2;
+		}
+		server.store.sharded = new_sharded_hash_table(type, size, nshards);
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof action);
+	action.sa_handler = handle_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	printf("serving on %s with %d worker%s\n", address, nworkers,
+		(nworkers == 1) ? "" : "s sharing a locked, sharded table");
+	fflush(stdout);
+
+	pthread_t threads[MAX_WORKERS];
+	Worker workers[MAX_WORKERS];
+	int t;
+	for (t = 0; t < nworkers; t++) {
+		workers[t].server = &server;
+		int error = pthread_create(&threads[t], NULL, work, &workers[t]);
+		assert(error == 0);
+	}
+	for (t = 0; t < nworkers; t++) {
+		pthread_join(threads[t], NULL);
+	}
+
+	close(server.listener);
+	if (!is_port(address)) {
+		unlink(address);
+	}
+
+	if (server.store.sharded != NULL) {
+		sharded_hash_table_stats(server.store.sharded);
+		free_sharded_hash_table(server.store.sharded);
+	} else {
+		hash_table_stats(server.store.table);
+		free_hash_table(server.store.table);
+	}
+	return true;
+}
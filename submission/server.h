@@ -0,0 +1,65 @@
+/* * * * * * * * *
+ * Module for serving a hash table to other processes on the same machine,
+ * over a Unix domain socket or a localhost TCP port (a2 -L), so that the
+ * tables can be measured the way a service embedding them would use them
+ *
+ * requests are binary, in the same 9-byte form as binary command files (see
+ * cmdinput.h): an operation character, then a key in native byte order. a
+ * client may send any number of requests before reading any replies
+ * (pipelining), and gets one reply byte per request, in order. the server
+ * handles every complete request it has received at once, and answers them
+ * all in one write
+ *
+ * each of a number of worker threads runs an epoll event loop over the
+ * connections it has accepted. with one worker, the table is an ordinary one.
+ * with more, every worker shares a single locked table: a sharded table (see
+ * shardtbl.h), whose every shard has a lock of its own. any worker handles
+ * any key, taking the lock of whichever shard the key falls in; shards don't
+ * belong to workers, and there are as many as workers (rounded up to a power
+ * of two) only so that workers seldom wait for the same lock
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include "inthash.h"
+#include "hashtbl.h"
+
+// the size of a request in bytes: an operation character and a key
+#define REQUEST_SIZE (1 + sizeof (int64))
+
+// request operations
+#define REQUEST_INSERT 'i'	// insert the key
+#define REQUEST_LOOKUP 'l'	// look the key up
+#define REQUEST_DELETE 'd'	// delete the key (see REPLY_UNSUPPORTED)
+#define REQUEST_STOP   'q'	// stop the server (the key is ignored)
+
+// replies, one byte for each request
+#define REPLY_NO 0			// the key was already there, or wasn't found
+#define REPLY_YES 1			// the key was inserted, or found
+#define REPLY_UNSUPPORTED 2	// no table here can delete keys (keys are only
+							// ever added), so deleting always gets this
+#define REPLY_BAD 3			// not a request operation
+
+// the most worker threads a server can have
+#define MAX_WORKERS 64
+
+// open a socket for 'address' (a port number for localhost TCP, or else the
+// path of a Unix domain socket), listening on it if 'listening', or else
+// connecting to it
+// returns the socket's file descriptor, or -1 on failure (with errno set)
+int server_open_socket(const char *address, bool listening);
+
+// serve a table of type 'type' (created with initial size 'size', as in
+// new_hash_table()) on 'address' with 'nworkers' worker threads, until a
+// client sends REQUEST_STOP or the process is interrupted. then print the
+// table's statistics to stdout
+// returns false if 'address' couldn't be listened on
+bool run_server(const char *address, TableType type, size64 size,
+	int nworkers);
+
+#endif
@@ -0,0 +1,309 @@
+/* * * * * * * * *
+ * Thread-safe hash table made of a number of independent hash tables (shards)
+ * of any type, each guarded by its own lock. every key belongs to the shard
+ * picked out by a hash function of the table's own (seeded independently of
+ * the shards' tables), so threads working on keys in different shards never
+ * wait for each other
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for pthread_rwlock_t, posix_memalign
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "shardtbl.h"
+
+// size of a cache line in bytes. every shard gets one to itself (at least),
+// so that threads taking the locks of neighbouring shards don't keep stealing
+// the same line from each other (false sharing)
+#define CACHE_LINE 64
+
+// with fixed seeds (see hash_fix_seed()) every table gets the same seed, and a
+// shard's table hashing exactly as the shards are picked would only ever use
+// one in every nshards of its addresses, so the seed picking the shards is
+// salted with this
+#define SHARD_SALT 0x5ba4d5a1c3e7f10bULL
+
+// a lock along with the table it guards
+typedef struct shard_data {
+	pthread_rwlock_t lock;	// held for reading by lookups, and for writing by
+							// anything which changes the table
+	HashTable *table;		// the table holding this shard's keys
+} ShardData;
+
+// a shard, padded out to a whole number of cache lines
+typedef union shard {
+	ShardData data;
+	char padding[(sizeof(ShardData) + CACHE_LINE - 1) / CACHE_LINE
+		* CACHE_LINE];
+} Shard;
+
+// a sharded table is an array of shards, along with what it needs to pick a
+// key's shard
+struct sharded_table {
+	Shard *shards;		// array of shards, aligned to a cache line
+	int nshards;		// how many shards (a power of two)
+	Hasher hasher;		// hash function whose low bits pick a key's shard
+	TableType type;		// what type of table each shard is
+	bool shared_reads;	// whether lookups can share a shard's lock
+};
+
+
+/* * *
+ * helper functions
+ */
+
+// find the shard which 'key' belongs to inside 'table'
+static ShardData *shard_of(ShardedHashTable *table, int64 key) {
+	// each shard's own table hashes with a seed of its own, so these bits
+	// tell it nothing about where the key goes inside it
+	int64 hash = hasher_hash(&table->hasher, key);
+	size64 shard = HASH_FIRST(hash) & (table->nshards - 1);
+	return &table->shards[shard].data;
+}
+
+// take the lock of 'shard' inside 'table', exclusively if we're going to
+// change its table ('write'), or otherwise shared with other lookups if its
+// table allows it
+static void lock_shard(ShardedHashTable *table, ShardData *shard, bool write) {
+	if (write || !table->shared_reads) {
+		pthread_rwlock_wrlock(&shard->lock);
+	} else {
+		pthread_rwlock_rdlock(&shard->lock);
+	}
+}
+
+// release the lock of 'shard'
+static void unlock_shard(ShardData *shard) {
+	pthread_rwlock_unlock(&shard->lock);
+}
+
+// count the keys inside 'table' by visiting each of them
+static size64 count_keys(HashTable *table) {
+	HashTableIter iter;
+	hash_table_iter_begin(table, &iter);
+	size64 nkeys = 0;
+	while (hash_table_iter_next(&iter) != NULL) {
+		nkeys++;
+	}
+	return nkeys;
+}
+
+
+/* * *
+ * all functions
+ */
+
+// initialise a sharded hash table made of 'nshards' hash tables of type
+// 'type', each created with initial size 'size'
+ShardedHashTable *new_sharded_hash_table(TableType type, size64 size,
+	int nshards) {
+	assert(nshards > 0 && nshards <= MAX_SHARDS);
+	assert((nshards & (nshards - 1)) == 0);
+
+	ShardedHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	table->nshards = nshards;
+	hasher_init(&table->hasher, hash_default_family(),
+		hash_new_seed() ^ SHARD_SALT);
+	table->type = type;
+
+	// every type but linear probing times its lookups (and the adaptive table
+	// also counts them towards choosing its layout), so only a linear table
+	// is left untouched by a lookup, and can be read by many threads at once
+	table->shared_reads = (type == LINEAR);
+
+	void *shards;
+	int error = posix_memalign(&shards, CACHE_LINE, nshards * sizeof(Shard));
+	assert(error == 0);
+	table->shards = shards;
+
+	int i;
+	for (i = 0; i < nshards; i++) {
+		ShardData *shard = &table->shards[i].data;
+		error = pthread_rwlock_init(&shard->lock, NULL);
+		assert(error == 0);
+		shard->table = new_hash_table(type, size);
+	}
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_sharded_hash_table(ShardedHashTable *table) {
+	assert(table);
+
+	int i;
+	for (i = 0; i < table->nshards; i++) {
+		ShardData *shard = &table->shards[i].data;
+		pthread_rwlock_destroy(&shard->lock);
+		free_hash_table(shard->table);
+	}
+
+	free(table->shards);
+	hasher_free(&table->hasher);
+	free(table);
+}
+
+
+// make room in 'table' for 'nkeys' keys in total, spread evenly over its
+// shards
+void sharded_hash_table_reserve(ShardedHashTable *table, size64 nkeys) {
+	assert(table);
+
+	// round up, so that no shard is left short
+	size64 per_shard = (nkeys + table->nshards - 1) / table->nshards;
+
+	int i;
+	for (i = 0; i < table->nshards; i++) {
+		ShardData *shard = &table->shards[i].data;
+		lock_shard(table, shard, true);
+		hash_table_reserve(shard->table, per_shard);
+		unlock_shard(shard);
+	}
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool sharded_hash_table_insert(ShardedHashTable *table, int64 key) {
+	assert(table);
+
+	ShardData *shard = shard_of(table, key);
+	lock_shard(table, shard, true);
+	bool inserted = hash_table_insert(shard->table, key);
+	unlock_shard(shard);
+
+	return inserted;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool sharded_hash_table_lookup(ShardedHashTable *table, int64 key) {
+	assert(table);
+
+	ShardData *shard = shard_of(table, key);
+	lock_shard(table, shard, false);
+	bool found = hash_table_lookup(shard->table, key);
+	unlock_shard(shard);
+
+	return found;
+}
+
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool sharded_hash_table_put(ShardedHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	ShardData *shard = shard_of(table, key);
+	lock_shard(table, shard, true);
+	bool inserted = hash_table_put(shard->table, key, value);
+	unlock_shard(shard);
+
+	return inserted;
+}
+
+
+// lookup the value stored with 'key' inside 'table', copying it into *value
+// (unless 'value' is NULL)
+// returns true if found, false if not (leaving *value untouched)
+bool sharded_hash_table_get(ShardedHashTable *table, int64 key, int64 *value) {
+	assert(table);
+
+	// the value has to be copied out before the lock is released, since
+	// another thread could move it as soon as we let go
+	ShardData *shard = shard_of(table, key);
+	lock_shard(table, shard, false);
+	bool found = hash_table_get(shard->table, key, value);
+	unlock_shard(shard);
+
+	return found;
+}
+
+
+// replace the value stored with 'key' inside 'table' by 'value', if 'key' is
+// in there (does not insert 'key' otherwise)
+// returns true if the value was updated, false if 'key' was not found
+bool sharded_hash_table_update(ShardedHashTable *table, int64 key,
+	int64 value) {
+	assert(table);
+
+	ShardData *shard = shard_of(table, key);
+	lock_shard(table, shard, true);
+	bool updated = hash_table_update(shard->table, key, value);
+	unlock_shard(shard);
+
+	return updated;
+}
+
+
+// calculate how many bytes of memory 'table' is using, over all its shards
+MemoryUsage sharded_hash_table_memory_usage(ShardedHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = { 0 };
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+	memory_count(&usage, &usage.overhead, table->shards,
+		table->nshards * sizeof(Shard), NULL);
+	memory_count_hasher(&usage, &table->hasher);
+
+	int i;
+	for (i = 0; i < table->nshards; i++) {
+		ShardData *shard = &table->shards[i].data;
+		lock_shard(table, shard, false);
+		memory_add(&usage, hash_table_memory_usage(shard->table));
+		unlock_shard(shard);
+	}
+
+	return usage;
+}
+
+
+// print some statistics about 'table' to stdout
+void sharded_hash_table_stats(ShardedHashTable *table) {
+	assert(table);
+
+	printf("--- sharded table stats ---\n");
+
+	// print how evenly the keys are spread over the shards
+	int i;
+	size64 nkeys = 0, fewest = 0, most = 0;
+	for (i = 0; i < table->nshards; i++) {
+		ShardData *shard = &table->shards[i].data;
+		lock_shard(table, shard, false);
+		size64 n = count_keys(shard->table);
+		unlock_shard(shard);
+
+		nkeys += n;
+		if (i == 0 || n < fewest) {
+			fewest = n;
+		}
+		if (i == 0 || n > most) {
+			most = n;
+		}
+	}
+	printf("number of shards: %d\n", table->nshards);
+	printf("number of keys: %lld\n", (long long) nkeys);
+	printf("keys per shard: %lld to %lld (%.1f on average)\n",
+		(long long) fewest, (long long) most, nkeys * 1.0 / table->nshards);
+	printf("lookups share locks: %s\n", table->shared_reads ? "yes" : "no");
+
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_total(sharded_hash_table_memory_usage(table));
+	printf("memory used: %zu bytes\n", bytes);
+	if (nkeys > 0) {
+		printf("  per entry: %.2f bytes\n", bytes * 1.0 / nkeys);
+	}
+
+	printf("--- end stats ---\n");
+}
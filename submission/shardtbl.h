@@ -0,0 +1,72 @@
+/* * * * * * * * *
+ * Thread-safe hash table made of a number of independent hash tables (shards)
+ * of any type, each guarded by its own lock. every key belongs to the shard
+ * picked out by a hash function of the table's own (seeded independently of
+ * the shards' tables), so threads working on keys in different shards never
+ * wait for each other
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef SHARDTBL_H
+#define SHARDTBL_H
+
+#include <stdbool.h>
+#include "inthash.h"
+#include "hashtbl.h"
+#include "memusage.h"
+
+// the most shards a table can be split into
+#define MAX_SHARDS 1024
+
+typedef struct sharded_table ShardedHashTable;
+
+// initialise a sharded hash table made of 'nshards' hash tables of type
+// 'type', each created with initial size 'size' (as in new_hash_table()).
+// 'nshards' must be a power of two, no more than MAX_SHARDS
+ShardedHashTable *new_sharded_hash_table(TableType type, size64 size,
+	int nshards);
+
+// free all memory associated with 'table'. no other thread may be using it
+void free_sharded_hash_table(ShardedHashTable *table);
+
+// make room in 'table' for 'nkeys' keys in total, spread evenly over its
+// shards (as in hash_table_reserve())
+void sharded_hash_table_reserve(ShardedHashTable *table, size64 nkeys);
+
+// the following functions may be called by any number of threads at once
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool sharded_hash_table_insert(ShardedHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool sharded_hash_table_lookup(ShardedHashTable *table, int64 key);
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool sharded_hash_table_put(ShardedHashTable *table, int64 key, int64 value);
+
+// lookup the value stored with 'key' inside 'table', copying it into *value
+// (unless 'value' is NULL). there is no way to point into a sharded table,
+// since another thread could move the value at any time
+// returns true if found, false if not (leaving *value untouched)
+bool sharded_hash_table_get(ShardedHashTable *table, int64 key, int64 *value);
+
+// replace the value stored with 'key' inside 'table' by 'value', if 'key' is
+// in there (does not insert 'key' otherwise)
+// returns true if the value was updated, false if 'key' was not found
+bool sharded_hash_table_update(ShardedHashTable *table, int64 key,
+	int64 value);
+
+// calculate how many bytes of memory 'table' is using, over all its shards
+// (as in hash_table_memory_usage())
+MemoryUsage sharded_hash_table_memory_usage(ShardedHashTable *table);
+
+// print some statistics about 'table' to stdout
+void sharded_hash_table_stats(ShardedHashTable *table);
+
+#endif
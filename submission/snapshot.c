@@ -0,0 +1,275 @@
+/* * * * * * * * *
+ * Module for saving hash tables to binary snapshot files, and loading them
+ * back by mapping the file into memory so that tables can use their arrays
+ * and buckets in place, without re-inserting any keys
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for mmap, fileno
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>  // for memcmp, memcpy
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+#include "inthash.h"
+#include "stats.h"
+
+// every snapshot file starts with these 8 bytes
+#define MAGIC "HTBLSNAP"
+// written in native byte order, so we can tell if a file came from a machine
+// with a different byte order
+#define BYTE_ORDER_MARK 0x01020304
+// everything is written at (and read from) multiples of this many bytes
+#define ALIGNMENT 8
+
+// the header at the start of every snapshot file
+typedef struct header {
+	char magic[8];			// always MAGIC
+	uint32_t version;		// SNAPSHOT_VERSION when the file was written
+	uint32_t byte_order;	// always BYTE_ORDER_MARK
+	uint32_t entry_size;	// sizeof (Entry) when the file was written
+	int32_t type;			// which type of table follows
+	uint32_t stats;			// STATS_LEVEL of the program that wrote the file,
+							// which decides the layout of some tables
+} Header;
+
+
+/* * * *
+ * all functions
+ */
+
+// write a snapshot header recording the format version and the table type
+// 'type' to 'file'
+void snapshot_write_header(FILE *file, int type) {
+	assert(file);
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof header.magic);
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.entry_size = sizeof (Entry);
+	header.type = type;
+	header.stats = STATS_LEVEL;
+
+	snapshot_write(file, &header, sizeof header);
+}
+
+
+// write 'size' bytes from 'data' to 'file', starting at an 8-byte aligned
+// position so that the data can be used in place once the file is mapped
+void snapshot_write(FILE *file, const void *data, size_t size) {
+	assert(file);
+
+	// pad with zeroes up to the next aligned position
+	long position = ftell(file);
+	while (position % ALIGNMENT != 0) {
+		fputc(0, file);
+		position++;
+	}
+
+	if (size > 0) {
+		fwrite(data, 1, size, file);
+	}
+}
+
+
+// write which hash function 'hasher' is (its family and seed) to 'file'
+void snapshot_write_hasher(FILE *file, Hasher *hasher) {
+	assert(hasher);
+
+	// the family's constants all follow from the seed
+	int64 hashing[2] = {hasher->family, hasher->seed};
+	snapshot_write(file, hashing, sizeof hashing);
+}
+
+
+// map the snapshot file at 'path' into memory (privately, so that changes
+// made to the mapped data are never written back to the file)
+// returns NULL if the file can't be opened or mapped
+Snapshot *snapshot_open(const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof (Header)) {
+		close(fd);
+		return NULL;
+	}
+
+	// map the file copy-on-write: tables may keep inserting into (and so
+	// writing to) the arrays inside it after loading
+	void *base = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		fd, 0);
+	close(fd);  // the mapping stays valid after closing
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+
+	Snapshot *snapshot = malloc(sizeof *snapshot);
+	assert(snapshot);
+	snapshot->base = base;
+	snapshot->size = info.st_size;
+	snapshot->offset = 0;
+	snapshot->error = NULL;
+
+	return snapshot;
+}
+
+
+// check the header at the start of 'snapshot'
+// returns the table type recorded there, or -1 if this isn't a snapshot that
+// this version of the program can read (with snapshot->error saying why)
+int snapshot_read_header(Snapshot *snapshot) {
+	assert(snapshot);
+
+	Header *header = snapshot_read(snapshot, sizeof *header);
+	if (header == NULL) {
+		return -1;
+	}
+	if (memcmp(header->magic, MAGIC, sizeof header->magic) != 0) {
+		snapshot_fail(snapshot, "not a snapshot file");
+		return -1;
+	}
+	if (header->version != SNAPSHOT_VERSION) {
+		snapshot_fail(snapshot, "written by another version of the program");
+		return -1;
+	}
+	if (header->byte_order != BYTE_ORDER_MARK
+		|| header->entry_size != sizeof (Entry)
+		|| header->stats != STATS_LEVEL) {
+		snapshot_fail(snapshot, "written by a differently built program");
+		return -1;
+	}
+
+	return header->type;
+}
+
+
+// get a pointer to the next 'size' bytes of 'snapshot' (starting from the next
+// 8-byte aligned position), and advance past them
+// returns NULL if the snapshot ends before then, or if an earlier read from it
+// has already failed
+void *snapshot_read(Snapshot *snapshot, size_t size) {
+	assert(snapshot);
+	if (snapshot->error) {
+		return NULL;
+	}
+
+	// skip padding up to the next aligned position
+	size_t offset = snapshot->offset;
+	offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	if (offset > snapshot->size || size > snapshot->size - offset) {
+		return snapshot_fail(snapshot, "truncated");
+	}
+
+	snapshot->offset = offset + size;
+	return snapshot->base + offset;
+}
+
+
+// get a pointer to the next array of 'count' elements of 'size' bytes each in
+// 'snapshot', as snapshot_read() does, where 'count' comes from the snapshot
+// itself and so can't be trusted
+// returns NULL if 'count' is negative or the array would run past the end of
+// the snapshot, or if an earlier read has already failed
+void *snapshot_read_array(Snapshot *snapshot, size64 count, size_t size) {
+	assert(snapshot && size > 0);
+
+	// (checked by dividing, since count * size could overflow)
+	if (count < 0 || (size_t) count > snapshot->size / size) {
+		return snapshot_fail(snapshot, "truncated");
+	}
+	return snapshot_read(snapshot, count * size);
+}
+
+// return a pointer to the array of 'count' flags at the next part of
+// 'snapshot', as snapshot_read_array() does
+// returns NULL as it does, or if any flag is neither true nor false
+bool *snapshot_read_flags(Snapshot *snapshot, size64 count) {
+	unsigned char *flags = snapshot_read_array(snapshot, count, sizeof (bool));
+	if (flags == NULL) {
+		return NULL;
+	}
+
+	// (looking at them as bytes: any other value in a bool is undefined)
+	size64 i;
+	for (i = 0; i < count; i++) {
+		if (flags[i] > 1) {
+			return snapshot_fail(snapshot, "corrupt flags");
+		}
+	}
+	return (bool *) flags;
+}
+
+
+// set up 'hasher' as the hash function recorded at the next part of
+// 'snapshot' (as written by snapshot_write_hasher())
+// returns false if it can't be read, or isn't a family this program knows
+bool snapshot_read_hasher(Snapshot *snapshot, Hasher *hasher) {
+	int64 *hashing = snapshot_read(snapshot, 2 * sizeof *hashing);
+	if (hashing == NULL) {
+		return false;
+	}
+	if (hashing[0] >= NUM_HASH_FAMILIES) {
+		snapshot_fail(snapshot, "unknown hash family");
+		return false;
+	}
+	hasher_init(hasher, hashing[0], hashing[1]);
+	return true;
+}
+
+
+// record that 'snapshot' can't be used because of 'error' (unless an earlier
+// failure has already been recorded)
+// returns NULL, so that loaders can return its result
+void *snapshot_fail(Snapshot *snapshot, const char *error) {
+	assert(snapshot && error);
+
+	if (snapshot->error == NULL) {
+		snapshot->error = error;
+	}
+	return NULL;
+}
+
+
+// does 'ptr' point inside the mapped memory of 'snapshot'? ('snapshot' may be
+// NULL, in which case it never does)
+bool snapshot_owns(Snapshot *snapshot, const void *ptr) {
+	if (snapshot == NULL) {
+		return false;
+	}
+
+	// compare as integers, since the pointers may not be from the same object
+	uintptr_t address = (uintptr_t) ptr;
+	uintptr_t start = (uintptr_t) snapshot->base;
+	return start <= address && address < start + snapshot->size;
+}
+
+
+// free 'ptr' just like free(), unless it points inside 'snapshot' (in which
+// case it will be released along with the rest of the mapping)
+void snapshot_release(Snapshot *snapshot, void *ptr) {
+	if (!snapshot_owns(snapshot, ptr)) {
+		free(ptr);
+	}
+}
+
+
+// unmap 'snapshot' and free all memory associated with it. nothing may use
+// the memory inside the mapping afterwards
+void snapshot_close(Snapshot *snapshot) {
+	assert(snapshot);
+
+	munmap(snapshot->base, snapshot->size);
+	free(snapshot);
+}
@@ -0,0 +1,96 @@
+/* * * * * * * * *
+ * Module for saving hash tables to binary snapshot files, and loading them
+ * back by mapping the file into memory so that tables can use their arrays
+ * and buckets in place, without re-inserting any keys
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "inthash.h"
+
+// the version of the snapshot format written by this module. bump this
+// whenever the layout of any table's snapshot changes, or any hash family
+// hashes keys differently (tables are saved laid out by their hash values)
+#define SNAPSHOT_VERSION 6
+
+// a snapshot file that has been mapped into memory, along with how far through
+// it we have read so far
+typedef struct snapshot {
+	char *base;		// the start of the mapped file
+	size_t size;	// the size of the mapped file in bytes
+	size_t offset;	// how many bytes have been read so far
+	const char *error;	// why the snapshot couldn't be read, once it turns
+						// out that it can't (NULL until then)
+} Snapshot;
+
+// write a snapshot header recording the format version and the table type
+// 'type' to 'file'
+void snapshot_write_header(FILE *file, int type);
+
+// write 'size' bytes from 'data' to 'file', starting at an 8-byte aligned
+// position so that the data can be used in place once the file is mapped
+void snapshot_write(FILE *file, const void *data, size_t size);
+
+// write which hash function 'hasher' is (its family and seed) to 'file'
+void snapshot_write_hasher(FILE *file, Hasher *hasher);
+
+// map the snapshot file at 'path' into memory (privately, so that changes
+// made to the mapped data are never written back to the file)
+// returns NULL if the file can't be opened or mapped
+Snapshot *snapshot_open(const char *path);
+
+// check the header at the start of 'snapshot'
+// returns the table type recorded there, or -1 if this isn't a snapshot that
+// this version of the program can read (with snapshot->error saying why)
+int snapshot_read_header(Snapshot *snapshot);
+
+// get a pointer to the next 'size' bytes of 'snapshot' (starting from the next
+// 8-byte aligned position), and advance past them
+// returns NULL if the snapshot ends before then, or if an earlier read from it
+// has already failed (so that a run of reads can be checked once, at the end)
+void *snapshot_read(Snapshot *snapshot, size_t size);
+
+// get a pointer to the next array of 'count' elements of 'size' bytes each in
+// 'snapshot', as snapshot_read() does, where 'count' comes from the snapshot
+// itself and so can't be trusted
+// returns NULL if 'count' is negative or the array would run past the end of
+// the snapshot, or if an earlier read has already failed
+void *snapshot_read_array(Snapshot *snapshot, size64 count, size_t size);
+
+// return a pointer to the array of 'count' flags at the next part of
+// 'snapshot', as snapshot_read_array() does
+// returns NULL as it does, or if any flag is neither true nor false
+bool *snapshot_read_flags(Snapshot *snapshot, size64 count);
+
+// set up 'hasher' as the hash function recorded at the next part of
+// 'snapshot' (as written by snapshot_write_hasher())
+// returns false if it can't be read, or isn't a family this program knows
+// (leaving 'hasher' untouched)
+bool snapshot_read_hasher(Snapshot *snapshot, Hasher *hasher);
+
+// record that 'snapshot' can't be used because of 'error' (unless an earlier
+// failure has already been recorded), for loaders which find that what they
+// read makes no sense
+// returns NULL, so that loaders can return its result
+void *snapshot_fail(Snapshot *snapshot, const char *error);
+
+// does 'ptr' point inside the mapped memory of 'snapshot'? ('snapshot' may be
+// NULL, in which case it never does)
+bool snapshot_owns(Snapshot *snapshot, const void *ptr);
+
+// free 'ptr' just like free(), unless it points inside 'snapshot' (in which
+// case it will be released along with the rest of the mapping)
+void snapshot_release(Snapshot *snapshot, void *ptr);
+
+// unmap 'snapshot' and free all memory associated with it. nothing may use
+// the memory inside the mapping afterwards
+void snapshot_close(Snapshot *snapshot);
+
+#endif
@@ -0,0 +1,26 @@
+/* * * * * * * * *
+ * How much statistics gathering is compiled into the hash tables, chosen when
+ * building with make STATS=n (see Makefile), which sets STATS_LEVEL. a
+ * production build can then pay nothing at all for statistics, while a
+ * debugging or benchmarking build keeps the full reports
+ *
+ * only statistics are affected: counts a table needs in order to work (such
+ * as how many keys or buckets it has) are always kept
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#define STATS_OFF      0	// no statistics: operations do no extra work
+#define STATS_COUNTERS 1	// plain counters, each updated with an addition
+#define STATS_FULL     2	// counters, histograms of insertions by load
+							// factor, and sampled operation times
+
+#ifndef STATS_LEVEL
+#define STATS_LEVEL STATS_FULL
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+/* * * * * * * * *
+ * Module containing hash functions for variable-length byte strings
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <string.h>  // for memcpy
+
+#include "strhash.h"
+
+// large odd constants used to mix words into the hash
+#define M1 0xa0761d6478bd642fULL
+#define M2 0xe7037ed1a0b428dbULL
+
+// constants for the final avalanche (from murmurhash3's 64-bit finaliser)
+#define F1 0xff51afd7ed558ccdULL
+#define F2 0xc4ceb9fe1a85ec53ULL
+
+// macro to rotate a 64-bit number x left by n bits
+#define rotl(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+// mix one 8-byte word into the running hash value h
+static int64 mix(int64 h, int64 word) {
+	h ^= word * M2;
+	h = rotl(h, 31);
+	return h * M1;
+}
+
+// hash function for byte strings
+int64 strhash(const char *bytes, int len) {
+	int64 h = len * M1;
+	int64 word;
+
+	// consume whole 8-byte words first (memcpy avoids unaligned reads)
+	int i;
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&word, bytes + i, 8);
+		h = mix(h, word);
+	}
+
+	// then the last 0-7 bytes, padded with zeroes
+	if (i < len) {
+		word = 0;
+		memcpy(&word, bytes + i, len - i);
+		h = mix(h, word);
+	}
+
+	// finally, avalanche the bits so that every bit of the output is useful
+	h ^= h >> 33;
+	h *= F1;
+	h ^= h >> 33;
+	h *= F2;
+	h ^= h >> 33;
+	return h;
+}
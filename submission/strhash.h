@@ -0,0 +1,23 @@
+/* * * * * * * * *
+ * Module containing hash functions for variable-length byte strings
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef STRHASH_H
+#define STRHASH_H
+
+#include "inthash.h"
+
+// the following function takes 'len' bytes starting at 'bytes' and returns a
+// 64-bit hash of them. the bytes are consumed 8 at a time, each word being
+// multiplied into the running hash, and the result is finally avalanched so
+// that every output bit depends on every input bit. this means both the top
+// and bottom halves of the hash can be used independently (e.g. one half for
+// addressing and the other as a fragment for quickly rejecting mismatches)
+
+// hash function for byte strings
+int64 strhash(const char *bytes, int len);
+
+#endif
@@ -0,0 +1,567 @@
+/* * * * * * * * *
+ * Adaptive hash table which watches its own workload (the mix of operations,
+ * how often lookups miss, how full it is and how long operations take) and
+ * migrates its keys to whichever of the other table types suits that
+ * workload best, a few keys at a time so that it keeps working throughout
+ *
+ * the workload is measured in epochs of EPOCH_LENGTH operations. at the end
+ * of each epoch, a few rules of thumb suggest which layout (if any) would do
+ * better. once the same layout has been suggested PATIENCE epochs in a row,
+ * and it wasn't measured to be slower the last time we used it, the table
+ * starts migrating to it. while migrating, every operation (lookups too, so
+ * that a read-only workload still finishes the move) carries a few more keys
+ * across, and the old layout stays in use for keys not yet moved
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+#include "adaptive.h"
+
+// how many operations make up one epoch of workload measurements
+#define EPOCH_LENGTH 4096
+// time one in every this many operations, so that timing stays cheap
+#define SAMPLE_PERIOD 16
+// how many epochs in a row another layout must look better before we move
+#define PATIENCE 4
+// another layout must have been at most this fraction of the current cost
+// per operation (last time we used it) to be worth moving to again
+#define CLEAR_WIN 0.8
+// how many keys each operation moves across while migrating
+#define MIGRATE_STEP 16
+
+// workload thresholds used by the rules of thumb (see better_layout())
+#define HIGH_LOAD 0.7		// load factor above which probing gets slow
+#define INSERT_HEAVY 0.5	// fraction of operations inserting new keys
+#define READ_MOSTLY 0.05	// ... and below which the table is read-mostly
+#define MISS_HEAVY 0.5		// fraction of lookups not finding their key
+
+// bucket size to use when migrating to an extendible table
+#define BUCKET_SIZE 4
+
+// how many different layouts there are (not counting AUTO itself)
+#define NUM_LAYOUTS (XUCKOON + 1)
+
+// names of the layouts, for printing stats
+static const char *layout_names[NUM_LAYOUTS] = {
+	"linear", "xtndbl1", "cuckoo", "xtndbln", "xuckoo", "xuckoon"
+};
+
+// what kind of operation is being measured
+typedef enum operation {
+	INSERTION, LOOKUP
+} Operation;
+
+// measurements of the workload during the current epoch
+typedef struct epoch {
+	int nops;			// how many operations so far
+	int ninserts;		// how many of them inserted a new key
+	int nlookups;		// how many of them looked a key up
+	int nmisses;		// how many of those lookups didn't find their key
+	int nsamples;		// how many operations were timed
+	double sample_ns;	// total time taken by those operations (nanoseconds)
+} Epoch;
+
+// when an operation being timed started (if it is being timed at all)
+typedef struct timer {
+	bool sampled;
+	struct timespec start;
+} Timer;
+
+struct adaptive_table {
+	HashTable *current;	// the table holding the keys (or those not moved yet)
+	HashTable *next;	// the table being migrated to, or NULL if not migrating
+	TableType layout;	// the type of 'current'
+	TableType target;	// the type of 'next', or the type we will migrate to
+						// on the next operation, or NOTYPE
+	HashTableIter migration;	// how far through 'current' the migration is
+	size64 nkeys;		// how many keys are being stored in the table
+	Epoch epoch;		// workload measurements so far this epoch
+	TableType candidate;// the layout better_layout() has been suggesting
+	int nvotes;			// for how many epochs in a row
+	double cost[NUM_LAYOUTS];	// average nanoseconds per operation in the
+								// last full epoch in each layout (0 if never)
+	int nmigrations;	// how many times the table has changed layout
+	int nepochs;		// how many epochs have been measured
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// set up the rest of 'table' around a 'current' table of type 'layout'
+static void initialise_table(AdaptiveHashTable *table, HashTable *current,
+	TableType layout) {
+	table->current = current;
+	table->next = NULL;
+	table->layout = layout;
+	table->target = NOTYPE;
+	table->nkeys = 0;
+	table->epoch = (Epoch){ 0 };
+	table->candidate = NOTYPE;
+	table->nvotes = 0;
+	int i;
+	for (i = 0; i < NUM_LAYOUTS; i++) {
+		table->cost[i] = 0;
+	}
+	table->nmigrations = 0;
+	table->nepochs = 0;
+}
+
+// which layout would suit the workload measured this epoch clearly better
+// than the current one, or NOTYPE if we're best off where we are
+static TableType better_layout(AdaptiveHashTable *table) {
+	Epoch *epoch = &table->epoch;
+	double insert_rate = (double) epoch->ninserts / epoch->nops;
+	double miss_ratio = 0;
+	if (epoch->nlookups > 0) {
+		miss_ratio = (double) epoch->nmisses / epoch->nlookups;
+	}
+	double load_factor = hash_table_load_factor(table->current);
+
+	switch (table->layout) {
+		case LINEAR:
+			// a linear table only grows once it's completely full, so probe
+			// sequences get long as it fills up (for misses most of all, which
+			// probe all the way to an empty slot)
+			if (load_factor > HIGH_LOAD) {
+				if (insert_rate > INSERT_HEAVY) {
+					// an extendible table grows one bucket at a time instead
+					return XTNDBLN;
+				}
+				if (miss_ratio > MISS_HEAVY) {
+					// a cuckoo table looks in exactly two slots for any key
+					return CUCKOO;
+				}
+			}
+			return NOTYPE;
+		case CUCKOO:
+			// inserting into a cuckoo table can displace long chains of keys
+			// and even trigger a complete rehash
+			if (insert_rate > INSERT_HEAVY) {
+				return XTNDBLN;
+			}
+			return NOTYPE;
+		case XTNDBLN:
+			// once insertions die down, a half-full linear table finds most
+			// keys with a single probe and no pointer to follow (or, if most
+			// lookups miss, a cuckoo table rules them out in two)
+			if (insert_rate < READ_MOSTLY) {
+				return (miss_ratio > MISS_HEAVY) ? CUCKOO : LINEAR;
+			}
+			return NOTYPE;
+		default:
+			return NOTYPE;
+	}
+}
+
+// wrap up the current epoch: remember how fast the current layout was, and
+// decide whether it's time to move to another one
+static void end_epoch(AdaptiveHashTable *table) {
+	Epoch *epoch = &table->epoch;
+
+	// measurements taken mid-migration are a mix of two layouts, so they're
+	// no good for deciding anything
+	if (table->next == NULL) {
+		if (epoch->nsamples > 0) {
+			table->cost[table->layout] = epoch->sample_ns / epoch->nsamples;
+		}
+
+		TableType suggestion = better_layout(table);
+		if (suggestion != NOTYPE && suggestion == table->candidate) {
+			table->nvotes++;
+		} else {
+			table->candidate = suggestion;
+			table->nvotes = (suggestion != NOTYPE) ? 1 : 0;
+		}
+
+		// only move if the suggestion has been consistent for a while, and
+		// wasn't already measured to be no faster than where we are now
+		double current_cost = table->cost[table->layout];
+		double candidate_cost = (table->candidate != NOTYPE)
+			? table->cost[table->candidate] : 0;
+		if (table->nvotes >= PATIENCE && (candidate_cost == 0
+				|| candidate_cost < CLEAR_WIN * current_cost)) {
+			table->target = table->candidate;
+		}
+	}
+
+	table->nepochs++;
+	table->epoch = (Epoch){ 0 };
+}
+
+// get ready to measure an operation on 'table', deciding whether to time it
+static void begin_operation(AdaptiveHashTable *table, Timer *timer) {
+	timer->sampled = (table->epoch.nops % SAMPLE_PERIOD == 0);
+	if (timer->sampled) {
+		clock_gettime(CLOCK_MONOTONIC, &timer->start);
+	}
+}
+
+// record the operation on 'table' begun with 'timer'. 'success' is whether an
+// insertion added a new key, or whether a lookup found its key
+static void end_operation(AdaptiveHashTable *table, Timer *timer,
+	Operation operation, bool success) {
+	Epoch *epoch = &table->epoch;
+
+	if (timer->sampled) {
+		struct timespec end;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		epoch->sample_ns += (end.tv_sec - timer->start.tv_sec) * 1e9
+			+ (end.tv_nsec - timer->start.tv_nsec);
+		epoch->nsamples++;
+	}
+
+	if (operation == INSERTION) {
+		epoch->ninserts += success;
+	} else {
+		epoch->nlookups++;
+		epoch->nmisses += !success;
+	}
+
+	epoch->nops++;
+	if (epoch->nops == EPOCH_LENGTH) {
+		end_epoch(table);
+	}
+}
+
+// create an empty table of type 'layout', big enough for 'nkeys' keys
+static HashTable *new_layout(TableType layout, size64 nkeys) {
+	size64 size = (nkeys > 0) ? nkeys : 1;
+	switch (layout) {
+		case LINEAR:
+			// keep the load factor around one half
+			return new_hash_table(LINEAR, size * 2);
+		case CUCKOO:
+			// 'size' slots in each of the two inner tables
+			return new_hash_table(CUCKOO, size);
+		default:
+			// the extendible tables grow as they go
+			return new_hash_table(layout, BUCKET_SIZE);
+	}
+}
+
+// the old table is empty of keys we haven't moved yet: switch over to the new
+// one for good
+static void finish_migration(AdaptiveHashTable *table) {
+	free_hash_table(table->current);
+	table->current = table->next;
+	table->layout = table->target;
+	table->next = NULL;
+	table->target = NOTYPE;
+	table->candidate = NOTYPE;
+	table->nvotes = 0;
+	table->nmigrations++;
+}
+
+// start migrating to the layout chosen at the end of an epoch, if any, or
+// carry on with the migration in progress by moving a few more keys
+static void migrate_step(AdaptiveHashTable *table) {
+	if (table->target == NOTYPE) {
+		return;
+	}
+
+	if (table->next == NULL) {
+		table->next = new_layout(table->target, table->nkeys);
+		hash_table_iter_begin(table->current, &table->migration);
+	}
+
+	int i;
+	for (i = 0; i < MIGRATE_STEP; i++) {
+		Entry *entry = hash_table_iter_next(&table->migration);
+		if (entry == NULL) {
+			finish_migration(table);
+			return;
+		}
+		// keys only ever go into the new table once the migration has passed
+		// them (see adaptive_hash_table_put()), so this never overwrites
+		// anything newer
+		hash_table_put(table->next, entry->key, entry->value);
+	}
+}
+
+// find where the value for 'key' is stored inside 'table': in the new table
+// if it has been moved there already, otherwise in the current one
+static int64 *find_value(AdaptiveHashTable *table, int64 key) {
+	if (table->next != NULL) {
+		int64 *value = hash_table_find_value(table->next, key);
+		if (value != NULL) {
+			return value;
+		}
+	}
+	return hash_table_find_value(table->current, key);
+}
+
+// advance 'cursor' to the next entry inside 'inner'
+static Entry *inner_iter_next(HashTable *inner, Cursor *cursor) {
+	HashTableIter iter = { .table = inner, .cursor = *cursor };
+	Entry *entry = hash_table_iter_next(&iter);
+	*cursor = iter.cursor;
+	return entry;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise an adaptive hash table with initial size 'size'
+AdaptiveHashTable *new_adaptive_hash_table(size64 size) {
+	AdaptiveHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	initialise_table(table, new_hash_table(LINEAR, size), LINEAR);
+
+	return table;
+}
+
+
+// build an adaptive hash table containing the 'n' keys in 'keys', using
+// 'nthreads' threads
+AdaptiveHashTable *adaptive_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads) {
+	AdaptiveHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	HashTable *current = hash_table_bulk_load(LINEAR, 0, keys, n, nthreads);
+	initialise_table(table, current, LINEAR);
+
+	// duplicates were dropped along the way, so count what's really there
+	HashTableIter iter;
+	hash_table_iter_begin(current, &iter);
+	while (hash_table_iter_next(&iter) != NULL) {
+		table->nkeys++;
+	}
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_adaptive_hash_table(AdaptiveHashTable *table) {
+	assert(table);
+
+	free_hash_table(table->current);
+	if (table->next != NULL) {
+		free_hash_table(table->next);
+	}
+	free(table);
+}
+
+
+// make room in 'table' for 'nkeys' keys in total, without growing as they're
+// inserted
+void adaptive_hash_table_reserve(AdaptiveHashTable *table, size64 nkeys) {
+	assert(table);
+
+	// the layout we're moving to is the one that will need the room
+	HashTable *inner = table->next ? table->next : table->current;
+	hash_table_reserve(inner, nkeys);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool adaptive_hash_table_insert(AdaptiveHashTable *table, int64 key) {
+	assert(table);
+
+	Timer timer;
+	begin_operation(table, &timer);
+
+	bool inserted = false;
+	if (find_value(table, key) == NULL) {
+		HashTable *destination = table->next ? table->next : table->current;
+		inserted = hash_table_insert(destination, key);
+		table->nkeys++;
+	}
+	migrate_step(table);
+
+	end_operation(table, &timer, INSERTION, inserted);
+	return inserted;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool adaptive_hash_table_lookup(AdaptiveHashTable *table, int64 key) {
+	assert(table);
+
+	Timer timer;
+	begin_operation(table, &timer);
+
+	// (moving keys before looking, as in adaptive_hash_table_get())
+	migrate_step(table);
+	bool found = (find_value(table, key) != NULL);
+
+	end_operation(table, &timer, LOOKUP, found);
+	return found;
+}
+
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool adaptive_hash_table_put(AdaptiveHashTable *table, int64 key,
+	int64 value) {
+	assert(table);
+
+	Timer timer;
+	begin_operation(table, &timer);
+
+	// keys the migration hasn't reached yet are updated where they are, and
+	// carried across later along with their new value
+	bool inserted = false;
+	int64 *stored = find_value(table, key);
+	if (stored != NULL) {
+		*stored = value;
+	} else {
+		HashTable *destination = table->next ? table->next : table->current;
+		inserted = hash_table_put(destination, key, value);
+		table->nkeys++;
+	}
+	migrate_step(table);
+
+	end_operation(table, &timer, INSERTION, inserted);
+	return inserted;
+}
+
+
+// lookup the value stored with 'key' inside 'table'
+// returns a pointer to the value, or NULL if 'key' is not in the table
+int64 *adaptive_hash_table_get(AdaptiveHashTable *table, int64 key) {
+	assert(table);
+
+	Timer timer;
+	begin_operation(table, &timer);
+
+	// move keys before looking, so that the pointer returned stays where the
+	// key is until the next operation
+	migrate_step(table);
+	int64 *value = find_value(table, key);
+
+	end_operation(table, &timer, LOOKUP, value != NULL);
+	return value;
+}
+
+
+// advance 'cursor' to the next entry inside 'table'
+// returns a pointer to the entry inside the table itself, or NULL once every
+// entry has been visited
+Entry *adaptive_hash_table_iter_next(AdaptiveHashTable *table,
+	Cursor *cursor) {
+	assert(table);
+	assert(cursor);
+
+	// stage 0: every key already moved to the new table (if migrating)
+	if (cursor->stage == 0 && table->next != NULL) {
+		Entry *entry = inner_iter_next(table->next, cursor);
+		if (entry != NULL) {
+			return entry;
+		}
+	}
+	if (cursor->stage == 0) {
+		*cursor = (Cursor){ .stage = 1 };
+	}
+
+	// stage 1: every key in the current table, apart from those already
+	// visited in the new table
+	Entry *entry;
+	while ((entry = inner_iter_next(table->current, cursor)) != NULL) {
+		if (table->next == NULL
+			|| hash_table_find_value(table->next, entry->key) == NULL) {
+			return entry;
+		}
+	}
+
+	// no more entries left
+	return NULL;
+}
+
+
+// finish any migration in progress, and return the table now holding every
+// key
+HashTable *adaptive_hash_table_settle(AdaptiveHashTable *table) {
+	assert(table);
+
+	while (table->next != NULL) {
+		migrate_step(table);
+	}
+	return table->current;
+}
+
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double adaptive_hash_table_load_factor(AdaptiveHashTable *table) {
+	assert(table);
+
+	// the layout we're moving to is the one that will matter from now on
+	HashTable *inner = table->next ? table->next : table->current;
+	return hash_table_load_factor(inner);
+}
+
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage adaptive_hash_table_memory_usage(AdaptiveHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = hash_table_memory_usage(table->current);
+	if (table->next != NULL) {
+		memory_add(&usage, hash_table_memory_usage(table->next));
+	}
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+	return usage;
+}
+
+
+// print the contents of 'table' to stdout
+void adaptive_hash_table_print(AdaptiveHashTable *table) {
+	assert(table);
+
+	if (table->next != NULL) {
+		printf("--- keys already migrated to %s ---\n",
+			layout_names[table->target]);
+		hash_table_print(table->next);
+	}
+	hash_table_print(table->current);
+}
+
+
+// print some statistics about 'table' to stdout
+void adaptive_hash_table_stats(AdaptiveHashTable *table) {
+	assert(table);
+
+	printf("--- adaptive table stats ---\n");
+
+	// print some information about the layouts used
+	printf("current layout: %s\n", layout_names[table->layout]);
+	if (table->next != NULL) {
+		printf("migrating to: %s\n", layout_names[table->target]);
+	}
+	printf("number of keys: %lld\n", (long long) table->nkeys);
+	printf("migrations so far: %d\n", table->nmigrations);
+	printf("epochs measured: %d (of %d operations)\n", table->nepochs,
+		EPOCH_LENGTH);
+
+	// print the cost of each layout we've measured
+	printf("average cost per operation:\n");
+	int i;
+	for (i = 0; i < NUM_LAYOUTS; i++) {
+		if (table->cost[i] > 0) {
+			printf("    %-8s %.1f ns\n", layout_names[i], table->cost[i]);
+		}
+	}
+
+	printf("--- end stats ---\n");
+
+	// and the stats of the layout itself
+	hash_table_stats(table->next ? table->next : table->current);
+}
@@ -0,0 +1,81 @@
+/* * * * * * * * *
+ * Adaptive hash table which watches its own workload (the mix of operations,
+ * how often lookups miss, how full it is and how long operations take) and
+ * migrates its keys to whichever of the other table types suits that
+ * workload best, a few keys at a time so that it keeps working throughout
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../hashtbl.h"
+
+typedef struct adaptive_table AdaptiveHashTable;
+
+// initialise an adaptive hash table with initial size 'size'. it starts out as
+// a linear probing table of that size
+AdaptiveHashTable *new_adaptive_hash_table(size64 size);
+
+// build an adaptive hash table containing the 'n' keys in 'keys' (which may
+// contain duplicates) in parallel using 'nthreads' threads. it starts out as a
+// linear probing table
+AdaptiveHashTable *adaptive_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads);
+
+// free all memory associated with 'table'
+void free_adaptive_hash_table(AdaptiveHashTable *table);
+
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), in whichever layout it is using or moving to. never shrinks the table
+void adaptive_hash_table_reserve(AdaptiveHashTable *table, size64 nkeys);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool adaptive_hash_table_insert(AdaptiveHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool adaptive_hash_table_lookup(AdaptiveHashTable *table, int64 key);
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool adaptive_hash_table_put(AdaptiveHashTable *table, int64 key, int64 value);
+
+// lookup the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next operation on
+// 'table', since lookups move keys too while migrating), or NULL if 'key' is
+// not in the table
+int64 *adaptive_hash_table_get(AdaptiveHashTable *table, int64 key);
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once, even part way through a
+// migration. lookups move keys too while migrating, so any other operation on
+// 'table' invalidates it
+// returns a pointer to the entry inside the table itself (only valid until the
+// next operation), or NULL once every entry has been visited
+Entry *adaptive_hash_table_iter_next(AdaptiveHashTable *table, Cursor *cursor);
+
+// finish any migration in progress, and return the table now holding every
+// key (owned by 'table', and only valid until the next operation on it)
+HashTable *adaptive_hash_table_settle(AdaptiveHashTable *table);
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double adaptive_hash_table_load_factor(AdaptiveHashTable *table);
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for (counting both layouts while migrating)
+MemoryUsage adaptive_hash_table_memory_usage(AdaptiveHashTable *table);
+
+// print the contents of 'table' to stdout
+void adaptive_hash_table_print(AdaptiveHashTable *table);
+
+// print some statistics about 'table' to stdout
+void adaptive_hash_table_stats(AdaptiveHashTable *table);
+
+#endif
@@ -0,0 +1,101 @@
+/* * * * * * * * *
+ * Append-only arena for storing variable-length keys contiguously, referring
+ * to each one by its byte offset from the start of the arena
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>  // for memcpy
+
+#include "arena.h"
+
+// an arena is one big growable block of bytes. keys are only ever appended, so
+// an offset into the block stays valid forever, even when the block is moved
+// by realloc (unlike a pointer)
+struct arena {
+	char *bytes;		// the block of bytes holding all of the keys
+	size_t used;		// how many bytes have been appended so far
+	size_t capacity;	// how many bytes the block has room for
+};
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise an empty arena with room for 'capacity' bytes to begin with
+KeyArena *new_key_arena(size_t capacity) {
+	KeyArena *arena = malloc(sizeof *arena);
+	assert(arena);
+
+	// always make room for at least one byte, so that doubling works
+	if (capacity < 1) {
+		capacity = 1;
+	}
+
+	arena->bytes = malloc(capacity);
+	assert(arena->bytes);
+	arena->used = 0;
+	arena->capacity = capacity;
+
+	return arena;
+}
+
+
+// free all memory associated with 'arena'
+void free_key_arena(KeyArena *arena) {
+	assert(arena);
+
+	free(arena->bytes);
+	free(arena);
+}
+
+
+// append a copy of the 'len' bytes at 'bytes' to the end of 'arena'
+// returns the offset at which they were stored, for use with key_arena_at()
+int64 key_arena_append(KeyArena *arena, const char *bytes, int len) {
+	assert(arena);
+	assert(len >= 0);
+
+	// double the block until these bytes will fit on the end
+	if (arena->used + len > arena->capacity) {
+		while (arena->used + len > arena->capacity) {
+			arena->capacity *= 2;
+		}
+		arena->bytes = realloc(arena->bytes, arena->capacity);
+		assert(arena->bytes);
+	}
+
+	int64 offset = arena->used;
+	memcpy(arena->bytes + offset, bytes, len);
+	arena->used += len;
+
+	return offset;
+}
+
+
+// get a pointer to the bytes stored at 'offset' inside 'arena'
+// (only valid until the next append, as the arena may move when it grows)
+const char *key_arena_at(KeyArena *arena, int64 offset) {
+	assert(arena);
+	assert(offset <= arena->used);
+
+	return arena->bytes + offset;
+}
+
+
+// how many bytes have been appended to 'arena' so far
+size_t key_arena_used(KeyArena *arena) {
+	assert(arena);
+	return arena->used;
+}
+
+
+// how many bytes of memory 'arena' is currently using
+size_t key_arena_memory(KeyArena *arena) {
+	assert(arena);
+	return sizeof *arena + arena->capacity;
+}
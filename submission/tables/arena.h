@@ -0,0 +1,37 @@
+/* * * * * * * * *
+ * Append-only arena for storing variable-length keys contiguously, referring
+ * to each one by its byte offset from the start of the arena
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "../inthash.h"
+
+typedef struct arena KeyArena;
+
+// initialise an empty arena with room for 'capacity' bytes to begin with
+KeyArena *new_key_arena(size_t capacity);
+
+// free all memory associated with 'arena'
+void free_key_arena(KeyArena *arena);
+
+// append a copy of the 'len' bytes at 'bytes' to the end of 'arena'
+// returns the offset at which they were stored, for use with key_arena_at()
+int64 key_arena_append(KeyArena *arena, const char *bytes, int len);
+
+// get a pointer to the bytes stored at 'offset' inside 'arena'
+// (only valid until the next append, as the arena may move when it grows)
+const char *key_arena_at(KeyArena *arena, int64 offset);
+
+// how many bytes have been appended to 'arena' so far
+size_t key_arena_used(KeyArena *arena);
+
+// how many bytes of memory 'arena' is currently using
+size_t key_arena_memory(KeyArena *arena);
+
+#endif
@@ -0,0 +1,320 @@
+/* * * * * * * * *
+ * Helpers for building tables from large arrays of keys in parallel:
+ * deduplicating and radix-partitioning the keys by hash value, and running
+ * one task per partition across a number of threads
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>  // for memcpy
+#include <pthread.h>
+
+#include "bulk.h"
+#include "../hugemem.h"
+
+// state shared between the threads working through a set of partitions.
+// threads claim partitions one at a time by incrementing 'next', so that one
+// slow partition doesn't hold up the rest
+typedef struct job {
+	Partitions *partitions;
+	PartitionTask task;
+	void *arg;
+	int next;			// the next partition which hasn't been claimed yet
+} Job;
+
+// state for counting and scattering one contiguous chunk of the input keys
+typedef struct chunk {
+	int64 *keys;		// the keys in this chunk
+	size64 n;			// how many keys in this chunk
+	int *partition;		// which partition each of those keys belongs to
+	size64 *offsets;	// where this chunk's keys go in each partition
+} Chunk;
+
+// state for the counting and scattering passes of partition_keys()
+typedef struct scatter {
+	Chunk *chunks;				// one chunk of input per thread
+	PartitionFunction partition_of;
+	void *arg;
+	int npartitions;			// how many partitions there are
+	int64 *out;					// where the partitioned keys go
+} Scatter;
+
+
+/* * * *
+ * helper functions
+ */
+
+// keep claiming and running partitions until there are none left
+static void *work(void *arg) {
+	Job *job = arg;
+
+	int p;
+	while ((p = __sync_fetch_and_add(&job->next, 1))
+		< job->partitions->npartitions) {
+		job->task(job->partitions, p, job->arg);
+	}
+
+	return NULL;
+}
+
+// compare two keys, for sorting with qsort
+static int compare_keys(const void *a, const void *b) {
+	int64 x = *(const int64 *)a;
+	int64 y = *(const int64 *)b;
+	return (x > y) - (x < y);
+}
+
+// task: sort partition 'p' and squash out any duplicate keys
+static void deduplicate(Partitions *partitions, int p, void *arg) {
+	int64 *keys = partitions->keys + partitions->starts[p];
+	size64 n = partitions->counts[p];
+	if (n < 2) {
+		return;
+	}
+
+	qsort(keys, n, sizeof *keys, compare_keys);
+
+	// copy each key down unless it's the same as the last one kept
+	size64 kept = 1;
+	size64 i;
+	for (i = 1; i < n; i++) {
+		if (keys[i] != keys[kept-1]) {
+			keys[kept++] = keys[i];
+		}
+	}
+	partitions->counts[p] = kept;
+}
+
+// task: work out which partition each key in chunk 't' belongs to, and count
+// how many of them go to each partition (in the chunk's offsets array, which
+// is turned into actual offsets once every chunk has been counted)
+static void count_chunk(Partitions *partitions, int t, void *arg) {
+	Scatter *scatter = arg;
+	Chunk *chunk = &scatter->chunks[t];
+	size64 *counts = chunk->offsets;
+
+	size64 i;
+	for (i = 0; i < chunk->n; i += HASH_BATCH) {
+		int n = (chunk->n - i < HASH_BATCH) ? chunk->n - i : HASH_BATCH;
+		scatter->partition_of(chunk->keys + i, chunk->partition + i, n,
+			scatter->arg);
+	}
+	for (i = 0; i < chunk->n; i++) {
+		int p = chunk->partition[i];
+		assert(0 <= p && p < scatter->npartitions);
+		counts[p]++;
+	}
+}
+
+// task: copy the keys in chunk 't' to their places in the output
+static void scatter_chunk(Partitions *partitions, int t, void *arg) {
+	Scatter *scatter = arg;
+	Chunk *chunk = &scatter->chunks[t];
+
+	size64 i;
+	for (i = 0; i < chunk->n; i++) {
+		int p = chunk->partition[i];
+		scatter->out[chunk->offsets[p]++] = chunk->keys[i];
+	}
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// split the 'n' keys in 'keys' into 'npartitions' partitions according to
+// 'partition_of' (called with 'arg'), dropping any duplicates, using
+// 'nthreads' threads. 'keys' itself is left untouched
+Partitions *partition_keys(int64 *keys, size64 n, int npartitions,
+	PartitionFunction partition_of, void *arg, int nthreads) {
+	assert(npartitions > 0);
+
+	if (nthreads < 1) {
+		nthreads = 1;
+	}
+
+	Partitions *partitions = malloc(sizeof *partitions);
+	assert(partitions);
+	partitions->npartitions = npartitions;
+	partitions->nthreads = nthreads;
+	partitions->keys = huge_malloc((sizeof *partitions->keys)
+		* (n > 0 ? n : 1));
+	assert(partitions->keys);
+	partitions->starts = calloc(npartitions, sizeof *partitions->starts);
+	assert(partitions->starts);
+	partitions->counts = calloc(npartitions, sizeof *partitions->counts);
+	assert(partitions->counts);
+
+	// FIRST,
+	// split the input into one chunk per thread, and have each thread count
+	// how many of its keys belong to each partition
+	Scatter scatter = { .partition_of = partition_of, .arg = arg,
+		.npartitions = npartitions, .out = partitions->keys };
+	scatter.chunks = malloc((sizeof *scatter.chunks) * nthreads);
+	assert(scatter.chunks);
+	int t;
+	for (t = 0; t < nthreads; t++) {
+		size64 start = n * t / nthreads;
+		size64 end = n * (t + 1) / nthreads;
+		Chunk *chunk = &scatter.chunks[t];
+		chunk->keys = keys + start;
+		chunk->n = end - start;
+		chunk->partition = huge_malloc((sizeof *chunk->partition)
+			* (chunk->n > 0 ? chunk->n : 1));
+		assert(chunk->partition);
+		chunk->offsets = calloc(npartitions, sizeof *chunk->offsets);
+		assert(chunk->offsets);
+	}
+
+	// run one 'partition' per chunk for these passes
+	Partitions chunks = { .npartitions = nthreads, .nthreads = nthreads };
+	for_each_partition(&chunks, count_chunk, &scatter);
+
+	// SECOND,
+	// turn the counts into offsets: partition p starts after every key in
+	// partitions before it, and chunk t's keys for partition p go after those
+	// from earlier chunks
+	int p;
+	size64 offset = 0;
+	for (p = 0; p < npartitions; p++) {
+		partitions->starts[p] = offset;
+		for (t = 0; t < nthreads; t++) {
+			size64 count = scatter.chunks[t].offsets[p];
+			scatter.chunks[t].offsets[p] = offset;
+			offset += count;
+		}
+		partitions->counts[p] = offset - partitions->starts[p];
+	}
+
+	// THIRD,
+	// copy every key to its place in its partition
+	for_each_partition(&chunks, scatter_chunk, &scatter);
+
+	for (t = 0; t < nthreads; t++) {
+		free(scatter.chunks[t].partition);
+		free(scatter.chunks[t].offsets);
+	}
+	free(scatter.chunks);
+
+	// FINALLY,
+	// duplicate keys are now in the same partition, so each partition can be
+	// deduplicated independently
+	for_each_partition(partitions, deduplicate, NULL);
+
+	return partitions;
+}
+
+
+// free all memory associated with 'partitions'
+void free_partitions(Partitions *partitions) {
+	assert(partitions);
+
+	free(partitions->keys);
+	free(partitions->starts);
+	free(partitions->counts);
+	free(partitions);
+}
+
+
+// call 'task' (with 'arg') once for every partition in 'partitions', spreading
+// the partitions over partitions->nthreads threads
+void for_each_partition(Partitions *partitions, PartitionTask task, void *arg) {
+	assert(partitions);
+
+	Job job = { .partitions = partitions, .task = task, .arg = arg, .next = 0 };
+
+	// no point starting more threads than there are partitions
+	int nthreads = partitions->nthreads;
+	if (nthreads > partitions->npartitions) {
+		nthreads = partitions->npartitions;
+	}
+
+	// this thread does its share of the work too
+	pthread_t *threads = malloc((sizeof *threads) * nthreads);
+	assert(threads);
+	int t;
+	for (t = 1; t < nthreads; t++) {
+		int error = pthread_create(&threads[t], NULL, work, &job);
+		assert(error == 0 && "error: couldn't start a thread!");
+	}
+	work(&job);
+	for (t = 1; t < nthreads; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	free(threads);
+}
+
+
+// count how many keys are left in 'partitions'
+size64 count_keys(Partitions *partitions) {
+	assert(partitions);
+
+	size64 total = 0;
+	int p;
+	for (p = 0; p < partitions->npartitions; p++) {
+		total += partitions->counts[p];
+	}
+	return total;
+}
+
+
+// gather up the keys still left in 'partitions' into a new array, storing how
+// many there are in *n
+int64 *remaining_keys(Partitions *partitions, size64 *n) {
+	assert(partitions);
+
+	size64 total = count_keys(partitions);
+	int p;
+
+	int64 *keys = malloc((sizeof *keys) * (total > 0 ? total : 1));
+	assert(keys);
+	size64 offset = 0;
+	for (p = 0; p < partitions->npartitions; p++) {
+		memcpy(keys + offset, partitions->keys + partitions->starts[p],
+			(sizeof *keys) * partitions->counts[p]);
+		offset += partitions->counts[p];
+	}
+
+	*n = total;
+	return keys;
+}
+
+
+// the smallest number of bits d such that 2^d is at least 'n'
+int ceil_log2(size64 n) {
+	int d = 0;
+	while (((size64) 1 << d) < n) {
+		d++;
+	}
+	return d;
+}
+
+
+// the smallest number of bits d, from 'min_depth' up to at most 'max_depth',
+// such that spreading 'nkeys' random hash values over 2^d addresses is
+// unlikely (odds under 1 in 16) to put more than 'bucketsize' of them at any
+// one address
+int overflow_depth(size64 nkeys, int bucketsize, int min_depth,
+	int max_depth) {
+	int d;
+	for (d = min_depth; d < max_depth; d++) {
+		// the number of keys at each address is about Poisson distributed
+		// with mean 'keys', and the chance of more than 'bucketsize' is at
+		// most keys^(bucketsize+1) / (bucketsize+1)!, so this bounds how many
+		// addresses we expect to overflow
+		double addresses = (double) ((size64) 1 << d);
+		double keys = nkeys / addresses, expected = addresses;
+		int j;
+		for (j = 1; j <= bucketsize + 1; j++) {
+			expected *= keys / j;
+		}
+		if (expected < 1.0 / 16) {
+			break;
+		}
+	}
+	return d;
+}
@@ -0,0 +1,71 @@
+/* * * * * * * * *
+ * Helpers for building tables from large arrays of keys in parallel:
+ * deduplicating and radix-partitioning the keys by hash value, and running
+ * one task per partition across a number of threads
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef BULK_H
+#define BULK_H
+
+#include "../inthash.h"
+
+// how many partitions to split the keys into for each thread, so that threads
+// finishing early can pick up more work
+#define PARTITIONS_PER_THREAD 8
+
+// a set of distinct keys, grouped into partitions. partition p's keys are
+// keys[starts[p]] to keys[starts[p] + counts[p] - 1]
+typedef struct partitions {
+	int64 *keys;		// all of the keys, grouped by partition
+	size64 *starts;		// where each partition starts in 'keys'
+	size64 *counts;		// how many keys are in each partition
+	int npartitions;	// how many partitions there are
+	int nthreads;		// how many threads to use when processing them
+} Partitions;
+
+// function deciding which partition (from 0 to npartitions-1) each of the 'n'
+// keys in 'keys' belongs to, storing them in 'partition'. 'n' is never more
+// than HASH_BATCH, so that the keys can be hashed together
+typedef void (*PartitionFunction)(const int64 *keys, int *partition, int n,
+	void *arg);
+
+// function performing some task on partition 'p' (while other threads may be
+// working on other partitions at the same time)
+typedef void (*PartitionTask)(Partitions *partitions, int p, void *arg);
+
+// split the 'n' keys in 'keys' into 'npartitions' partitions according to
+// 'partition_of' (called with 'arg'), dropping any duplicates, using
+// 'nthreads' threads. 'keys' itself is left untouched
+Partitions *partition_keys(int64 *keys, size64 n, int npartitions,
+	PartitionFunction partition_of, void *arg, int nthreads);
+
+// free all memory associated with 'partitions'
+void free_partitions(Partitions *partitions);
+
+// call 'task' (with 'arg') once for every partition in 'partitions', spreading
+// the partitions over partitions->nthreads threads
+void for_each_partition(Partitions *partitions, PartitionTask task, void *arg);
+
+// count how many keys are left in 'partitions' (tasks may shrink a partition
+// by keeping only the keys they couldn't deal with at its start, and reducing
+// its count)
+size64 count_keys(Partitions *partitions);
+
+// gather up the keys still left in 'partitions' into a new array, storing how
+// many there are in *n
+int64 *remaining_keys(Partitions *partitions, size64 *n);
+
+// the smallest number of bits d such that 2^d is at least 'n'
+int ceil_log2(size64 n);
+
+// the smallest number of bits d, from 'min_depth' up to at most 'max_depth',
+// such that spreading 'nkeys' random hash values over 2^d addresses is
+// unlikely (odds under 1 in 16) to put more than 'bucketsize' of them at any
+// one address
+int overflow_depth(size64 nkeys, int bucketsize, int min_depth,
+	int max_depth);
+
+#endif
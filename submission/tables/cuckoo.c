@@ -9,26 +9,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <time.h>
+#include <string.h>  // for memcpy
 
 #include "cuckoo.h"
+#include "bulk.h"
+#include "../hugemem.h"
+#include "../latency.h"
+
+// an insertion that cuckoos keys around for too long normally means the table
+// is getting full, so it's doubled. but if the table is less than a quarter
+// full, it means the keys are colliding far more than random hash values ever
+// would (by accident, or by design), and doubling won't help: the table is
+// rehashed with a new seed instead (as it is while it holds fewer keys than
+// room was reserved for, which it was sized to take). an insertion can only
+// do this MAX_RESEEDS times (and as many rehashes can be under way at once,
+// each interrupted by the next), after which it doubles the table anyway
+#define MAX_RESEEDS 4
 
 // an inner table represents one of the two internal tables for a cuckoo
-// hash table. it stores two parallel arrays: 'slots' for storing keys and
-// 'inuse' for marking which entries are occupied
+// hash table. it stores two parallel arrays: 'slots' for storing keys (each
+// right next to its value) and 'inuse' for marking which entries are occupied
 typedef struct inner_table {
-	int64 *slots;	// array of slots holding keys
+	Entry *slots;	// array of slots holding keys and their values
 	bool  *inuse;	// is this slot in use or not?
-	int load;		// number of keys in the table right now
+	size64 load;	// number of keys in the table right now
 } InnerTable;
 
 // a cuckoo hash table stores its keys in two inner tables
 struct cuckoo_table {
 	InnerTable *table1; // first table
 	InnerTable *table2; // second table
-	int size;			// size of the inner tables
-	int time;			// how much CPU time has been used to insert/lookup keys
-					    // in this table
+	size64 size;		// size of the inner tables
+	Hasher hasher;		// hash function giving each key an address in both
+	int nreseeds;		// how many times it has been given a new seed
+	int reseeding;		// how many rehashes with a new seed are under way
+	size64 reserved;	// how many keys room has been reserved for
+	Latency latency;	// how long operations on this table have been taking
+	Snapshot *snapshot;	// snapshot the arrays were loaded from (or NULL)
 };
 
 
@@ -36,128 +53,169 @@ struct cuckoo_table {
  * helper functions
  */
 
- // free all memory associated with 'inner_table'
-static void free_inner_table(InnerTable *inner_table) {
+ // free all memory associated with 'inner_table' (except for any arrays
+ // living inside 'snapshot')
+static void free_inner_table(InnerTable *inner_table, Snapshot *snapshot) {
 	assert(inner_table);
 
-	free(inner_table->slots);
-	free(inner_table->inuse);
+	snapshot_release(snapshot, inner_table->slots);
+	snapshot_release(snapshot, inner_table->inuse);
 	free(inner_table);
 }
 
 
 // init a new inner_table of size n
-static InnerTable *new_inner_table(int size) {
+static InnerTable *new_inner_table(size64 size) {
 	// init new InnerTable
-	InnerTable *inner_table = malloc((sizeof *inner_table) * size);
+	InnerTable *inner_table = malloc(sizeof *inner_table);
 	assert(inner_table);
 	inner_table->load = 0;
 
 	// init inuse and slots. calloc inuse to set everything to 0 initially.
-	inner_table->slots = malloc((sizeof *inner_table->slots) * size);
+	inner_table->slots = huge_malloc((sizeof *inner_table->slots) * size);
 	assert(inner_table->slots);
-	inner_table->inuse = calloc(sizeof *inner_table->inuse, size);
+	inner_table->inuse = huge_calloc(size, sizeof *inner_table->inuse);
 	assert(inner_table->inuse);
 
 	return inner_table;
 }
 
 
-// double the size of inner tables within table, and reinsert everything
-static void double_table(CuckooHashTable *table) {
+static void insert_hashed(CuckooHashTable *table, Entry entry, int64 hash);
+
+// change the size of inner tables within table to 'size', and reinsert
+// everything. 'rehash' says whether the table has changed hash function since
+// the keys were inserted (otherwise any hash values cached in the entries can
+// be reused)
+static void resize_table(CuckooHashTable *table, size64 size, bool rehash) {
 	assert(table);
 
 	// save pointer of old inner tables and old size
 	InnerTable *old_table1 = table->table1;
 	InnerTable *old_table2 = table->table2;
-	int old_size = table->size;
+	size64 old_size = table->size;
+
+	LatencyTimer timer;
+	latency_begin_always(&timer);
 
 	// update table size
-	table->size = (table->size) * 2;
+	table->size = size;
 	assert(table->size <= MAX_TABLE_SIZE);
 
 	// replace inner tables
 	table->table1 = new_inner_table(table->size);
 	table->table2 = new_inner_table(table->size);
 
-	int i;
-	// reinsert everything into the table
-	for (i = 0; i < old_size; i++) {
-		if (old_table1->inuse[i]) {
-			cuckoo_hash_table_insert(table, old_table1->slots[i]);
+	// reinsert everything into the table, a batch of entries at a time so
+	// that their keys can be hashed together
+	Entry batch[HASH_BATCH];
+	int64 hashes[HASH_BATCH];
+	int nreseeds = table->nreseeds;
+	size64 i = 0;
+	while (i < old_size) {
+		int n = 0;
+		for (; i < old_size && n + 2 <= HASH_BATCH; i++) {
+			if (old_table1->inuse[i]) {
+				batch[n++] = old_table1->slots[i];
+			}
+			if (old_table2->inuse[i]) {
+				batch[n++] = old_table2->slots[i];
+			}
 		}
-		if (old_table2->inuse[i]) {
-			cuckoo_hash_table_insert(table, old_table2->slots[i]);
+		if (rehash) {
+			hasher_rehash_entries(&table->hasher, batch, n);
+		}
+		hasher_hash_entries(&table->hasher, batch, hashes, n);
+
+		int j;
+		for (j = 0; j < n; j++) {
+			insert_hashed(table, batch[j], hashes[j]);
+
+			// if that insertion gave the table a new hash function, the
+			// rest of this batch's hashes are out of date, and so are the
+			// hashes cached in every later batch
+			if (table->nreseeds != nreseeds) {
+				nreseeds = table->nreseeds;
+				rehash = true;
+				hasher_rehash_entries(&table->hasher, batch + j + 1,
+					n - j - 1);
+				hasher_hash_entries(&table->hasher, batch + j + 1,
+					hashes + j + 1, n - j - 1);
+			}
 		}
 	}
-	free_inner_table(old_table1);
-	free_inner_table(old_table2);
-}
-
-
-/* * * *
- * all functions
- */
-
-// initialise a cuckoo hash table with 'size' slots in each table
-CuckooHashTable *new_cuckoo_hash_table(int size) {
-	// create new table
-	CuckooHashTable *table = malloc(sizeof(*table));
-	assert(table);
-
-	// record size we're making tables
-	table->size = size;
-
-	// create the two inner tables
-	table->table1 = new_inner_table(size);
-	table->table2 = new_inner_table(size);
-
-	table->time = 0;
+	free_inner_table(old_table1, table->snapshot);
+	free_inner_table(old_table2, table->snapshot);
 
-	return table;
+	latency_end(&table->latency, &timer, OP_RESIZE);
 }
 
+// double the size of inner tables within table, and reinsert everything
+static void double_table(CuckooHashTable *table) {
+	resize_table(table, table->size * 2, false);
+}
 
-// free all memory associated with 'table'
-void free_cuckoo_hash_table(CuckooHashTable *table) {
-	assert(table);
+// give 'table' a new hash function and reinsert everything with it, after an
+// insertion found the keys colliding pathologically
+static void reseed_table(CuckooHashTable *table) {
+	Hasher old = table->hasher;
+	hasher_init_next(&table->hasher, &old);
+	hasher_free(&old);
+
+	table->nreseeds++;
+	table->reseeding++;
+	resize_table(table, table->size, true);
+	table->reseeding--;
+}
 
-	free_inner_table(table->table1);
-	free_inner_table(table->table2);
-	free(table);
+// are the keys in 'table' colliding so much that it should get a new hash
+// function, rather than grow? (it's under a quarter full, or holds fewer keys
+// than room was reserved for)
+static bool colliding(CuckooHashTable *table) {
+	size64 load = table->table1->load + table->table2->load;
+	return (load * 2 < table->size || load < table->reserved)
+		&& table->reseeding < MAX_RESEEDS;
 }
 
 
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
+// cuckoo 'entry' (whose key's hash value is 'hash') into 'table', assuming its
+// key is not in there already, doubling the table whenever we've been
+// cuckoo'ing for too long
+static void insert_hashed(CuckooHashTable *table, Entry entry, int64 hash) {
 	assert(table);
-	int start_time = clock();  // start timing
-	int h;
-	int64 next_key;
+	size64 h;
+	Entry next_entry;
 	InnerTable* cur_table;
 
-	// if key already in table return false
-	if (cuckoo_hash_table_lookup(table, key) == true) {
-		table->time += clock() - start_time;  // add time elapsed
-		return false;
-	}
-
 	// count steps so we know when need to increase table size
-	int steps = 0;
-	int max_steps = (table->size) / 2;
+	size64 steps = 0;
+	size64 max_steps = (table->size) / 2;
 
 	// keep track of which table we're inserting into
 	int cur_table_num = 1;
 
+	// and how many times we've changed hash function along the way
+	int nreseeds = 0;
+
 	// keep going until we mark that we don't have anymore keys to insert
 	bool key_to_insert=true;
 	while (key_to_insert) {
-		// if been cuckoo'ing too long need to double the size, then keep going
+		// if been cuckoo'ing too long need to double the size (or, if the
+		// table is nearly empty, change hash function), then keep going
 		if (steps >= max_steps) {
-			// double table size and rehash everything
-			double_table(table);
+			// double table size (or change seed) and rehash everything
+			if (nreseeds < MAX_RESEEDS && colliding(table)) {
+				reseed_table(table);
+				nreseeds++;
+				steps = 0;
+			} else {
+				double_table(table);
+			}
 			max_steps = (table->size) / 2;
+
+			// (either way, the table may have a new hash function now: a
+			// doubling can reseed, too)
+			hash = hasher_hash(&table->hasher, entry.key);
 		}
 
 		// get vals from table 1 or 2 depending on which one we are inserting
@@ -165,18 +223,18 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 		if (cur_table_num == 1) {
 			cur_table = table->table1;
 			// get hash of our key for table 1
-			h = h1(key) % table->size;
+			h = HASH_FIRST(hash) % table->size;
 		} else {
 			cur_table = table->table2;
 			// get hash of our key for table 2
-			h = h2(key) % table->size;
+			h = HASH_SECOND(hash) % table->size;
 		}
 
-		// if destination slot is occupied need save it's val before moving on
-		// so we can rehash it. else prepare loop to break and cur_table to
+		// if destination slot is occupied need save it's entry before moving
+		// on so we can rehash it. else prepare loop to break and cur_table to
 		// get the empty slot occupied
 		if (cur_table->inuse[h]) {
-			next_key = cur_table->slots[h];
+			next_entry = cur_table->slots[h];
 		} else {
 			cur_table->inuse[h] = true;
 			cur_table->load += 1;
@@ -184,11 +242,15 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 			key_to_insert = false;
 		}
 
-		// insert key into it's desired slot
-		cur_table->slots[h] = key;
+		// insert entry into it's desired slot
+		entry_set_hash(&entry, hash);
+		cur_table->slots[h] = entry;
 
-		// set key to next key (if any)
-		key = next_key;
+		// set entry to next entry (if any)
+		if (key_to_insert) {
+			entry = next_entry;
+			hash = entry_hash(&table->hasher, &entry);
+		}
 
 		// alternate between inserting into table 1 and 2
 		cur_table_num = (cur_table_num == 1) ? 2: 1;
@@ -196,8 +258,226 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 		// increment step counter
 		steps += 1;
 	}
+}
+
+// cuckoo 'entry' into 'table', assuming its key is not in there already
+static void insert_entry(CuckooHashTable *table, Entry entry) {
+	insert_hashed(table, entry, hasher_hash(&table->hasher, entry.key));
+}
+
+
+// state shared between the threads bulk loading one of the inner tables: its
+// slots are split into 'npartitions' contiguous ranges, one per partition
+typedef struct bulk_load {
+	CuckooHashTable *table;
+	int table_num;		// which inner table we're filling
+	int npartitions;
+} BulkLoad;
+
+// which partition each of the 'n' keys in 'keys' belongs to while bulk
+// loading: the one containing its address in the inner table being filled
+static void key_partition(const int64 *keys, int *partition, int n,
+	void *arg) {
+	BulkLoad *bulk = arg;
+	int64 hashes[HASH_BATCH];
+	hasher_hash_batch(&bulk->table->hasher, keys, hashes, n);
+
+	int i;
+	for (i = 0; i < n; i++) {
+		int64 hash = hashes[i];
+		int64 h = (bulk->table_num == 1) ? HASH_FIRST(hash) : HASH_SECOND(hash);
+		h %= bulk->table->size;
+		partition[i] = (size64) h * bulk->npartitions / bulk->table->size;
+	}
+}
+
+// task: place the keys in partition 'p' into their slots in the inner table
+// being filled. only this thread writes to the partition's range of slots, so
+// no locking is needed. keys whose slot is already taken are left in the
+// partition for later, rather than cuckoo'ing anything out
+static void fill_partition(Partitions *partitions, int p, void *arg) {
+	BulkLoad *bulk = arg;
+	CuckooHashTable *table = bulk->table;
+	InnerTable *inner_table =
+		(bulk->table_num == 1) ? table->table1 : table->table2;
+	int64 *keys = partitions->keys + partitions->starts[p];
+
+	int64 hashes[HASH_BATCH];
+	size64 i, left = 0;
+	for (i = 0; i < partitions->counts[p]; i++) {
+		// hash the keys a batch at a time
+		if (i % HASH_BATCH == 0) {
+			size64 n = partitions->counts[p] - i;
+			hasher_hash_batch(&table->hasher, keys + i, hashes,
+				(n < HASH_BATCH) ? n : HASH_BATCH);
+		}
+
+		int64 hash = hashes[i % HASH_BATCH];
+		int64 h = (bulk->table_num == 1) ? HASH_FIRST(hash) : HASH_SECOND(hash);
+		h %= table->size;
+		if (!inner_table->inuse[h]) {
+			inner_table->slots[h].key = keys[i];
+			inner_table->slots[h].value = 0;
+			entry_set_hash(&inner_table->slots[h], hash);
+			inner_table->inuse[h] = true;
+		} else {
+			keys[left++] = keys[i];
+		}
+	}
+	partitions->counts[p] = left;
+}
+
+
+// find the value stored with 'key' inside 'table' (without timing it)
+// returns a pointer to the value, or NULL if 'key' is not in the table
+static int64 *find_value(CuckooHashTable *table, int64 key) {
+	// calculate the address for this key in table 1 (and table 2, at once)
+	int64 hash = hasher_hash(&table->hasher, key);
+	size64 h = HASH_FIRST(hash) % table->size;
+
+	// check if key in table 1
+	if (table->table1->inuse[h] && table->table1->slots[h].key == key) {
+		return &table->table1->slots[h].value;
+	}
+
+	// calculate the address for this key in table 2
+	h = HASH_SECOND(hash) % table->size;
+
+	// check if key in table 2
+	if (table->table2->inuse[h] && table->table2->slots[h].key == key) {
+		return &table->table2->slots[h].value;
+	}
+
+	// key is in neither of the tables
+	return NULL;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a cuckoo hash table with 'size' slots in each table
+CuckooHashTable *new_cuckoo_hash_table(size64 size) {
+	// create new table
+	CuckooHashTable *table = malloc(sizeof(*table));
+	assert(table);
+
+	// record size we're making tables
+	table->size = size;
+
+	// create the two inner tables
+	table->table1 = new_inner_table(size);
+	table->table2 = new_inner_table(size);
+
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	table->reserved = 0;
+	latency_init(&table->latency);
+	table->snapshot = NULL;
+
+	return table;
+}
 
-	table->time += clock() - start_time;  // add time elapsed
+
+
+// build a new table containing the 'n' keys in 'keys' (which may contain
+// duplicates), sized up front to hold them all without growing, and filled
+// in parallel by 'nthreads' threads
+CuckooHashTable *cuckoo_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads) {
+	// make each inner table big enough to hold every key by itself, so the
+	// table as a whole is at most half full
+	CuckooHashTable *table = new_cuckoo_hash_table(n > 0 ? n : 1);
+
+	BulkLoad bulk = { .table = table,
+		.npartitions = nthreads * PARTITIONS_PER_THREAD };
+	if (bulk.npartitions > table->size) {
+		bulk.npartitions = table->size;
+	}
+
+	// fill table 1 in parallel, then table 2 with the keys that didn't fit
+	size64 nleft = n;
+	int64 *left = keys;
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	int t;
+	for (t = 0; t < 2; t++) {
+		bulk.table_num = t + 1;
+		Partitions *partitions = partition_keys(left, nleft, bulk.npartitions,
+			key_partition, &bulk, nthreads);
+		size64 nkeys = count_keys(partitions);
+		for_each_partition(partitions, fill_partition, &bulk);
+		innertables[t]->load = nkeys - count_keys(partitions);
+
+		if (left != keys) {
+			free(left);
+		}
+		left = remaining_keys(partitions, &nleft);
+		free_partitions(partitions);
+	}
+
+	// the few keys that collided in both tables get cuckoo'd in normally
+	size64 i;
+	for (i = 0; i < nleft; i++) {
+		Entry entry = { .key = left[i], .value = 0 };
+		insert_entry(table, entry);
+	}
+	free(left);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_cuckoo_hash_table(CuckooHashTable *table) {
+	assert(table);
+
+	free_inner_table(table->table1, table->snapshot);
+	free_inner_table(table->table2, table->snapshot);
+	hasher_free(&table->hasher);
+	latency_free(&table->latency);
+	free(table);
+}
+
+
+// make room in 'table' for 'nkeys' keys in total, without growing as they're
+// inserted
+void cuckoo_hash_table_reserve(CuckooHashTable *table, size64 nkeys) {
+	assert(table);
+
+	// give each inner table a slot and a quarter for every key, so the table
+	// as a whole is at most 40% full: right at half full, cuckoo cycles turn
+	// up often enough to force a doubling before the last keys go in. any
+	// cycle that still turns up before then gets a new seed, not a doubling
+	size64 size = nkeys + (nkeys + 3) / 4;
+	if (size > table->size) {
+		resize_table(table, size, false);
+	}
+	if (nkeys > table->reserved) {
+		table->reserved = nkeys;
+	}
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
+	assert(table);
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	// if key already in table return false
+	if (find_value(table, key) != NULL) {
+		latency_end(&table->latency, &timer, OP_INSERT);
+		return false;
+	}
+
+	// otherwise cuckoo it in with an empty value
+	Entry entry = { .key = key, .value = 0 };
+	insert_entry(table, entry);
+
+	latency_end(&table->latency, &timer, OP_INSERT);
 	return true;
 }
 
@@ -205,32 +485,162 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key) {
+	return cuckoo_hash_table_get(table, key) != NULL;
+}
+
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key, int64 value) {
 	assert(table);
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	// if key already in table just replace its value
+	int64 *stored = find_value(table, key);
+	if (stored != NULL) {
+		*stored = value;
+		latency_end(&table->latency, &timer, OP_INSERT);
+		return false;
+	}
+
+	Entry entry = { .key = key, .value = value };
+	insert_entry(table, entry);
 
-	int start_time = clock(); // start timing
-	int h;
+	latency_end(&table->latency, &timer, OP_INSERT);
+	return true;
+}
 
-	// calculate the address for this key in table 1
-	h = h1(key) % table->size;
 
-	// check if key in table 1
-	if (table->table1->inuse[h] && table->table1->slots[h] == key) {
-		table->time += clock() - start_time;
-		return true;
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *cuckoo_hash_table_get(CuckooHashTable *table, int64 key) {
+	assert(table);
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	int64 *value = find_value(table, key);
+
+	latency_end(&table->latency, &timer, value ? OP_HIT : OP_MISS);
+	return value;
+}
+
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *cuckoo_hash_table_iter_next(CuckooHashTable *table, Cursor *cursor) {
+	assert(table);
+	assert(cursor);
+
+	// walk through table 1's slots, then table 2's, skipping unused ones
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	while (cursor->table < 2) {
+		InnerTable *inner_table = innertables[cursor->table];
+		while (cursor->address < table->size) {
+			size64 h = cursor->address++;
+			if (inner_table->inuse[h]) {
+				return &inner_table->slots[h];
+			}
+		}
+
+		// move on to the start of the next table
+		cursor->table++;
+		cursor->address = 0;
 	}
 
-	// calculate the address for this key in table 2
-	h = h2(key) % table->size;
+	// no more slots left
+	return NULL;
+}
 
-	// check if key in table 2
-	if (table->table2->inuse[h] && table->table2->slots[h] == key) {
-		table->time += clock() - start_time;
-		return true;
+
+// write the contents of 'table' to 'file', in a layout that
+// cuckoo_hash_table_load() can use in place
+void cuckoo_hash_table_save(CuckooHashTable *table, FILE *file) {
+	assert(table);
+	assert(file);
+
+	// the sizes and hash function first, then each inner table's arrays
+	// exactly as they are
+	size64 sizes[3] = {table->size, table->table1->load, table->table2->load};
+	snapshot_write(file, sizes, sizeof sizes);
+	snapshot_write_hasher(file, &table->hasher);
+
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	int t;
+	for (t = 0; t < 2; t++) {
+		InnerTable *inner_table = innertables[t];
+		snapshot_write(file, inner_table->slots,
+			(sizeof *inner_table->slots) * table->size);
+		snapshot_write(file, inner_table->inuse,
+			(sizeof *inner_table->inuse) * table->size);
 	}
+}
 
-	// key is in neither of the tables
-	table->time += clock() - start_time;
-	return false;
+
+// create a table from the next part of 'snapshot' (as written by
+// cuckoo_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+CuckooHashTable *cuckoo_hash_table_load(Snapshot *snapshot) {
+	assert(snapshot);
+
+	size64 *sizes = snapshot_read(snapshot, 3 * sizeof *sizes);
+	if (sizes == NULL) {
+		return NULL;
+	}
+	size64 size = sizes[0];
+	if (size <= 0 || sizes[1] < 0 || sizes[1] > size
+		|| sizes[2] < 0 || sizes[2] > size) {
+		return snapshot_fail(snapshot, "corrupt table sizes");
+	}
+
+	Hasher hasher;
+	if (!snapshot_read_hasher(snapshot, &hasher)) {
+		return NULL;
+	}
+
+	// find each inner table's arrays inside the snapshot
+	Entry *slots[2];
+	bool *inuse[2];
+	int t;
+	for (t = 0; t < 2; t++) {
+		slots[t] = snapshot_read_array(snapshot, size, sizeof *slots[t]);
+		inuse[t] = snapshot_read_flags(snapshot, size);
+	}
+	if (inuse[1] == NULL) {
+		// (reads after a failed one fail too, so this one failing covers them)
+		hasher_free(&hasher);
+		return NULL;
+	}
+
+	CuckooHashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->size = size;
+	table->hasher = hasher;
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	table->reserved = 0;
+	latency_init(&table->latency);
+
+	// point each inner table straight at its arrays
+	InnerTable *innertables[2];
+	for (t = 0; t < 2; t++) {
+		InnerTable *inner_table = malloc(sizeof *inner_table);
+		assert(inner_table);
+		inner_table->load = sizes[1 + t];
+		inner_table->slots = slots[t];
+		inner_table->inuse = inuse[t];
+		innertables[t] = inner_table;
+	}
+	table->table1 = innertables[0];
+	table->table2 = innertables[1];
+	table->snapshot = snapshot;
+
+	return table;
 }
 
 
@@ -238,29 +648,29 @@ bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key) {
 void cuckoo_hash_table_print(CuckooHashTable *table) {
 	assert(table);
 
-	printf("--- table size: %d\n", table->size);
+	printf("--- table size: %lld\n", (long long) table->size);
 
 	// print header
 	printf("                    table one         table two\n");
 	printf("                  key | address     address | key\n");
 
 	// print rows of each table
-	int i;
+	size64 i;
 	for (i = 0; i < table->size; i++) {
 
 		// table 1 key
 		if (table->table1->inuse[i]) {
-			printf(" %20llu ", table->table1->slots[i]);
+			printf(" %20llu ", table->table1->slots[i].key);
 		} else {
 			printf(" %20s ", "-");
 		}
 
 		// addresses
-		printf("| %-9d %9d |", i, i);
+		printf("| %-9lld %9lld |", (long long) i, (long long) i);
 
 		// table 2 key
 		if (table->table2->inuse[i]) {
-			printf(" %llu\n", table->table2->slots[i]);
+			printf(" %llu\n", table->table2->slots[i].key);
 		} else {
 			printf(" %s\n",  "-");
 		}
@@ -271,6 +681,40 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 }
 
 
+// how full 'table' is: the fraction of its key slots currently holding a key
+double cuckoo_hash_table_load_factor(CuckooHashTable *table) {
+	assert(table);
+
+	size64 nkeys = table->table1->load + table->table2->load;
+	return (double) nkeys / (2 * table->size);
+}
+
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage cuckoo_hash_table_memory_usage(CuckooHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = { 0 };
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	int i;
+	for (i = 0; i < 2; i++) {
+		InnerTable *inner_table = innertables[i];
+		memory_count(&usage, &usage.overhead, inner_table, sizeof *inner_table,
+			NULL);
+		memory_count(&usage, &usage.slots, inner_table->slots,
+			(sizeof *inner_table->slots) * table->size, table->snapshot);
+		memory_count(&usage, &usage.inuse, inner_table->inuse,
+			(sizeof *inner_table->inuse) * table->size, table->snapshot);
+	}
+	memory_count_hasher(&usage, &table->hasher);
+	latency_memory_usage(&table->latency, &usage);
+	return usage;
+}
+
+
 // print some statistics about 'table' to stdout
 void cuckoo_hash_table_stats(CuckooHashTable *table) {
 	assert(table);
@@ -285,17 +729,26 @@ void cuckoo_hash_table_stats(CuckooHashTable *table) {
 	printf("--- table stats ---\n");
 
 	// print some information about the table
-	printf("current size of both tables: %d slots\n", table->size);
+	printf("current size of both tables: %lld slots\n",
+		(long long) table->size);
+	printf("rehashed with a new seed: %d times\n", table->nreseeds);
 	printf("table 1:\n");
-	printf("    current load: %d items\n", table1->load);
+	printf("    current load: %lld items\n", (long long) table1->load);
 	printf("    load factor: %.3f%%\n", t1_load_factor);
 	printf("table 2:\n");
-	printf("    current load: %d items\n", table2->load);
+	printf("    current load: %lld items\n", (long long) table2->load);
 	printf("    load factor: %.3f%%\n", t2_load_factor);
 
-	// also calculate CPU usage in seconds and print this
-	float seconds = table->time * 1.0 / CLOCKS_PER_SEC;
-	printf("CPU time spent: %.6f sec\n", seconds);
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_total(cuckoo_hash_table_memory_usage(table));
+	size64 nkeys = table1->load + table2->load;
+	printf("memory used: %zu bytes\n", bytes);
+	if (nkeys > 0) {
+		printf("    per entry: %.2f bytes\n", bytes * 1.0 / nkeys);
+	}
+
+	// and how long operations have been taking
+	latency_print(&table->latency);
 
 	printf("--- end stats ---\n");
 }
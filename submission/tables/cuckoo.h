@@ -10,16 +10,31 @@
 #define CUCKOO_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "../inthash.h"
+#include "../snapshot.h"
+#include "../memusage.h"
 
 typedef struct cuckoo_table CuckooHashTable;
 
 // initialise a cuckoo hash table with 'size' slots in each table
-CuckooHashTable *new_cuckoo_hash_table(int size);
+CuckooHashTable *new_cuckoo_hash_table(size64 size);
+
+// build a new table containing the 'n' keys in 'keys' (which may contain
+// duplicates), sized up front to hold them all without growing, and filled
+// in parallel by 'nthreads' threads
+CuckooHashTable *cuckoo_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads);
 
 // free all memory associated with 'table'
 void free_cuckoo_hash_table(CuckooHashTable *table);
 
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), so that inserting that many keys does no doubling (a key cuckoo'd
+// around for too long before then gets the table a new seed instead). never
+// shrinks the table
+void cuckoo_hash_table_reserve(CuckooHashTable *table, size64 nkeys);
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key);
@@ -28,6 +43,39 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key);
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key);
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key, int64 value);
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *cuckoo_hash_table_get(CuckooHashTable *table, int64 key);
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *cuckoo_hash_table_iter_next(CuckooHashTable *table, Cursor *cursor);
+
+// write the contents of 'table' to 'file', in a layout that
+// cuckoo_hash_table_load() can use in place
+void cuckoo_hash_table_save(CuckooHashTable *table, FILE *file);
+
+// create a table from the next part of 'snapshot' (as written by
+// cuckoo_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+CuckooHashTable *cuckoo_hash_table_load(Snapshot *snapshot);
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double cuckoo_hash_table_load_factor(CuckooHashTable *table);
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage cuckoo_hash_table_memory_usage(CuckooHashTable *table);
+
 // print the contents of 'table' to stdout
 void cuckoo_hash_table_print(CuckooHashTable *table);
 
@@ -11,39 +11,67 @@
 #include <string.h>  // for memset
 
 #include "linear.h"
+#include "bulk.h"
+#include "../hugemem.h"
+#include "../stats.h"
 
 // how many cells to advance at a time while looking for a free slot
 #define STEP_SIZE 1
 // how many slots we want to split our load factor into in our stats arrays
 // higher number means more specific stats output
 #define NUM_LOAD_FACTOR_SLOTS 50
-
-
-// helper structure to store statistics gathered
+// how many slots to make for each key when sizing a table up front (bulk
+// loading or reserving space), keeping the load factor low enough for short
+// probe sequences
+#define SLOTS_PER_KEY 2
+// an insertion into a table at most half full that has to probe more than
+// LONG_CHAIN(size) slots has met keys colliding far more than random hash
+// values ever would (by accident, or by design), so the table is rehashed
+// with a new seed. up to MAX_RESEEDS rehashes can be under way at once (each
+// interrupted by the next), after which keys are left where they fall
+#define LONG_CHAIN(size) (4 * ceil_log2(size) + 32)
+#define MAX_RESEEDS 4
+
+
+// helper structure to store statistics gathered (how many depends on the
+// statistics level this was built with: see stats.h)
 typedef struct stats {
+#if STATS_LEVEL >= STATS_FULL
 	// records what load the table was under when at least 1 collision occured
 	// during insersion. index 0: load factor 0-5%, index 1: load_factor
 	// 5-10%, ..., index 9: load_factor 95-100%
-	int ncolls_by_load[NUM_LOAD_FACTOR_SLOTS];
+	size64 ncolls_by_load[NUM_LOAD_FACTOR_SLOTS];
 	// records total probes made while inserting a key while table is under
 	// a certian load factor. indexes correspond to same load factors in
 	// 'ncolls_by_load'
-	int nprobes_by_load[NUM_LOAD_FACTOR_SLOTS];
+	int64 nprobes_by_load[NUM_LOAD_FACTOR_SLOTS];
 	// counts the number of times a key was inserted under particular load
 	// factor. array split the same way as 'ncolls_by_load'
-	int nkeys_by_load[NUM_LOAD_FACTOR_SLOTS];
+	size64 nkeys_by_load[NUM_LOAD_FACTOR_SLOTS];
+#elif STATS_LEVEL >= STATS_COUNTERS
+	size64 ncolls;	// how many keys collided at least once during insertion
+	int64 nprobes;	// how many probes inserting them all made
+	size64 nkeys;	// how many keys have been inserted
+#else
+	char unused;	// (C has no empty structs)
+#endif
 } Stats;
 
-// a hash table is an array of slots holding keys, along with a parallel array
-// of boolean markers recording which slots are in use (true) or free (false)
+// a hash table is an array of slots holding entries (each key stored right
+// next to its value), along with a parallel array of boolean markers recording
+// which slots are in use (true) or free (false)
 // important because not-in-use slots might hold garbage data, as they may
 // not have been initialised
 struct linear_table {
-	int64 *slots;	// array of slots holding keys
+	Entry *slots;	// array of slots holding keys and their values
 	bool  *inuse;	// is this slot in use or not?
-	int size;		// the size of both of these arrays right now
-	int load;		// number of keys in the table right now
+	size64 size;	// the size of both of these arrays right now
+	size64 load;	// number of keys in the table right now
 	Stats stats;	// collection of statistics about this hash table
+	Hasher hasher;	// this table's hash function
+	int nreseeds;	// how many times it has been given a new seed
+	int reseeding;	// how many rehashes with a new seed are under way
+	Snapshot *snapshot;	// snapshot the arrays were loaded from (or NULL)
 };
 
 
@@ -53,17 +81,13 @@ struct linear_table {
 
 // set up the internals of a linear hash table struct with new
 // arrays of size 'size'
-static void initialise_table(LinearHashTable *table, int size) {
+static void initialise_table(LinearHashTable *table, size64 size) {
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	table->slots = malloc((sizeof *table->slots) * size);
+	table->slots = huge_malloc((sizeof *table->slots) * size);
 	assert(table->slots);
-	table->inuse = malloc((sizeof *table->inuse) * size);
+	table->inuse = huge_calloc(size, sizeof *table->inuse);
 	assert(table->inuse);
-	int i;
-	for (i = 0; i < size; i++) {
-		table->inuse[i] = false;
-	}
 
 	table->size = size;
 
@@ -76,39 +100,89 @@ static void initialise_stats(LinearHashTable *table) {
 	assert(table);
 
 	// set everything to 0
-	int i;
-	for (i = 0; i < NUM_LOAD_FACTOR_SLOTS; i++) {
-		table->stats.nkeys_by_load[i] = 0;
-		table->stats.ncolls_by_load[i] = 0;
-		table->stats.nprobes_by_load[i] = 0;
-	}
+	memset(&table->stats, 0, sizeof table->stats);
 }
 
 
-// double the size of the internal table arrays and re-hash all
-// keys in the old tables
-static void double_table(LinearHashTable *table) {
+static bool insert_hashed(LinearHashTable *table, int64 key, int64 value,
+	int64 hash, bool replace);
+
+// change the size of the internal table arrays to 'size' and re-hash all
+// keys in the old tables. 'rehash' says whether the table has changed hash
+// function since the keys were inserted (otherwise any hash values cached in
+// the entries can be reused)
+static void resize_table(LinearHashTable *table, size64 size, bool rehash) {
 	assert(table);
 
-	int64 *oldslots = table->slots;
+	Entry *oldslots = table->slots;
 	bool  *oldinuse = table->inuse;
-	int oldsize = table->size;
+	size64 oldsize = table->size;
 
-	initialise_table(table, table->size * 2);
+	initialise_table(table, size);
 	initialise_stats(table);
 
-	int i;
-	for (i = 0; i < oldsize; i++) {
-		if (oldinuse[i] == true) {
-			linear_hash_table_insert(table, oldslots[i]);
+	// re-hash the keys a batch at a time, so they can be hashed together
+	Entry batch[HASH_BATCH];
+	int64 hashes[HASH_BATCH];
+	int nreseeds = table->nreseeds;
+	size64 i = 0;
+	while (i < oldsize) {
+		int n = 0;
+		for (; i < oldsize && n < HASH_BATCH; i++) {
+			if (oldinuse[i] == true) {
+				batch[n++] = oldslots[i];
+			}
+		}
+		if (rehash) {
+			hasher_rehash_entries(&table->hasher, batch, n);
+		}
+		hasher_hash_entries(&table->hasher, batch, hashes, n);
+
+		int j;
+		for (j = 0; j < n; j++) {
+			insert_hashed(table, batch[j].key, batch[j].value, hashes[j],
+				false);
+
+			// if that insertion gave the table a new hash function, the
+			// rest of this batch's hashes are out of date, and so are the
+			// hashes cached in every later batch
+			if (table->nreseeds != nreseeds) {
+				nreseeds = table->nreseeds;
+				rehash = true;
+				hasher_rehash_entries(&table->hasher, batch + j + 1,
+					n - j - 1);
+				hasher_hash_entries(&table->hasher, batch + j + 1,
+					hashes + j + 1, n - j - 1);
+			}
 		}
 	}
 
-	free(oldslots);
-	free(oldinuse);
+	snapshot_release(table->snapshot, oldslots);
+	snapshot_release(table->snapshot, oldinuse);
+}
+
+// double the size of the internal table arrays and re-hash all
+// keys in the old tables
+static void double_table(LinearHashTable *table) {
+	resize_table(table, table->size * 2, false);
+}
+
+// give 'table' a new hash function and re-hash all keys with it, after an
+// insertion found them colliding pathologically
+static void reseed_table(LinearHashTable *table) {
+	Hasher old = table->hasher;
+	hasher_init_next(&table->hasher, &old);
+	hasher_free(&old);
+
+	table->nreseeds++;
+	table->reseeding++;
+	resize_table(table, table->size, true);
+	table->reseeding--;
 }
 
 
+#if STATS_LEVEL >= STATS_FULL
+
 // gets the index that corresponds to the slot in our stats array for the
 // load factor input
 static int get_stats_index(float load_factor) {
@@ -130,7 +204,7 @@ static int get_stats_index(float load_factor) {
 
 
 // updates the statistics of the table
-static void update_table_stats(LinearHashTable *table, int steps) {
+static void update_table_stats(LinearHashTable *table, size64 steps) {
 	assert(table);
 	bool collision=false;
 
@@ -153,12 +227,99 @@ static void update_table_stats(LinearHashTable *table, int steps) {
 	table->stats.nkeys_by_load[index]++;
 }
 
+#elif STATS_LEVEL >= STATS_COUNTERS
+
+// updates the statistics of the table
+static void update_table_stats(LinearHashTable *table, size64 steps) {
+	if (steps > 0) {
+		table->stats.ncolls++;
+	}
+	table->stats.nprobes += steps;
+	table->stats.nkeys++;
+}
+
+#endif
+
+
+// insert 'key' (whose hash value is 'hash') with 'value' into 'table' if it's
+// not in there already. if it is, replace the value stored with it only when
+// 'replace' is true
+// returns true if the key was newly inserted, false if it was already there
+static bool insert_hashed(LinearHashTable *table, int64 key, int64 value,
+	int64 hash, bool replace) {
+	assert(table);
+
+	// need to count our steps to make sure we recognise when the table is full
+	size64 steps = 0;
+
+	// calculate the initial address for this key
+	size64 h = HASH_FIRST(hash) % table->size;
+
+	// step along the array until we find a free space (inuse[]==false),
+	// or until we visit every cell
+	while (table->inuse[h] && steps < table->size) {
+		if (table->slots[h].key == key) {
+			// this key already exists in the table! no need to insert
+			if (replace) {
+				table->slots[h].value = value;
+			}
+			return false;
+		}
+
+		// else, keep stepping through the table looking for a free slot
+		h = (h + STEP_SIZE) % table->size;
+		steps++;
+	}
+
+	// if we used up all of our steps, then we're back where we started and the
+	// table is full
+	if (steps == table->size) {
+		// let's make some more space and then try to insert this key again!
+		// (hashing it afresh, as doubling may have reseeded the table)
+		double_table(table);
+		hash = hasher_hash(&table->hasher, key);
+		return insert_hashed(table, key, value, hash, replace);
+
+	} else {
+		// otherwise, we have found a free slot! insert this key right here
+		table->slots[h].key = key;
+		table->slots[h].value = value;
+		entry_set_hash(&table->slots[h], hash);
+		table->inuse[h] = true;
+		table->load++;
+#if STATS_LEVEL >= STATS_COUNTERS
+		// update table stats before returning
+		update_table_stats(table, steps);
+#endif
+
+		// a probe sequence that long, with so much free space, means the
+		// keys are colliding far too much: scatter them with a new seed
+		if (steps > LONG_CHAIN(table->size) && table->load * 2 <= table->size
+			&& table->reseeding < MAX_RESEEDS) {
+			reseed_table(table);
+		}
+		return true;
+	}
+}
+
+// insert 'key' with 'value' into 'table' if it's not in there already. if it
+// is, replace the value stored with it only when 'replace' is true
+// returns true if the key was newly inserted, false if it was already there
+static bool insert_entry(LinearHashTable *table, int64 key, int64 value,
+	bool replace) {
+	int64 hash = hasher_hash(&table->hasher, key);
+	return insert_hashed(table, key, value, hash, replace);
+}
+
+
+#if STATS_LEVEL >= STATS_FULL
 
 // print infomation about collisions
 static void print_collisions_stats(LinearHashTable *table) {
 	assert(table);
 
-	int i, lower_bound, upper_bound, colls_this_load, nkeys_this_load;
+	int i, lower_bound, upper_bound;
+	size64 colls_this_load, nkeys_this_load;
 	float percent;
 
 	// calculate the percent size of each slot in the stats arrays
@@ -178,8 +339,8 @@ static void print_collisions_stats(LinearHashTable *table) {
 		} else percent = 0.0;
 
 		// print collision count and chance
-		printf("    %d%% - %d%%: %d (%.2f%% chance)\n",
-			lower_bound, upper_bound, colls_this_load, percent);
+		printf("    %d%% - %d%%: %lld (%.2f%% chance)\n",
+			lower_bound, upper_bound, (long long) colls_this_load, percent);
 	}
 }
 
@@ -187,7 +348,9 @@ static void print_collisions_stats(LinearHashTable *table) {
 static void print_probe_stats(LinearHashTable *table) {
 	assert(table);
 
-	int i, lower_bound, upper_bound, probes_this_load, nkeys_this_load;
+	int i, lower_bound, upper_bound;
+	int64 probes_this_load;
+	size64 nkeys_this_load;
 	float avg_probe;
 
 	int percent_per_slot = 100 / NUM_LOAD_FACTOR_SLOTS;
@@ -214,13 +377,102 @@ static void print_probe_stats(LinearHashTable *table) {
 	printf("--- end stats ---\n");
 }
 
+#elif STATS_LEVEL >= STATS_COUNTERS
+
+// print information about collisions and probe sequence length, over every
+// insertion since the table last grew
+static void print_insert_stats(LinearHashTable *table) {
+	assert(table);
+
+	size64 nkeys = table->stats.nkeys;
+	printf("\nKeys inserted: %lld\n", (long long) nkeys);
+	if (nkeys > 0) {
+		printf("    with a collision: %lld (%.2f%%)\n",
+			(long long) table->stats.ncolls,
+			table->stats.ncolls * 100.0 / nkeys);
+		printf("    average probe sequence length: %.2f\n",
+			table->stats.nprobes * 1.0 / nkeys);
+	}
+
+	printf("--- end stats ---\n");
+}
+
+#endif
+
+
+// state shared between the threads bulk loading a table: the table's slots
+// are split into 'npartitions' contiguous ranges, one per partition of keys
+typedef struct bulk_load {
+	LinearHashTable *table;
+	int npartitions;
+} BulkLoad;
+
+// which partition the slot at address 'h' belongs to while bulk loading
+static int slot_partition(BulkLoad *bulk, size64 h) {
+	return h * bulk->npartitions / bulk->table->size;
+}
+
+// which partition each of the 'n' keys in 'keys' belongs to while bulk
+// loading: the one containing the first address it would probe
+static void key_partition(const int64 *keys, int *partition, int n,
+	void *arg) {
+	BulkLoad *bulk = arg;
+	LinearHashTable *table = bulk->table;
+	int64 hashes[HASH_BATCH];
+	hasher_hash_batch(&table->hasher, keys, hashes, n);
+
+	int i;
+	for (i = 0; i < n; i++) {
+		size64 h = HASH_FIRST(hashes[i]) % table->size;
+		partition[i] = slot_partition(bulk, h);
+	}
+}
+
+// task: place the keys in partition 'p' into the partition's own range of
+// slots. no other thread writes to these slots, so no locking is needed, but
+// keys which would have to probe past the end of the range are left in the
+// partition for later
+static void fill_partition(Partitions *partitions, int p, void *arg) {
+	BulkLoad *bulk = arg;
+	LinearHashTable *table = bulk->table;
+	int64 *keys = partitions->keys + partitions->starts[p];
+
+	int64 hashes[HASH_BATCH];
+	size64 i, left = 0;
+	for (i = 0; i < partitions->counts[p]; i++) {
+		// hash the keys a batch at a time
+		if (i % HASH_BATCH == 0) {
+			size64 n = partitions->counts[p] - i;
+			hasher_hash_batch(&table->hasher, keys + i, hashes,
+				(n < HASH_BATCH) ? n : HASH_BATCH);
+		}
+
+		// step along until we find a free slot, or leave our range
+		size64 h = HASH_FIRST(hashes[i % HASH_BATCH]) % table->size;
+		while (h < table->size && slot_partition(bulk, h) == p
+			&& table->inuse[h]) {
+			h += STEP_SIZE;
+		}
+
+		if (h < table->size && slot_partition(bulk, h) == p) {
+			table->slots[h].key = keys[i];
+			table->slots[h].value = 0;
+			entry_set_hash(&table->slots[h], hashes[i % HASH_BATCH]);
+			table->inuse[h] = true;
+		} else {
+			keys[left++] = keys[i];
+		}
+	}
+	partitions->counts[p] = left;
+}
+
 
 /* * * *
  * all functions
  */
 
 // initialise a linear probing hash table with initial size 'size'
-LinearHashTable *new_linear_hash_table(int size) {
+LinearHashTable *new_linear_hash_table(size64 size) {
 	LinearHashTable *table = malloc(sizeof *table);
 	assert(table);
 
@@ -229,6 +481,50 @@ LinearHashTable *new_linear_hash_table(int size) {
 	// set up the stats of the table
 	initialise_stats(table);
 
+	// hash with a member of the default family of its own
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->nreseeds = 0;
+	table->reseeding = 0;
+
+	table->snapshot = NULL;
+
+	return table;
+}
+
+
+
+// build a new table containing the 'n' keys in 'keys' (which may contain
+// duplicates), sized up front to hold them all without growing, and filled
+// in parallel by 'nthreads' threads
+LinearHashTable *linear_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads) {
+	size64 size = (n > 0) ? n * SLOTS_PER_KEY : 1;
+	LinearHashTable *table = new_linear_hash_table(size);
+
+	// split the keys up by which range of slots they start probing from
+	BulkLoad bulk = { .table = table,
+		.npartitions = nthreads * PARTITIONS_PER_THREAD };
+	if (bulk.npartitions > table->size) {
+		bulk.npartitions = table->size;
+	}
+	Partitions *partitions = partition_keys(keys, n, bulk.npartitions,
+		key_partition, &bulk, nthreads);
+	size64 ndistinct = count_keys(partitions);
+
+	// fill each range of slots in parallel
+	for_each_partition(partitions, fill_partition, &bulk);
+	table->load = ndistinct - count_keys(partitions);
+
+	// the few keys that spilled over the end of their range go in normally
+	size64 nleft;
+	int64 *left = remaining_keys(partitions, &nleft);
+	size64 i;
+	for (i = 0; i < nleft; i++) {
+		insert_entry(table, left[i], 0, false);
+	}
+	free(left);
+	free_partitions(partitions);
+
 	return table;
 }
 
@@ -237,76 +533,69 @@ LinearHashTable *new_linear_hash_table(int size) {
 void free_linear_hash_table(LinearHashTable *table) {
 	assert(table != NULL);
 
-	// free the table's arrays
-	free(table->slots);
-	free(table->inuse);
+	// free the table's arrays (unless they live inside a snapshot)
+	snapshot_release(table->snapshot, table->slots);
+	snapshot_release(table->snapshot, table->inuse);
+	hasher_free(&table->hasher);
 
 	// free the table struct itself
 	free(table);
 }
 
 
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
+// make room in 'table' for 'nkeys' keys in total, without growing as they're
+// inserted
+void linear_hash_table_reserve(LinearHashTable *table, size64 nkeys) {
 	assert(table);
 
-	// need to count our steps to make sure we recognise when the table is full
-	int steps = 0;
+	size64 size = nkeys * SLOTS_PER_KEY;
+	if (size > table->size) {
+		resize_table(table, size, false);
+	}
+}
 
-	// calculate the initial address for this key
-	int h = h1(key) % table->size;
 
-	// step along the array until we find a free space (inuse[]==false),
-	// or until we visit every cell
-	while (table->inuse[h] && steps < table->size) {
-		if (table->slots[h] == key) {
-			// this key already exists in the table! no need to insert
-			return false;
-		}
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
+	return insert_entry(table, key, 0, false);
+}
 
-		// else, keep stepping through the table looking for a free slot
-		h = (h + STEP_SIZE) % table->size;
-		steps++;
-	}
 
-	// if we used up all of our steps, then we're back where we started and the
-	// table is full
-	if (steps == table->size) {
-		// let's make some more space and then try to insert this key again!
-		double_table(table);
-		return linear_hash_table_insert(table, key);
-
-	} else {
-		// otherwise, we have found a free slot! insert this key right here
-		table->slots[h] = key;
-		table->inuse[h] = true;
-		table->load++;
-		// update table stats before returning
-		update_table_stats(table, steps);
-		return true;
-	}
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool linear_hash_table_put(LinearHashTable *table, int64 key, int64 value) {
+	return insert_entry(table, key, value, true);
 }
 
 
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
+	return linear_hash_table_get(table, key) != NULL;
+}
+
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *linear_hash_table_get(LinearHashTable *table, int64 key) {
 	assert(table);
 
 	// need to count our steps to make sure we recognise when the table is full
-	int steps = 0;
+	size64 steps = 0;
 
 	// calculate the initial address for this key
-	int h = h1(key) % table->size;
+	size64 h = HASH_FIRST(hasher_hash(&table->hasher, key)) % table->size;
 
 	// step along until we find a free space (inuse[]==false), or until we
 	// visit every cell
 	while (table->inuse[h] && steps < table->size) {
 
-		if (table->slots[h] == key) {
-			// found the key!
-			return true;
+		if (table->slots[h].key == key) {
+			// found the key! hand back the value sitting next to it
+			return &table->slots[h].value;
 		}
 
 		// keep stepping
@@ -316,7 +605,91 @@ bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
 
 	// we have either searched the whole table or come back to where we started
 	// either way, the key is not in the hash table
-	return false;
+	return NULL;
+}
+
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *linear_hash_table_iter_next(LinearHashTable *table, Cursor *cursor) {
+	assert(table);
+	assert(cursor);
+
+	// skip over slots which aren't in use
+	while (cursor->address < table->size) {
+		size64 h = cursor->address++;
+		if (table->inuse[h]) {
+			return &table->slots[h];
+		}
+	}
+
+	// no more slots left
+	return NULL;
+}
+
+
+// write the contents of 'table' to 'file', in a layout that
+// linear_hash_table_load() can use in place
+void linear_hash_table_save(LinearHashTable *table, FILE *file) {
+	assert(table);
+	assert(file);
+
+	// the sizes, statistics and hash function first, then the arrays exactly
+	// as they are
+	size64 sizes[2] = {table->size, table->load};
+	snapshot_write(file, sizes, sizeof sizes);
+	snapshot_write(file, &table->stats, sizeof table->stats);
+	snapshot_write_hasher(file, &table->hasher);
+	snapshot_write(file, table->slots, (sizeof *table->slots) * table->size);
+	snapshot_write(file, table->inuse, (sizeof *table->inuse) * table->size);
+}
+
+
+// create a table from the next part of 'snapshot' (as written by
+// linear_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+LinearHashTable *linear_hash_table_load(Snapshot *snapshot) {
+	assert(snapshot);
+
+	size64 *sizes = snapshot_read(snapshot, 2 * sizeof *sizes);
+	Stats *stats = snapshot_read(snapshot, sizeof *stats);
+	if (sizes == NULL || stats == NULL) {
+		return NULL;
+	}
+	size64 size = sizes[0], load = sizes[1];
+	if (size <= 0 || load < 0 || load > size) {
+		return snapshot_fail(snapshot, "corrupt table sizes");
+	}
+
+	Hasher hasher;
+	if (!snapshot_read_hasher(snapshot, &hasher)) {
+		return NULL;
+	}
+
+	// point straight at the arrays inside the snapshot
+	Entry *slots = snapshot_read_array(snapshot, size, sizeof *slots);
+	bool *inuse = snapshot_read_flags(snapshot, size);
+	if (slots == NULL || inuse == NULL) {
+		hasher_free(&hasher);
+		return NULL;
+	}
+
+	LinearHashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->size = size;
+	table->load = load;
+	memcpy(&table->stats, stats, sizeof table->stats);
+	table->hasher = hasher;
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	table->slots = slots;
+	table->inuse = inuse;
+	table->snapshot = snapshot;
+
+	return table;
 }
 
 
@@ -324,21 +697,21 @@ bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
 void linear_hash_table_print(LinearHashTable *table) {
 	assert(table);
 
-	printf("--- table size: %d\n", table->size);
+	printf("--- table size: %lld\n", (long long) table->size);
 
 	// print header
 	printf("   address | key\n");
 
 	// print the rows of the hash table
-	int i;
+	size64 i;
 	for (i = 0; i < table->size; i++) {
 
 		// print the address
-		printf(" %9d | ", i);
+		printf(" %9lld | ", (long long) i);
 
 		// print the contents of the slot
 		if (table->inuse[i]) {
-			printf("%llu\n", table->slots[i]);
+			printf("%llu\n", table->slots[i].key);
 		} else {
 			printf("-\n");
 		}
@@ -348,20 +721,59 @@ void linear_hash_table_print(LinearHashTable *table) {
 }
 
 
+// how full 'table' is: the fraction of its key slots currently holding a key
+double linear_hash_table_load_factor(LinearHashTable *table) {
+	assert(table);
+
+	return (double) table->load / table->size;
+}
+
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage linear_hash_table_memory_usage(LinearHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = { 0 };
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+	memory_count(&usage, &usage.slots, table->slots,
+		(sizeof *table->slots) * table->size, table->snapshot);
+	memory_count(&usage, &usage.inuse, table->inuse,
+		(sizeof *table->inuse) * table->size, table->snapshot);
+	memory_count_hasher(&usage, &table->hasher);
+	return usage;
+}
+
+
 // print some statistics about 'table' to stdout
 void linear_hash_table_stats(LinearHashTable *table) {
 	assert(table);
 	printf("--- table stats ---\n");
 
 	// print some information about the table
-	printf("current size: %d slots\n", table->size);
-	printf("current load: %d items\n", table->load);
+	printf("current size: %lld slots\n", (long long) table->size);
+	printf("current load: %lld items\n", (long long) table->load);
 	printf(" load factor: %.3f%%\n", table->load * 100.0 / table->size);
 	printf("   step size: %d slots\n", STEP_SIZE);
+	printf("     reseeds: %d\n", table->nreseeds);
 
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_total(linear_hash_table_memory_usage(table));
+	printf(" memory used: %zu bytes\n", bytes);
+	if (table->load > 0) {
+		printf("   per entry: %.2f bytes\n", bytes * 1.0 / table->load);
+	}
+
+#if STATS_LEVEL >= STATS_FULL
 	// print some infomation about collisions
 	print_collisions_stats(table);
 
 	// print some infomation about average probe sequence length
 	print_probe_stats(table);
+#elif STATS_LEVEL >= STATS_COUNTERS
+	// print some totals instead, with no breakdown by load factor
+	print_insert_stats(table);
+#else
+	printf("--- end stats ---\n");
+#endif
 }
@@ -6,16 +6,30 @@
  */
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "../inthash.h"
+#include "../snapshot.h"
+#include "../memusage.h"
 
 typedef struct linear_table LinearHashTable;
 
 // initialise a linear probing hash table with initial size 'size'
-LinearHashTable *new_linear_hash_table(int size);
+LinearHashTable *new_linear_hash_table(size64 size);
+
+// build a new table containing the 'n' keys in 'keys' (which may contain
+// duplicates), sized up front to hold them all without growing, and filled
+// in parallel by 'nthreads' threads
+LinearHashTable *linear_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads);
 
 // free all memory associated with 'table'
 void free_linear_hash_table(LinearHashTable *table);
 
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), so that inserting that many keys does no doubling. never shrinks the
+// table
+void linear_hash_table_reserve(LinearHashTable *table, size64 nkeys);
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool linear_hash_table_insert(LinearHashTable *table, int64 key);
@@ -24,6 +38,39 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key);
 // returns true if found, false if not
 bool linear_hash_table_lookup(LinearHashTable *table, int64 key);
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool linear_hash_table_put(LinearHashTable *table, int64 key, int64 value);
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *linear_hash_table_get(LinearHashTable *table, int64 key);
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *linear_hash_table_iter_next(LinearHashTable *table, Cursor *cursor);
+
+// write the contents of 'table' to 'file', in a layout that
+// linear_hash_table_load() can use in place
+void linear_hash_table_save(LinearHashTable *table, FILE *file);
+
+// create a table from the next part of 'snapshot' (as written by
+// linear_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+LinearHashTable *linear_hash_table_load(Snapshot *snapshot);
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double linear_hash_table_load_factor(LinearHashTable *table);
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage linear_hash_table_memory_usage(LinearHashTable *table);
+
 // print the contents of 'table' to stdout
 void linear_hash_table_print(LinearHashTable *table);
 
@@ -0,0 +1,456 @@
+/* * * * * * * * *
+ * Lock-free set of keys using linear probing, which any number of threads can
+ * insert into and look up in at once. keys can be added but never removed,
+ * and there are no values: it answers "have we seen this key before?"
+ *
+ * every slot holds a key, or one of two reserved values: EMPTY, or MOVED for
+ * an empty slot which has been frozen while the table is moved into a bigger
+ * one. a slot only ever changes once, from EMPTY to a key or to MOVED, by
+ * compare-and-swap. so the slots before a key along its probe sequence always
+ * hold other keys, and a probe which meets MOVED knows its key is not in this
+ * table, and carries on in the next one
+ *
+ * a table which grows too full is moved into one twice the size, a chunk of
+ * slots at a time, by every thread that needs to insert into it
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for posix_memalign
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>  // for memset
+
+#include "lockfree.h"
+#include "../hugemem.h"
+
+// the values reserved for marking slots (the keys with these values are kept
+// track of separately)
+#define EMPTY ((int64) -1)
+#define MOVED ((int64) -2)
+
+// how many slots are moved into a bigger table at a time, by one thread
+#define CHUNK_SIZE 1024
+// how many counters each table's load is split over, so that threads inserting
+// at once aren't all fighting over the same one
+#define NUM_STRIPES 64
+// how many slots to keep for each key before growing the table
+#define SLOTS_PER_KEY 2
+// size of a cache line in bytes, which each counter gets to itself
+#define CACHE_LINE 64
+
+// shorthand for the atomic operations used throughout
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define CAS(ptr, expected, desired) __atomic_compare_exchange_n(ptr, \
+	expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define ADD(ptr, n) __atomic_add_fetch(ptr, n, __ATOMIC_ACQ_REL)
+
+// part of a table's load, padded out to a cache line
+typedef union counter {
+	size64 count;
+	char padding[CACHE_LINE];
+} Counter;
+
+// one table of slots. a lock-free table starts with one of these, and each
+// time it grows, moves into a new one twice the size
+typedef struct generation Generation;
+struct generation {
+	int64 *keys;		// array of slots: keys, EMPTY or MOVED
+	size64 size;		// how many slots (a power of two)
+	int chunk_size;		// how many slots to move at a time
+	size64 nchunks;		// how many chunks of slots there are
+	int nstripes;		// how many counters the load is split over
+	Counter *counters;	// the counters themselves (the load is their sum)
+	Generation *next;	// the bigger table we're being moved into, or NULL
+	Generation *older;	// the table we were moved from, or NULL
+	size64 next_chunk;	// the next chunk no thread has started moving yet
+	size64 chunks_done;	// how many chunks have been completely moved
+};
+
+// the outcome of trying to insert a key into one generation
+typedef enum outcome {
+	INSERTED, FOUND, FORWARD
+} Outcome;
+
+// a lock-free table is the generation new operations should start in, the
+// hash function every generation shares, and two flags standing in for slots
+// for the reserved keys
+struct lockfree_table {
+	Generation *current;	// the newest generation which isn't being moved
+							// (or a little older, while it catches up)
+	Hasher hasher;			// hash function giving each key its first slot
+	bool has_empty;			// is the key equal to EMPTY in the table?
+	bool has_moved;			// is the key equal to MOVED in the table?
+	int ngenerations;		// how many generations there have been
+};
+
+
+/* * *
+ * helper functions
+ */
+
+// create a new generation with 'size' slots, all empty
+static Generation *new_generation(size64 size) {
+	assert(size <= MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	Generation *gen = malloc(sizeof *gen);
+	assert(gen);
+
+	gen->keys = huge_malloc(size * sizeof *gen->keys);
+	assert(gen->keys);
+	memset(gen->keys, 0xff, size * sizeof *gen->keys);  // every slot EMPTY
+
+	gen->size = size;
+	gen->chunk_size = (size < CHUNK_SIZE) ? size : CHUNK_SIZE;
+	gen->nchunks = size / gen->chunk_size;
+	gen->nstripes = (gen->nchunks < NUM_STRIPES) ? gen->nchunks : NUM_STRIPES;
+
+	void *counters;
+	int error = posix_memalign(&counters, CACHE_LINE,
+		gen->nstripes * sizeof(Counter));
+	assert(error == 0);
+	gen->counters = counters;
+	memset(gen->counters, 0, gen->nstripes * sizeof(Counter));
+
+	gen->next = NULL;
+	gen->older = NULL;
+	gen->next_chunk = 0;
+	gen->chunks_done = 0;
+
+	return gen;
+}
+
+// free a generation and all of its arrays
+static void free_generation(Generation *gen) {
+	free(gen->keys);
+	free(gen->counters);
+	free(gen);
+}
+
+// how many keys are in 'gen', adding up its counters
+static size64 generation_load(Generation *gen) {
+	size64 load = 0;
+	int i;
+	for (i = 0; i < gen->nstripes; i++) {
+		load += LOAD(&gen->counters[i].count);
+	}
+	return load;
+}
+
+// start moving 'gen' into a new generation twice the size, unless another
+// thread already has
+static void start_migration(LockFreeHashTable *table, Generation *gen) {
+	if (LOAD(&gen->next) != NULL) {
+		return;
+	}
+
+	// several threads might get this far at once, but only one of their new
+	// generations gets used
+	Generation *next = new_generation(gen->size * 2);
+	next->older = gen;
+	Generation *expected = NULL;
+	if (CAS(&gen->next, &expected, next)) {
+		ADD(&table->ngenerations, 1);
+	} else {
+		free_generation(next);
+	}
+}
+
+// count a key newly placed at slot 'h' of 'gen', and start growing the table
+// if that makes it too full. each counter covers the same share of the slots,
+// so one counter's count times the number of counters estimates the load
+// without having to add them all up
+static void count_key(LockFreeHashTable *table, Generation *gen, size64 h) {
+	int stripe = (h / gen->chunk_size) % gen->nstripes;
+	size64 count = ADD(&gen->counters[stripe].count, 1);
+	if (count * gen->nstripes * SLOTS_PER_KEY > gen->size) {
+		start_migration(table, gen);
+	}
+}
+
+// try to insert 'key' into 'gen' alone
+// returns INSERTED if we placed it, FOUND if it was already in there, or
+// FORWARD if it belongs in the next generation instead (which then exists)
+static Outcome insert_into(LockFreeHashTable *table, Generation *gen,
+	int64 key) {
+	size64 h = HASH_FIRST(hasher_hash(&table->hasher, key)) % gen->size;
+	size64 steps;
+	for (steps = 0; steps < gen->size; steps++) {
+		int64 found = LOAD(&gen->keys[h]);
+
+		// try to claim an empty slot. if another thread beats us to it, the
+		// slot now holds whatever they put there
+		if (found == EMPTY) {
+			if (CAS(&gen->keys[h], &found, key)) {
+				count_key(table, gen, h);
+				return INSERTED;
+			}
+		}
+
+		if (found == key) {
+			return FOUND;
+		}
+		if (found == MOVED) {
+			return FORWARD;
+		}
+
+		h = (h + 1) % gen->size;
+	}
+
+	// every slot is taken (and won't become free), so it's time to grow
+	start_migration(table, gen);
+	return FORWARD;
+}
+
+// insert 'key' into 'gen', or whichever later generation it belongs in
+// returns whether we placed it (INSERTED) or it was already there (FOUND)
+static Outcome insert_key(LockFreeHashTable *table, Generation *gen,
+	int64 key);
+
+// make 'table' start new operations in the newest generation whose
+// predecessors have all been completely moved into it
+static void advance_current(LockFreeHashTable *table) {
+	Generation *gen = LOAD(&table->current);
+	while (LOAD(&gen->next) != NULL
+		&& LOAD(&gen->chunks_done) == gen->nchunks) {
+		Generation *next = LOAD(&gen->next);
+		// if this fails, someone else has moved it on already
+		CAS(&table->current, &gen, next);
+		gen = LOAD(&table->current);
+	}
+}
+
+// move every key in chunk 'chunk' of 'gen' into the next generation, freezing
+// each empty slot on the way so that nobody can insert into it afterwards
+static void migrate_chunk(LockFreeHashTable *table, Generation *gen,
+	size64 chunk) {
+	size64 first = chunk * gen->chunk_size;
+	size64 h;
+	for (h = first; h < first + gen->chunk_size; h++) {
+		int64 found = LOAD(&gen->keys[h]);
+		if (found == EMPTY && CAS(&gen->keys[h], &found, MOVED)) {
+			continue;
+		}
+		// the slot holds a key (maybe one that just beat us to it)
+		insert_key(table, LOAD(&gen->next), found);
+	}
+}
+
+// help move 'gen' into the next generation, by claiming and moving chunks of
+// it until there are none left to claim (some may still be on their way,
+// moved by other threads, but we don't wait for them)
+static void help_migrate(LockFreeHashTable *table, Generation *gen) {
+	while (LOAD(&gen->next_chunk) < gen->nchunks) {
+		size64 chunk = ADD(&gen->next_chunk, 1) - 1;
+		if (chunk >= gen->nchunks) {
+			break;
+		}
+		migrate_chunk(table, gen, chunk);
+		if (ADD(&gen->chunks_done, 1) == gen->nchunks) {
+			advance_current(table);
+		}
+	}
+}
+
+// insert 'key' into 'gen', or whichever later generation it belongs in
+// returns whether we placed it (INSERTED) or it was already there (FOUND)
+static Outcome insert_key(LockFreeHashTable *table, Generation *gen,
+	int64 key) {
+	for (;;) {
+		// once a bigger table is on its way, help move the keys across before
+		// adding to them, or this table would only grow fuller in the meantime
+		if (LOAD(&gen->next) != NULL) {
+			help_migrate(table, gen);
+		}
+
+		// the key could still be here (maybe in a chunk someone else is
+		// moving), so look for it before going on to the next table
+		Outcome outcome = insert_into(table, gen, key);
+		if (outcome != FORWARD) {
+			return outcome;
+		}
+		gen = LOAD(&gen->next);
+	}
+}
+
+// add the reserved key pointed to by 'flag' to the table
+// returns true if it was newly added, false if it was already there
+static bool insert_reserved(bool *flag) {
+	return !__atomic_exchange_n(flag, true, __ATOMIC_ACQ_REL);
+}
+
+// the flag standing in for 'key' inside 'table' if it's a reserved key, or
+// NULL if it's an ordinary key
+static bool *reserved_flag(LockFreeHashTable *table, int64 key) {
+	if (key == EMPTY) {
+		return &table->has_empty;
+	}
+	if (key == MOVED) {
+		return &table->has_moved;
+	}
+	return NULL;
+}
+
+// the newest generation of 'table' (which may still be being moved into)
+static Generation *newest_generation(LockFreeHashTable *table) {
+	Generation *gen = LOAD(&table->current);
+	while (LOAD(&gen->next) != NULL) {
+		gen = LOAD(&gen->next);
+	}
+	return gen;
+}
+
+
+/* * *
+ * all functions
+ */
+
+// initialise a lock-free hash table with initial size 'size'
+LockFreeHashTable *new_lockfree_hash_table(size64 size) {
+	assert(size > 0);
+
+	LockFreeHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	size64 rounded = 1;
+	while (rounded < size) {
+		rounded *= 2;
+	}
+	table->current = new_generation(rounded);
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->has_empty = false;
+	table->has_moved = false;
+	table->ngenerations = 1;
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_lockfree_hash_table(LockFreeHashTable *table) {
+	assert(table);
+
+	// every generation is still around, linked from the newest back
+	Generation *gen = newest_generation(table);
+	while (gen != NULL) {
+		Generation *older = gen->older;
+		free_generation(gen);
+		gen = older;
+	}
+
+	hasher_free(&table->hasher);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if this call inserted 'key', false if it was already in there
+bool lockfree_hash_table_insert(LockFreeHashTable *table, int64 key) {
+	assert(table);
+
+	bool *flag = reserved_flag(table, key);
+	if (flag != NULL) {
+		return insert_reserved(flag);
+	}
+
+	return insert_key(table, LOAD(&table->current), key) == INSERTED;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool lockfree_hash_table_lookup(LockFreeHashTable *table, int64 key) {
+	assert(table);
+
+	bool *flag = reserved_flag(table, key);
+	if (flag != NULL) {
+		return LOAD(flag);
+	}
+
+	// search each generation in turn, moving on whenever the key could only
+	// be in the next one. nothing here waits for another thread
+	Generation *gen = LOAD(&table->current);
+	while (gen != NULL) {
+		size64 h = HASH_FIRST(hasher_hash(&table->hasher, key)) % gen->size;
+		size64 steps;
+		for (steps = 0; steps < gen->size; steps++) {
+			int64 found = LOAD(&gen->keys[h]);
+			if (found == key) {
+				return true;
+			}
+			if (found == EMPTY) {
+				return false;
+			}
+			if (found == MOVED) {
+				break;
+			}
+			h = (h + 1) % gen->size;
+		}
+		gen = LOAD(&gen->next);
+	}
+
+	return false;
+}
+
+
+// how many keys are in 'table'
+size64 lockfree_hash_table_count(LockFreeHashTable *table) {
+	assert(table);
+
+	// the newest generation's counters include every key moved into it,
+	// once the moving is finished
+	size64 count = generation_load(newest_generation(table));
+	count += LOAD(&table->has_empty) + LOAD(&table->has_moved);
+	return count;
+}
+
+
+// calculate how many bytes of memory 'table' is using
+MemoryUsage lockfree_hash_table_memory_usage(LockFreeHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = { 0 };
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+
+	Generation *gen = newest_generation(table);
+	while (gen != NULL) {
+		memory_count(&usage, &usage.overhead, gen, sizeof *gen, NULL);
+		memory_count(&usage, &usage.slots, gen->keys,
+			gen->size * sizeof *gen->keys, NULL);
+		memory_count(&usage, &usage.overhead, gen->counters,
+			gen->nstripes * sizeof(Counter), NULL);
+		gen = gen->older;
+	}
+	memory_count_hasher(&usage, &table->hasher);
+
+	return usage;
+}
+
+
+// print some statistics about 'table' to stdout
+void lockfree_hash_table_stats(LockFreeHashTable *table) {
+	assert(table);
+
+	printf("--- lock-free table stats ---\n");
+
+	Generation *gen = newest_generation(table);
+	size64 load = generation_load(gen);
+
+	// print some information about the table
+	printf("current size: %lld slots\n", (long long) gen->size);
+	printf("current load: %lld items\n", (long long) load);
+	printf(" load factor: %.3f%%\n", load * 100.0 / gen->size);
+	printf(" generations: %d\n", LOAD(&table->ngenerations));
+
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_total(lockfree_hash_table_memory_usage(table));
+	printf(" memory used: %zu bytes\n", bytes);
+	if (load > 0) {
+		printf("   per entry: %.2f bytes\n", bytes * 1.0 / load);
+	}
+
+	printf("--- end stats ---\n");
+}
@@ -0,0 +1,50 @@
+/* * * * * * * * *
+ * Lock-free set of keys using linear probing, which any number of threads can
+ * insert into and look up in at once. keys can be added but never removed,
+ * and there are no values: it answers "have we seen this key before?"
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef LOCKFREE_H
+#define LOCKFREE_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../memusage.h"
+
+typedef struct lockfree_table LockFreeHashTable;
+
+// initialise a lock-free hash table with initial size 'size' (rounded up to a
+// power of two)
+LockFreeHashTable *new_lockfree_hash_table(size64 size);
+
+// free all memory associated with 'table'. no other thread may be using it
+void free_lockfree_hash_table(LockFreeHashTable *table);
+
+// the following functions may be called by any number of threads at once
+
+// insert 'key' into 'table', if it's not in there already. never blocks: if
+// the table is being moved into a bigger one, helps move it along instead
+// returns true if this call inserted 'key', false if it was already in there
+// (so exactly one of any number of threads inserting the same key sees true)
+bool lockfree_hash_table_insert(LockFreeHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'. wait-free: finishes in a bounded
+// number of steps no matter what other threads are doing
+// returns true if found, false if not
+bool lockfree_hash_table_lookup(LockFreeHashTable *table, int64 key);
+
+// how many keys are in 'table' (exact only while no insertions are under way)
+size64 lockfree_hash_table_count(LockFreeHashTable *table);
+
+// calculate how many bytes of memory 'table' is using, including the smaller
+// tables it has outgrown (which are kept until it is freed, since other
+// threads might still be reading them)
+MemoryUsage lockfree_hash_table_memory_usage(LockFreeHashTable *table);
+
+// print some statistics about 'table' to stdout
+void lockfree_hash_table_stats(LockFreeHashTable *table);
+
+#endif
@@ -0,0 +1,356 @@
+/* * * * * * * * *
+ * Dynamic hash table for variable-length byte-string keys, using linear
+ * probing to resolve collisions and an append-only arena to store the keys
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>  // for memcmp, memset
+
+#include "strlinear.h"
+#include "arena.h"
+#include "../strhash.h"
+#include "../hugemem.h"
+#include "../stats.h"
+
+// how many cells to advance at a time while looking for a free slot
+#define STEP_SIZE 1
+// how many bytes of arena to start with for each slot in the initial table
+#define ARENA_BYTES_PER_SLOT 16
+
+// macros to split a 64-bit string hash into an address part and a fragment
+// (top half) stored in the slot to filter out mismatching keys. the address is
+// the whole value, so that any table size can be reached, but a power of two
+// size up to 2^32 only uses its bottom half
+#define hash_address(h) ((int64) (h))
+#define hash_fragment(h) ((uint32_t)((h) >> 32))
+
+// a slot doesn't hold a key's bytes directly: they live in the table's arena.
+// instead it remembers where to find them, along with a fragment of the key's
+// hash value. two keys with different fragments can't be equal, so most
+// mismatches are rejected without ever touching the arena. when entries keep
+// their hash values (see CACHE_HASHES in inthash.h) the slot holds the rest of
+// the hash value too, so doubling the table never goes to the arena either
+typedef struct str_slot {
+	int64 offset;		// where this key's bytes start in the arena
+	int length;			// how many bytes long this key is
+	uint32_t fragment;	// the top 32 bits of this key's hash value
+#if CACHE_HASHES
+	uint32_t rest;		// and the bottom 32 bits
+#endif
+	int64 value;		// the value associated with this key
+} Slot;
+
+// helper structure to store statistics gathered (if any: see stats.h)
+typedef struct stats {
+#if STATS_LEVEL >= STATS_COUNTERS
+	int64 nprobes;		// how many slots have been inspected in total
+	int64 nrejects;		// how many mismatches were rejected by fragment alone
+	int64 ncompares;	// how many times key bytes were compared in the arena
+#else
+	char unused;		// (C has no empty structs)
+#endif
+} Stats;
+
+// a hash table is an array of slots describing keys, along with a parallel
+// array of boolean markers recording which slots are in use (true) or free
+// (false), and the arena actually holding the keys' bytes
+struct str_linear_table {
+	Slot  *slots;		// array of slots describing keys and their values
+	bool  *inuse;		// is this slot in use or not?
+	size64 size;		// the size of both of these arrays right now
+	size64 load;		// number of keys in the table right now
+	KeyArena *arena;	// append-only storage for the keys' bytes
+	Stats stats;		// collection of statistics about this hash table
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// set up the slot arrays of a string hash table struct with new arrays of
+// size 'size'
+static void initialise_table(StrHashTable *table, size64 size) {
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	table->slots = huge_malloc((sizeof *table->slots) * size);
+	assert(table->slots);
+	table->inuse = huge_calloc(size, sizeof *table->inuse);
+	assert(table->inuse);
+
+	table->size = size;
+	table->load = 0;
+}
+
+// find the slot for the 'len'-byte key 'key' with hash value 'hash': either the
+// slot holding it, or the free slot where it belongs
+// returns the address of that slot, or -1 if the key isn't there and the table
+// has no free slots left
+static size64 find_slot(StrHashTable *table, const char *key, int len,
+	int64 hash) {
+	assert(table);
+
+	uint32_t fragment = hash_fragment(hash);
+	size64 h = hash_address(hash) % table->size;
+
+	// step along until we find a free space (inuse[]==false), or until we
+	// visit every cell
+	size64 steps = 0;
+	while (table->inuse[h] && steps < table->size) {
+		Slot *slot = &table->slots[h];
+#if STATS_LEVEL >= STATS_COUNTERS
+		table->stats.nprobes++;
+#endif
+
+		// only go to the arena if length and hash fragment both agree
+		if (slot->fragment != fragment || slot->length != len) {
+#if STATS_LEVEL >= STATS_COUNTERS
+			table->stats.nrejects++;
+#endif
+		} else {
+#if STATS_LEVEL >= STATS_COUNTERS
+			table->stats.ncompares++;
+#endif
+			const char *bytes = key_arena_at(table->arena, slot->offset);
+			if (memcmp(bytes, key, len) == 0) {
+				return h;
+			}
+		}
+
+		// keep stepping
+		h = (h + STEP_SIZE) % table->size;
+		steps++;
+	}
+
+	// if we used up all of our steps, the table is full
+	return (steps == table->size) ? -1 : h;
+}
+
+// double the size of the internal table arrays and re-hash all keys in the
+// old arrays. the keys' bytes stay exactly where they are in the arena
+static void double_table(StrHashTable *table) {
+	assert(table);
+
+	Slot *oldslots = table->slots;
+	bool *oldinuse = table->inuse;
+	size64 oldsize = table->size;
+
+	initialise_table(table, table->size * 2);
+
+	size64 i;
+	for (i = 0; i < oldsize; i++) {
+		if (oldinuse[i] == true) {
+			// we know all of these keys are distinct, so there's no need to
+			// compare them: just re-hash and step to the next free slot
+			Slot *slot = &oldslots[i];
+#if CACHE_HASHES
+			int64 hash = ((int64) slot->fragment << 32) | slot->rest;
+#else
+			const char *bytes = key_arena_at(table->arena, slot->offset);
+			int64 hash = strhash(bytes, slot->length);
+#endif
+			size64 h = hash_address(hash) % table->size;
+			while (table->inuse[h]) {
+				h = (h + STEP_SIZE) % table->size;
+			}
+			table->slots[h] = *slot;
+			table->inuse[h] = true;
+			table->load++;
+		}
+	}
+
+	free(oldslots);
+	free(oldinuse);
+}
+
+// insert the 'len'-byte key 'key' with 'value' into 'table' if it's not in
+// there already. if it is, replace the value stored with it only when
+// 'replace' is true
+// returns true if the key was newly inserted, false if it was already there
+static bool insert_key(StrHashTable *table, const char *key, int len,
+	int64 value, bool replace) {
+	assert(table);
+
+	int64 hash = strhash(key, len);
+	size64 h = find_slot(table, key, len, hash);
+
+	// no room? make some more space and look again
+	while (h < 0) {
+		double_table(table);
+		h = find_slot(table, key, len, hash);
+	}
+
+	Slot *slot = &table->slots[h];
+	if (table->inuse[h]) {
+		// this key already exists in the table! no need to insert
+		if (replace) {
+			slot->value = value;
+		}
+		return false;
+	}
+
+	// otherwise, we have found a free slot! copy the key into the arena and
+	// record where we put it
+	slot->offset = key_arena_append(table->arena, key, len);
+	slot->length = len;
+	slot->fragment = hash_fragment(hash);
+#if CACHE_HASHES
+	slot->rest = (uint32_t) hash;
+#endif
+	slot->value = value;
+	table->inuse[h] = true;
+	table->load++;
+	return true;
+}
+
+// calculate how many bytes of memory 'table' is currently using
+static size_t memory_usage(StrHashTable *table) {
+	assert(table);
+
+	size_t bytes = sizeof *table;
+	bytes += (sizeof *table->slots) * table->size;
+	bytes += (sizeof *table->inuse) * table->size;
+	bytes += key_arena_memory(table->arena);
+	return bytes;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a string-key linear probing hash table with initial size 'size'
+StrHashTable *new_str_hash_table(size64 size) {
+	StrHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	initialise_table(table, size);
+	table->arena = new_key_arena(size * ARENA_BYTES_PER_SLOT);
+
+	memset(&table->stats, 0, sizeof table->stats);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_str_hash_table(StrHashTable *table) {
+	assert(table != NULL);
+
+	// free the table's arrays and arena
+	free(table->slots);
+	free(table->inuse);
+	free_key_arena(table->arena);
+
+	// free the table struct itself
+	free(table);
+}
+
+
+// insert the 'len'-byte key 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool str_hash_table_insert(StrHashTable *table, const char *key, int len) {
+	return insert_key(table, key, len, 0, false);
+}
+
+
+// lookup whether the 'len'-byte key 'key' is inside 'table'
+// returns true if found, false if not
+bool str_hash_table_lookup(StrHashTable *table, const char *key, int len) {
+	return str_hash_table_get(table, key, len) != NULL;
+}
+
+
+// insert the 'len'-byte key 'key' into 'table' with value 'value', or replace
+// the value stored with it if it's already in there
+// returns true if the key was newly inserted, false if its value was replaced
+bool str_hash_table_put(StrHashTable *table, const char *key, int len,
+	int64 value) {
+	return insert_key(table, key, len, value, true);
+}
+
+
+// find the value stored with the 'len'-byte key 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if the key is not in the table
+int64 *str_hash_table_get(StrHashTable *table, const char *key, int len) {
+	assert(table);
+
+	size64 h = find_slot(table, key, len, strhash(key, len));
+	if (h < 0 || !table->inuse[h]) {
+		return NULL;
+	}
+	return &table->slots[h].value;
+}
+
+
+// print the contents of 'table' to stdout
+void str_hash_table_print(StrHashTable *table) {
+	assert(table);
+
+	printf("--- table size: %lld\n", (long long) table->size);
+
+	// print header
+	printf("   address | key\n");
+
+	// print the rows of the hash table
+	size64 i;
+	for (i = 0; i < table->size; i++) {
+
+		// print the address
+		printf(" %9lld | ", (long long) i);
+
+		// print the contents of the slot
+		if (table->inuse[i]) {
+			Slot *slot = &table->slots[i];
+			const char *bytes = key_arena_at(table->arena, slot->offset);
+			printf("%.*s\n", slot->length, bytes);
+		} else {
+			printf("-\n");
+		}
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void str_hash_table_stats(StrHashTable *table) {
+	assert(table);
+	printf("--- table stats ---\n");
+
+	// print some information about the table
+	printf("current size: %lld slots\n", (long long) table->size);
+	printf("current load: %lld items\n", (long long) table->load);
+	printf(" load factor: %.3f%%\n", table->load * 100.0 / table->size);
+	printf("   step size: %d slots\n", STEP_SIZE);
+	printf("  arena used: %zu bytes\n", key_arena_used(table->arena));
+
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_usage(table);
+	printf(" memory used: %zu bytes\n", bytes);
+	if (table->load > 0) {
+		printf("   per entry: %.2f bytes\n", bytes * 1.0 / table->load);
+	}
+
+#if STATS_LEVEL >= STATS_COUNTERS
+	// print how often we managed to avoid touching the arena
+	Stats *stats = &table->stats;
+	printf("\nSlots probed: %lld\n", (long long)stats->nprobes);
+	if (stats->nprobes > 0) {
+		printf("    rejected by hash fragment: %lld (%.2f%%)\n",
+			(long long)stats->nrejects,
+			stats->nrejects * 100.0 / stats->nprobes);
+		printf("    compared against arena: %lld (%.2f%%)\n",
+			(long long)stats->ncompares,
+			stats->ncompares * 100.0 / stats->nprobes);
+	}
+#endif
+
+	printf("--- end stats ---\n");
+}
@@ -0,0 +1,48 @@
+/* * * * * * * * *
+ * Dynamic hash table for variable-length byte-string keys, using linear
+ * probing to resolve collisions and an append-only arena to store the keys
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef STRLINEAR_H
+#define STRLINEAR_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+
+typedef struct str_linear_table StrHashTable;
+
+// initialise a string-key linear probing hash table with initial size 'size'
+StrHashTable *new_str_hash_table(size64 size);
+
+// free all memory associated with 'table'
+void free_str_hash_table(StrHashTable *table);
+
+// insert the 'len'-byte key 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool str_hash_table_insert(StrHashTable *table, const char *key, int len);
+
+// lookup whether the 'len'-byte key 'key' is inside 'table'
+// returns true if found, false if not
+bool str_hash_table_lookup(StrHashTable *table, const char *key, int len);
+
+// insert the 'len'-byte key 'key' into 'table' with value 'value', or replace
+// the value stored with it if it's already in there
+// returns true if the key was newly inserted, false if its value was replaced
+bool str_hash_table_put(StrHashTable *table, const char *key, int len,
+	int64 value);
+
+// find the value stored with the 'len'-byte key 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if the key is not in the table
+int64 *str_hash_table_get(StrHashTable *table, const char *key, int len);
+
+// print the contents of 'table' to stdout
+void str_hash_table_print(StrHashTable *table);
+
+// print some statistics about 'table' to stdout
+void str_hash_table_stats(StrHashTable *table);
+
+#endif
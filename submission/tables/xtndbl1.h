@@ -10,16 +10,32 @@
 #define XTNDBL1_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "../inthash.h"
+#include "../snapshot.h"
+#include "../memusage.h"
 
 typedef struct xtndbl1_table Xtndbl1HashTable;
 
 // initialise a single-key extendible hash table
 Xtndbl1HashTable *new_xtndbl1_hash_table();
 
+// build a new table containing the 'n' keys in 'keys' (which may contain
+// duplicates), sized up front to hold them all without growing, and filled
+// in parallel by 'nthreads' threads
+Xtndbl1HashTable *xtndbl1_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads);
+
 // free all memory associated with 'table'
 void free_xtndbl1_hash_table(Xtndbl1HashTable *table);
 
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), splitting buckets and deepening the table of bucket pointers past
+// them, so that inserting that many keys does little splitting and rarely
+// doubles (only when two keys share every address bit). never shrinks the
+// table
+void xtndbl1_hash_table_reserve(Xtndbl1HashTable *table, size64 nkeys);
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key);
@@ -28,6 +44,39 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key);
 // returns true if found, false if not
 bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key);
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbl1_hash_table_put(Xtndbl1HashTable *table, int64 key, int64 value);
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *xtndbl1_hash_table_get(Xtndbl1HashTable *table, int64 key);
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *xtndbl1_hash_table_iter_next(Xtndbl1HashTable *table, Cursor *cursor);
+
+// write the contents of 'table' to 'file', in a layout that
+// xtndbl1_hash_table_load() can use in place
+void xtndbl1_hash_table_save(Xtndbl1HashTable *table, FILE *file);
+
+// create a table from the next part of 'snapshot' (as written by
+// xtndbl1_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+Xtndbl1HashTable *xtndbl1_hash_table_load(Snapshot *snapshot);
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double xtndbl1_hash_table_load_factor(Xtndbl1HashTable *table);
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage xtndbl1_hash_table_memory_usage(Xtndbl1HashTable *table);
+
 // print the contents of 'table' to stdout
 void xtndbl1_hash_table_print(Xtndbl1HashTable *table);
 
@@ -9,31 +9,53 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <time.h>
 #include <string.h>  // for memcpy
+#include <limits.h>  // for INT_MAX
 
 #include "xtndbln.h"
+#include "bulk.h"
+#include "../hugemem.h"
+#include "../latency.h"
 
 // macro to calculate the rightmost n bits of a number x
-#define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
-
-// a bucket stores an array of keys
+#define rightmostnbits(n, x) ((size64) ((x) & (((int64) 1 << (n)) - 1)))
+
+// how many key slots (across all buckets) to make for each key when sizing a
+// table up front (bulk loading or reserving space), so that few buckets
+// overflow
+#define SLOTS_PER_KEY 2
+
+// an insertion that has to split its bucket more than MAX_SPLITS times, or
+// to grow the table more than DEPTH_SLACK bits deeper than random hash values
+// would need for its buckets (or to MAX_TABLE_SIZE), has met keys sharing far
+// more hash value bits than they should (by accident, or by design), so the
+// table is rebuilt with a new seed instead. up to MAX_RESEEDS rebuilds can be
+// under way at once (each interrupted by the next), after which the table
+// splits as usual
+#define MAX_SPLITS 16
+#define DEPTH_SLACK 4
+#define MAX_RESEEDS 4
+
+// reserving room deepens the table of bucket pointers up to RESERVE_SLACK bits
+// past the buckets it splits (as deep as random hash values are likely to
+// need), so that buckets which overflow later can split without doubling it
+#define RESERVE_SLACK 8
+
+// a bucket stores an array of entries, each key sitting right next to its value
 // it also knows how many bits are shared between possible keys, and the first
 // table address that references it
 typedef struct xtndbln_bucket {
-	int id;			// a unique id for this bucket, equal to the first address
+	size64 id;		// a unique id for this bucket, equal to the first address
 					// in the table which points to it
 	int depth;		// how many hash value bits are being used by this bucket
 	int nkeys;		// number of keys currently contained in this bucket
-	int64 *keys;	// the keys stored in this bucket
+	Entry *entries;	// the keys stored in this bucket, along with their values
 } Bucket;
 
 // helper structure to store statistics gathered
 typedef struct stats {
-	int nbuckets;	// how many distinct buckets does the table point to
-	int nkeys;		// how many keys are being stored in the table
-	int time;		// how much CPU time has been used to insert/lookup keys
-					// in this table
+	size64 nbuckets;	// how many distinct buckets does the table point to
+	size64 nkeys;		// how many keys are being stored in the table
 } Stats;
 
 // a hash table is an array of slots pointing to buckets holding up to
@@ -41,25 +63,35 @@ typedef struct stats {
 // bits to use for addressing
 struct xtndbln_table {
 	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	size64 size;		// how many entries in the table of pointers (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
 	int bucketsize;		// maximum number of keys per bucket
 	Stats stats;
+	Hasher hasher;		// this table's hash function
+	int nreseeds;		// how many times it has been given a new seed
+	int reseeding;		// how many rebuilds with a new seed are under way
+	Latency latency;	// how long operations on this table have been taking
+	Snapshot *snapshot;	// snapshot the buckets were loaded from (or NULL)
 };
 
 /* * * *
  * helper functions
  */
 
+// the hash value of 'key' in 'table'
+static int64 hash_key(XtndblNHashTable *table, int64 key) {
+	return HASH_FIRST(hasher_hash(&table->hasher, key));
+}
+
  // create a new bucket first referenced from 'first_address', based on 'depth'
  // bits of its keys' hash values
- Bucket *new_bucket(int first_address, int depth, int bucketsize) {
+ Bucket *new_bucket(size64 first_address, int depth, int bucketsize) {
  	Bucket *bucket = malloc(sizeof *bucket);
  	assert(bucket);
 
-	// setup array of keys
-	bucket->keys = malloc((sizeof *bucket->keys) * bucketsize);
-	assert(bucket->keys);
+	// setup array of entries
+	bucket->entries = malloc((sizeof *bucket->entries) * bucketsize);
+	assert(bucket->entries);
 	bucket->nkeys = 0;
 
 	bucket->id = first_address;
@@ -74,13 +106,18 @@ struct xtndbln_table {
 static void double_table(XtndblNHashTable *table) {
 	assert(table);
 
-	int size = table->size * 2;
+	size64 size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
+	LatencyTimer timer;
+	latency_begin_always(&timer);
+
 	// get a new array of twice as many bucket pointers, and copy pointers down
-	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
+	table->buckets = huge_realloc(table->buckets,
+		(sizeof *table->buckets) * table->size,
+		(sizeof *table->buckets) * size);
 	assert(table->buckets);
-	int i;
+	size64 i;
 	for (i = 0; i < table->size; i++) {
 		table->buckets[table->size + i] = table->buckets[i];
 	}
@@ -88,30 +125,33 @@ static void double_table(XtndblNHashTable *table) {
 	// finally, increase the table size and the depth we are using to hash keys
 	table->size = size;
 	table->depth++;
+
+	latency_end(&table->latency, &timer, OP_RESIZE);
 }
 
 // need to set this up, searching down the array for a place to store the key
-// reinsert a key into the hash table after splitting a bucket --- we can assume
-// that there will definitely be space for this key because it was already
-// inside the hash table previously
+// reinsert an entry into the hash table after splitting a bucket --- we can
+// assume that there will definitely be space for this key because it was
+// already inside the hash table previously
 // use 'xtndbl1_hash_table_insert()' instead for inserting new keys
-static void reinsert_key(XtndblNHashTable *table, int64 key) {
+static void reinsert_entry(XtndblNHashTable *table, Entry entry) {
 	assert(table);
 
-	int address = rightmostnbits(table->depth, h1(key));
+	int64 hash = HASH_FIRST(entry_hash(&table->hasher, &entry));
+	size64 address = rightmostnbits(table->depth, hash);
 
 	// point to insert into
 	int insersion_point = table->buckets[address]->nkeys;
 
 	// insert into next point in bucket
-	table->buckets[address]->keys[insersion_point] = key;
+	table->buckets[address]->entries[insersion_point] = entry;
 	table->buckets[address]->nkeys += 1;
 }
 
 // need to set this up eventually, changing lsat bit where keys is reinserted
 // to reinsert every key from that bucket
  // split the bucket in 'table' at address 'address', growing table if necessary
-static void split_bucket(XtndblNHashTable *table, int address) {
+static void split_bucket(XtndblNHashTable *table, size64 address) {
 	assert(table);
 
 	// FIRST,
@@ -126,14 +166,14 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 	// create a new bucket and update both buckets' depth
 	Bucket *bucket = table->buckets[address];
 	int depth = bucket->depth;
-	int first_address = bucket->id;
+	size64 first_address = bucket->id;
 	int bucketsize = table->bucketsize;
 
 	int new_depth = depth + 1;
 	bucket->depth = new_depth;
 
 	// new bucket's first address will be a 1 bit plus the old first address
-	int new_first_address = 1 << depth | first_address;
+	size64 new_first_address = (size64) 1 << depth | first_address;
 	Bucket *newbucket = new_bucket(new_first_address, new_depth, bucketsize);
 	table->stats.nbuckets++;
 
@@ -143,19 +183,19 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 	// (defined below)
 
 	// suffix: a 1 bit followed by the previous bucket bit address
-	int bit_address = rightmostnbits(depth, first_address);
-	int suffix = (1 << depth) | bit_address;
+	size64 bit_address = rightmostnbits(depth, first_address);
+	size64 suffix = ((size64) 1 << depth) | bit_address;
 
 	// prefix: all bitstrings of length equal to the difference between the new
 	// bucket depth and the table depth
 	// use a for loop to enumerate all possible prefixes less than maxprefix:
-	int maxprefix = 1 << (table->depth - new_depth);
+	size64 maxprefix = (size64) 1 << (table->depth - new_depth);
 
-	int prefix;
+	size64 prefix;
 	for (prefix = 0; prefix < maxprefix; prefix++) {
 
 		// construct address by joining this prefix and the suffix
-		int a = (prefix << new_depth) | suffix;
+		size64 a = (prefix << new_depth) | suffix;
 
 		// redirect this table entry to point at the new bucket
 		table->buckets[a] = newbucket;
@@ -165,22 +205,261 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 	// filter the keys from the old bucket into their rightful place in the new
 	// table (which may be the old bucket, or may be the new bucket)
 
-	// make a copy of the keys
-	int64 *tmp_keys = malloc((sizeof *tmp_keys) * bucket->nkeys);
-	memcpy(tmp_keys, bucket->keys, bucket->nkeys * sizeof(int64));
+	// make a copy of the entries
+	Entry *tmp_entries = malloc((sizeof *tmp_entries) * bucket->nkeys);
+	memcpy(tmp_entries, bucket->entries, bucket->nkeys * sizeof(Entry));
 	int nkeys = bucket->nkeys;
 
 	// set bucket as empty
 	bucket->nkeys = 0;
 
-	// reinsert the keys into the table
+	// reinsert the entries into the table
 	int i;
 	for (i=0; i<nkeys; i++) {
-		reinsert_key(table, tmp_keys[i]);
+		reinsert_entry(table, tmp_entries[i]);
+	}
+	free(tmp_entries);
+}
+
+// grow 'table' to 2^'depth' addresses (if it's smaller), and split buckets
+// until each uses at least 'depth' bits
+static void split_to_depth(XtndblNHashTable *table, int depth) {
+	assert(table);
+
+	while (table->depth < depth) {
+		double_table(table);
+	}
+
+	size64 address;
+	for (address = 0; address < table->size; address++) {
+		while (table->buckets[address]->depth < depth) {
+			split_bucket(table, address);
+		}
+	}
+}
+
+// how many bits of hash value to use for a table sized up front to hold
+// 'nkeys' keys in buckets of 'bucketsize', giving each key SLOTS_PER_KEY slots
+static int depth_for(size64 nkeys, int bucketsize) {
+	size64 nslots = (nkeys > 0 ? nkeys : 1) * SLOTS_PER_KEY;
+	return ceil_log2((nslots + bucketsize - 1) / bucketsize);
+}
+
+// has an insertion that has split buckets 'splits' times, and now has to
+// split the bucket at 'address', met keys colliding far too much?
+static bool colliding(XtndblNHashTable *table, size64 address,
+	int splits) {
+	if (splits > MAX_SPLITS) {
+		return true;
+	}
+	if (table->buckets[address]->depth < table->depth) {
+		// the table needn't grow
+		return false;
+	}
+
+	// random hash values need about (1 + 1/bucketsize) log2(nbuckets) bits
+	// to give each bucket its own address
+	int bits = ceil_log2(table->stats.nbuckets);
+	int depth = bits + bits / table->bucketsize;
+	return table->depth >= depth + DEPTH_SLACK
+		|| table->size * 2 >= MAX_TABLE_SIZE;
+}
+
+static void insert_entry(XtndblNHashTable *table, int64 key, int64 value);
+
+// give 'table' a new hash function and rebuild it around its keys, after an
+// insertion found them colliding pathologically (the caller counts the
+// rebuild in table->reseeding)
+static void reseed_table(XtndblNHashTable *table) {
+	assert(table);
+
+	LatencyTimer timer;
+	latency_begin_always(&timer);
+
+	// insert every entry into a fresh table hashing with the new function
+	XtndblNHashTable *fresh = new_xtndbln_hash_table(table->bucketsize);
+	hasher_free(&fresh->hasher);
+	hasher_init_next(&fresh->hasher, &table->hasher);
+	fresh->nreseeds = table->nreseeds + 1;
+	fresh->reseeding = table->reseeding;
+
+	Cursor cursor = { 0 };
+	Entry *entry;
+	while ((entry = xtndbln_hash_table_iter_next(table, &cursor)) != NULL) {
+		insert_entry(fresh, entry->key, entry->value);
 	}
-	free(tmp_keys);
+
+	// swap the two tables' contents (except for the operation times, which
+	// stay with 'table'), then free the old contents
+	XtndblNHashTable old = *table;
+	*table = *fresh;
+	*fresh = old;
+	Latency latency = table->latency;
+	table->latency = fresh->latency;
+	fresh->latency = latency;
+	free_xtndbln_hash_table(fresh);
+
+	latency_end(&table->latency, &timer, OP_RESIZE);
 }
 
+// insert a new entry into 'table', assuming its key is not in there already
+static void insert_entry(XtndblNHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	// calculate table address (keeping the whole hash value, for the entry)
+	int64 full_hash = hasher_hash(&table->hasher, key);
+	int64 hash = HASH_FIRST(full_hash);
+	size64 address = rightmostnbits(table->depth, hash);
+
+	// make space in the table until our target bucket has space
+	int splits = 0;
+	while (table->buckets[address]->nkeys == table->bucketsize) {
+		// (unless the keys are colliding far too much: then start over with
+		// a new hash function)
+		if (colliding(table, address, ++splits)
+			&& table->reseeding < MAX_RESEEDS) {
+			table->reseeding++;
+			reseed_table(table);
+			insert_entry(table, key, value);
+			table->reseeding--;
+			return;
+		}
+
+		split_bucket(table, address);
+		// recalculate address because we might now need more bits
+		address = rightmostnbits(table->depth, hash);
+	}
+
+	// there's now space! we can insert this entry at the next avaliable
+	// position in the bucket
+	Bucket *bucket = table->buckets[address];
+	bucket->entries[bucket->nkeys].key = key;
+	bucket->entries[bucket->nkeys].value = value;
+	entry_set_hash(&bucket->entries[bucket->nkeys], full_hash);
+	bucket->nkeys++;
+	table->stats.nkeys++;
+}
+
+// state shared between the threads bulk loading a table: the table's
+// addresses are split into 'npartitions' contiguous ranges (npartitions is a
+// power of two), one per partition of keys
+typedef struct bulk_load {
+	XtndblNHashTable *table;
+	int npartitions;
+} BulkLoad;
+
+// which partition each of the 'n' keys in 'keys' belongs to while bulk
+// loading: the one containing its address
+static void key_partition(const int64 *keys, int *partition, int n,
+	void *arg) {
+	BulkLoad *bulk = arg;
+	XtndblNHashTable *table = bulk->table;
+	int64 hashes[HASH_BATCH];
+	hasher_hash_batch(&table->hasher, keys, hashes, n);
+
+	int i;
+	for (i = 0; i < n; i++) {
+		size64 address = rightmostnbits(table->depth, HASH_FIRST(hashes[i]));
+		partition[i] = address / (table->size / bulk->npartitions);
+	}
+}
+
+// task: create the buckets for partition 'p''s range of addresses (each one
+// already at full depth), and place the partition's keys into them. only this
+// thread touches these buckets, so no locking is needed. keys which find their
+// bucket full are left in the partition for later
+static void fill_partition(Partitions *partitions, int p, void *arg) {
+	BulkLoad *bulk = arg;
+	XtndblNHashTable *table = bulk->table;
+	int64 *keys = partitions->keys + partitions->starts[p];
+
+	size64 range = table->size / bulk->npartitions;
+	size64 a;
+	for (a = p * range; a < (p + 1) * range; a++) {
+		table->buckets[a] = new_bucket(a, table->depth, table->bucketsize);
+	}
+
+	int64 hashes[HASH_BATCH];
+	size64 i, left = 0;
+	for (i = 0; i < partitions->counts[p]; i++) {
+		// hash the keys a batch at a time
+		if (i % HASH_BATCH == 0) {
+			size64 n = partitions->counts[p] - i;
+			hasher_hash_batch(&table->hasher, keys + i, hashes,
+				(n < HASH_BATCH) ? n : HASH_BATCH);
+		}
+
+		int64 hash = HASH_FIRST(hashes[i % HASH_BATCH]);
+		size64 address = rightmostnbits(table->depth, hash);
+		Bucket *bucket = table->buckets[address];
+		if (bucket->nkeys < table->bucketsize) {
+			bucket->entries[bucket->nkeys].key = keys[i];
+			bucket->entries[bucket->nkeys].value = 0;
+			entry_set_hash(&bucket->entries[bucket->nkeys],
+				hashes[i % HASH_BATCH]);
+			bucket->nkeys++;
+		} else {
+			keys[left++] = keys[i];
+		}
+	}
+	partitions->counts[p] = left;
+}
+
+// find the value stored with 'key' inside 'table' (without timing it)
+// returns a pointer to the value, or NULL if 'key' is not in the table
+static int64 *find_value(XtndblNHashTable *table, int64 key) {
+	int i;
+
+	// calculate table address for this key
+	size64 address = rightmostnbits(table->depth, hash_key(table, key));
+	Bucket *bucket = table->buckets[address];
+
+	// search bucket
+	for (i=0; i<bucket->nkeys; i++) {
+		if (bucket->entries[i].key == key) {
+			return &bucket->entries[i].value;
+		}
+	}
+
+	// not found
+	return NULL;
+}
+
+
+// point each address of 'pointers', a table of 'size' bucket pointers using
+// 'depth' bits of the hash value, at its bucket among the 'nbuckets' buckets
+// in 'buckets', as loaded from 'snapshot' along with the id of the bucket each
+// address points to ('ids')
+// (each holding at most 'bucketsize' keys)
+// returns false if the buckets or ids are corrupt (recording so in 'snapshot')
+static bool link_buckets(Snapshot *snapshot, Bucket **pointers, size64 size,
+	int depth, Bucket *buckets, size64 nbuckets, size64 *ids,
+	int bucketsize) {
+	// first point each bucket's first address at it, then every other address
+	// at the same bucket as the first address it shares
+	size64 k;
+	for (k = 0; k < nbuckets; k++) {
+		size64 id = buckets[k].id;
+		if (id < 0 || id >= size || pointers[id] != NULL
+			|| buckets[k].depth < 0 || buckets[k].depth > depth
+			|| buckets[k].nkeys < 0 || buckets[k].nkeys > bucketsize) {
+			snapshot_fail(snapshot, "corrupt buckets");
+			return false;
+		}
+		pointers[id] = &buckets[k];
+	}
+	size64 i;
+	for (i = 0; i < size; i++) {
+		if (ids[i] < 0 || ids[i] > i || pointers[ids[i]] == NULL) {
+			snapshot_fail(snapshot, "corrupt table of bucket pointers");
+			return false;
+		}
+		pointers[i] = pointers[ids[i]];
+	}
+	return true;
+}
+
+
  /* * * *
   * all functions
   */
@@ -201,7 +480,61 @@ XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
 
 	table->stats.nbuckets = 1;
 	table->stats.nkeys = 0;
-	table->stats.time = 0;
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	latency_init(&table->latency);
+
+	table->snapshot = NULL;
+
+	return table;
+}
+
+
+
+// build a new table with 'bucketsize' keys per bucket containing the 'n' keys
+// in 'keys' (which may contain duplicates), sized up front to hold them all
+// without growing, and filled in parallel by 'nthreads' threads
+XtndblNHashTable *xtndbln_hash_table_bulk_load(int64 *keys, size64 n,
+	int bucketsize, int nthreads) {
+	XtndblNHashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->bucketsize = bucketsize;
+
+	// choose the depth so that every key could have SLOTS_PER_KEY slots, and
+	// start with one bucket per address (to be created by the threads)
+	table->depth = depth_for(n, bucketsize);
+	table->size = (size64) 1 << table->depth;
+	assert(table->size < MAX_TABLE_SIZE && "error: too many keys!");
+	table->buckets = huge_malloc((sizeof *table->buckets) * table->size);
+	assert(table->buckets);
+
+	table->stats.nbuckets = table->size;
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	latency_init(&table->latency);
+	table->snapshot = NULL;
+
+	// split the keys up by address range, and fill each range in parallel
+	int depth = ceil_log2(nthreads * PARTITIONS_PER_THREAD);
+	BulkLoad bulk = { .table = table,
+		.npartitions = 1 << (depth < table->depth ? depth : table->depth) };
+	Partitions *partitions = partition_keys(keys, n, bulk.npartitions,
+		key_partition, &bulk, nthreads);
+	size64 ndistinct = count_keys(partitions);
+	for_each_partition(partitions, fill_partition, &bulk);
+	table->stats.nkeys = ndistinct - count_keys(partitions);
+
+	// the few keys which found their bucket full go in normally (splitting)
+	size64 nleft;
+	int64 *left = remaining_keys(partitions, &nleft);
+	size64 i;
+	for (i = 0; i < nleft; i++) {
+		insert_entry(table, left[i], 0);
+	}
+	free(left);
+	free_partitions(partitions);
 
 	return table;
 }
@@ -214,11 +547,11 @@ void free_xtndbln_hash_table(XtndblNHashTable *table) {
 	// loop backwards through the array of pointers, freeing buckets only as we
 	// reach their first reference
 	// (if we loop through forwards, we wouldn't know which reference was last)
-	int i;
+	size64 i;
 	for (i = table->size-1; i >= 0; i--) {
 		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]->keys);
-			free(table->buckets[i]);
+			snapshot_release(table->snapshot, table->buckets[i]->entries);
+			snapshot_release(table->snapshot, table->buckets[i]);
 		}
 	}
 
@@ -226,40 +559,46 @@ void free_xtndbln_hash_table(XtndblNHashTable *table) {
 	free(table->buckets);
 
 	// free the table struct itself
+	hasher_free(&table->hasher);
+	latency_free(&table->latency);
 	free(table);
 }
 
 
+// make room in 'table' for 'nkeys' keys in total, without growing as they're
+// inserted
+void xtndbln_hash_table_reserve(XtndblNHashTable *table, size64 nkeys) {
+	assert(table);
+
+	// split buckets up front, then deepen the table of bucket pointers past
+	// them, so that buckets which overflow split without doubling it
+	int depth = depth_for(nkeys, table->bucketsize);
+	split_to_depth(table, depth);
+	depth = overflow_depth(nkeys, table->bucketsize, depth,
+		depth + RESERVE_SLACK);
+	while (table->depth < depth) {
+		double_table(table);
+	}
+}
+
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
 	assert(table);
 
-	int start_time = clock(); // start timing
-
-	// calculate table address
-	int hash = h1(key);
-	int address = rightmostnbits(table->depth, hash);
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
 
 	// check if key already in table
-	if (xtndbln_hash_table_lookup(table, key) == true) {
-		table->stats.time += clock() - start_time; // add time elapsed
+	if (find_value(table, key) != NULL) {
+		latency_end(&table->latency, &timer, OP_INSERT);
 		return false;
 	};
 
-	// if not, make space in the table until our target bucket has space
-	while (table->buckets[address]->nkeys == table->bucketsize) {
-		split_bucket(table, address);
-		// recalculate address because we might now need more bits
-		address = rightmostnbits(table->depth, hash);
-	}
-
-	// there's now space! we can insert this key at the next avaliable position
-	// in the bucket, record time and return
-	int nkeys = table->buckets[address]->nkeys += 1;
-	table->buckets[address]->keys[nkeys-1] = key;
-	table->stats.nkeys++;
-	table->stats.time += clock() - start_time;
+	// if not, insert it with an empty value, record time and return
+	insert_entry(table, key, 0);
+	latency_end(&table->latency, &timer, OP_INSERT);
 	return true;
 }
 
@@ -267,28 +606,187 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
+	return xtndbln_hash_table_get(table, key) != NULL;
+}
+
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key, int64 value) {
 	assert(table);
 
-	int start_time = clock(); // start timing
-	int i;
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
 
-	// calculate table address for this key
-	int address = rightmostnbits(table->depth, h1(key));
-
-	// check if destination bucket is occupied
-	if (table->buckets[address]->nkeys > 0) {
-		// search bucket
-		for (i=0; i<table->buckets[address]->nkeys; i++) {
-			// if found record time and return true
-			if (table->buckets[address]->keys[i] == key) {
-				table->stats.time += clock() - start_time;
-				return true;
+	// if key already in table just replace its value
+	int64 *stored = find_value(table, key);
+	if (stored != NULL) {
+		*stored = value;
+		latency_end(&table->latency, &timer, OP_INSERT);
+		return false;
+	}
+
+	insert_entry(table, key, value);
+	latency_end(&table->latency, &timer, OP_INSERT);
+	return true;
+}
+
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *xtndbln_hash_table_get(XtndblNHashTable *table, int64 key) {
+	assert(table);
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	int64 *value = find_value(table, key);
+
+	latency_end(&table->latency, &timer, value ? OP_HIT : OP_MISS);
+	return value;
+}
+
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *xtndbln_hash_table_iter_next(XtndblNHashTable *table, Cursor *cursor) {
+	assert(table);
+	assert(cursor);
+
+	// many addresses can point to the same bucket, so only look at each bucket
+	// from its first address (its id)
+	while (cursor->address < table->size) {
+		Bucket *bucket = table->buckets[cursor->address];
+		if (bucket->id == cursor->address && cursor->index < bucket->nkeys) {
+			return &bucket->entries[cursor->index++];
+		}
+
+		// this bucket is done (or was already visited), move on to the next
+		cursor->address++;
+		cursor->index = 0;
+	}
+
+	// no more buckets left
+	return NULL;
+}
+
+
+// write the contents of 'table' to 'file', in a layout that
+// xtndbln_hash_table_load() can use in place
+void xtndbln_hash_table_save(XtndblNHashTable *table, FILE *file) {
+	assert(table);
+	assert(file);
+
+	// the sizes, statistics and hash function first
+	size64 sizes[3] = {table->size, table->depth, table->bucketsize};
+	snapshot_write(file, sizes, sizeof sizes);
+	snapshot_write(file, &table->stats, sizeof table->stats);
+	snapshot_write_hasher(file, &table->hasher);
+
+	// each distinct bucket, in order of their ids
+	size64 i;
+	for (i = 0; i < table->size; i++) {
+		Bucket *bucket = table->buckets[i];
+		if (bucket->id == i) {
+			snapshot_write(file, bucket, sizeof *bucket);
+		}
+	}
+
+	// then each bucket's entries (padded out to a full bucket, so that bucket
+	// k's entries always start at k * bucketsize)
+	Entry empty = { .key = 0, .value = 0 };
+	for (i = 0; i < table->size; i++) {
+		Bucket *bucket = table->buckets[i];
+		if (bucket->id == i) {
+			snapshot_write(file, bucket->entries,
+				(sizeof *bucket->entries) * bucket->nkeys);
+			int j;
+			for (j = bucket->nkeys; j < table->bucketsize; j++) {
+				snapshot_write(file, &empty, sizeof empty);
 			}
 		}
 	}
-	// not found, record time and return false
-	table->stats.time += clock() - start_time;
-	return false;
+
+	// and finally the table of bucket pointers, with each pointer replaced by
+	// the id of the bucket it points to
+	size64 *ids = malloc((sizeof *ids) * table->size);
+	assert(ids);
+	for (i = 0; i < table->size; i++) {
+		ids[i] = table->buckets[i]->id;
+	}
+	snapshot_write(file, ids, (sizeof *ids) * table->size);
+	free(ids);
+}
+
+
+// create a table from the next part of 'snapshot' (as written by
+// xtndbln_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+XtndblNHashTable *xtndbln_hash_table_load(Snapshot *snapshot) {
+	assert(snapshot);
+
+	size64 *sizes = snapshot_read(snapshot, 3 * sizeof *sizes);
+	Stats *stats = snapshot_read(snapshot, sizeof *stats);
+	if (sizes == NULL || stats == NULL) {
+		return NULL;
+	}
+	size64 size = sizes[0], depth = sizes[1], bucketsize = sizes[2];
+	size64 nbuckets = stats->nbuckets;
+	if (depth < 0 || depth > 62 || size != (1LL << depth)
+		|| nbuckets <= 0 || nbuckets > size
+		|| bucketsize <= 0 || bucketsize > INT_MAX) {
+		return snapshot_fail(snapshot, "corrupt table sizes");
+	}
+
+	Hasher hasher;
+	if (!snapshot_read_hasher(snapshot, &hasher)) {
+		return NULL;
+	}
+
+	// use the buckets inside the snapshot in place, pointing each bucket at
+	// its entries (which follow the buckets), and rebuild the table of bucket
+	// pointers from the bucket ids
+	Bucket *buckets = snapshot_read_array(snapshot, nbuckets, sizeof *buckets);
+	Entry *entries = snapshot_read_array(snapshot, nbuckets,
+		(sizeof *entries) * bucketsize);
+	size64 *ids = snapshot_read_array(snapshot, size, sizeof *ids);
+	Bucket **pointers = NULL;
+	if (ids != NULL) {
+		size64 k;
+		for (k = 0; k < nbuckets; k++) {
+			buckets[k].entries = entries + k * bucketsize;
+		}
+		pointers = huge_calloc(size, sizeof *pointers);
+		assert(pointers);
+		if (!link_buckets(snapshot, pointers, size, depth, buckets, nbuckets,
+			ids, bucketsize)) {
+			free(pointers);
+			pointers = NULL;
+		}
+	}
+	if (pointers == NULL) {
+		hasher_free(&hasher);
+		return NULL;
+	}
+
+	XtndblNHashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->buckets = pointers;
+	table->size = size;
+	table->depth = depth;
+	table->bucketsize = bucketsize;
+	memcpy(&table->stats, stats, sizeof table->stats);
+	table->hasher = hasher;
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	latency_init(&table->latency);
+	table->snapshot = snapshot;
+
+	return table;
 }
 
 
@@ -296,27 +794,28 @@ bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
 void xtndbln_hash_table_print(XtndblNHashTable *table) {
 	assert(table);
 
-	printf("--- table size: %d\n", table->size);
+	printf("--- table size: %lld\n", (long long) table->size);
 
 	// print header
 	printf("  table:               buckets:\n");
 	printf("  address | bucketid   bucketid [key]\n");
 
 	// print table and buckets
-	int i;
+	size64 i;
 	for (i = 0; i < table->size; i++) {
 		// table entry
-		printf("%9d | %-9d ", i, table->buckets[i]->id);
+		printf("%9lld | %-9lld ", (long long) i,
+			(long long) table->buckets[i]->id);
 
 		// if this is the first address at which a bucket occurs, print it now
 		if (table->buckets[i]->id == i) {
-			printf("%9d ", table->buckets[i]->id);
+			printf("%9lld ", (long long) table->buckets[i]->id);
 
 			// print the bucket's contents
 			printf("[");
 			for(int j = 0; j < table->bucketsize; j++) {
 				if (j < table->buckets[i]->nkeys) {
-					printf(" %llu", table->buckets[i]->keys[j]);
+					printf(" %llu", table->buckets[i]->entries[j].key);
 				} else {
 					printf(" -");
 				}
@@ -331,6 +830,43 @@ void xtndbln_hash_table_print(XtndblNHashTable *table) {
 }
 
 
+// how full 'table' is: the fraction of its key slots currently holding a key
+double xtndbln_hash_table_load_factor(XtndblNHashTable *table) {
+	assert(table);
+
+	size64 nslots = table->stats.nbuckets * table->bucketsize;
+	return (double) table->stats.nkeys / nslots;
+}
+
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage xtndbln_hash_table_memory_usage(XtndblNHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = { 0 };
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+	memory_count(&usage, &usage.directory, table->buckets,
+		(sizeof *table->buckets) * table->size, table->snapshot);
+
+	// count each bucket once, at its first address
+	size64 address;
+	for (address = 0; address < table->size; address++) {
+		Bucket *bucket = table->buckets[address];
+		if (bucket->id == address) {
+			memory_count(&usage, &usage.headers, bucket, sizeof *bucket,
+				table->snapshot);
+			memory_count(&usage, &usage.entries, bucket->entries,
+				(sizeof *bucket->entries) * table->bucketsize,
+				table->snapshot);
+		}
+	}
+	memory_count_hasher(&usage, &table->hasher);
+	latency_memory_usage(&table->latency, &usage);
+	return usage;
+}
+
+
 // print some statistics about 'table' to stdout
 void xtndbln_hash_table_stats(XtndblNHashTable *table) {
 	assert(table);
@@ -340,14 +876,22 @@ void xtndbln_hash_table_stats(XtndblNHashTable *table) {
 	printf("--- table stats ---\n");
 
 	// print some stats about state of the table
-	printf("current table size: %d\n", table->size);
-	printf("    number of keys: %d\n", table->stats.nkeys);
-	printf("    number of buckets: %d\n", table->stats.nbuckets);
+	printf("current table size: %lld\n", (long long) table->size);
+	printf("    number of keys: %lld\n", (long long) table->stats.nkeys);
+	printf("    number of buckets: %lld\n",
+		(long long) table->stats.nbuckets);
+	printf("    rehashed with a new seed: %d times\n", table->nreseeds);
 	printf("    load factor: %.2f%%\n", load_factor);
 
-	// also calculate CPU usage in seconds and print this
-	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
-	printf("CPU time spent: %.6f sec\n", seconds);
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_total(xtndbln_hash_table_memory_usage(table));
+	printf("    memory used: %zu bytes\n", bytes);
+	if (table->stats.nkeys > 0) {
+		printf("    per entry: %.2f bytes\n", bytes * 1.0 / table->stats.nkeys);
+	}
+
+	// and how long operations have been taking
+	latency_print(&table->latency);
 
 	printf("--- end stats ---\n");
 }
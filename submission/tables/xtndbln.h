@@ -10,16 +10,32 @@
 #define XTNDBLN_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "../inthash.h"
+#include "../snapshot.h"
+#include "../memusage.h"
 
 typedef struct xtndbln_table XtndblNHashTable;
 
 // initialise an extendible hash table with 'bucketsize' keys per bucket
 XtndblNHashTable *new_xtndbln_hash_table(int bucketsize);
 
+// build a new table with 'bucketsize' keys per bucket containing the 'n' keys
+// in 'keys' (which may contain duplicates), sized up front to hold them all
+// without growing, and filled in parallel by 'nthreads' threads
+XtndblNHashTable *xtndbln_hash_table_bulk_load(int64 *keys, size64 n,
+	int bucketsize, int nthreads);
+
 // free all memory associated with 'table'
 void free_xtndbln_hash_table(XtndblNHashTable *table);
 
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), splitting buckets and deepening the table of bucket pointers past
+// them, so that inserting that many keys splits few buckets and does no
+// doubling (unless keys share long runs of hash value bits). never shrinks
+// the table
+void xtndbln_hash_table_reserve(XtndblNHashTable *table, size64 nkeys);
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key);
@@ -28,6 +44,39 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key);
 // returns true if found, false if not
 bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key);
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key, int64 value);
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *xtndbln_hash_table_get(XtndblNHashTable *table, int64 key);
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *xtndbln_hash_table_iter_next(XtndblNHashTable *table, Cursor *cursor);
+
+// write the contents of 'table' to 'file', in a layout that
+// xtndbln_hash_table_load() can use in place
+void xtndbln_hash_table_save(XtndblNHashTable *table, FILE *file);
+
+// create a table from the next part of 'snapshot' (as written by
+// xtndbln_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+XtndblNHashTable *xtndbln_hash_table_load(Snapshot *snapshot);
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double xtndbln_hash_table_load_factor(XtndblNHashTable *table);
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage xtndbln_hash_table_memory_usage(XtndblNHashTable *table);
+
 // print the contents of 'table' to stdout
 void xtndbln_hash_table_print(XtndblNHashTable *table);
 
@@ -11,28 +11,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <time.h>
+#include <string.h>  // for memcpy
 
 #include "xuckoo.h"
+#include "bulk.h"
+#include "../hugemem.h"
+#include "../latency.h"
 
 // macro to calculate the rightmost n bits of a number x
-#define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
-
-// a bucket stores a single key (full=true) or is empty (full=false)
+#define rightmostnbits(n, x) ((size64) ((x) & (((int64) 1 << (n)) - 1)))
+
+// an insertion that cuckoos keys around more than MAX_STEPS times, or has to
+// grow an inner table more than DEPTH_SLACK bits deeper than random hash
+// values would need for its buckets, has met keys sharing far more hash value
+// bits than random hash values ever would (by accident, or by design), so the
+// table is rebuilt with a new seed instead. up to MAX_RESEEDS rebuilds can be
+// under way at once (each interrupted by the next), after which the table
+// splits as usual
+#define MAX_STEPS 32
+#define DEPTH_SLACK 4
+#define MAX_RESEEDS 4
+
+// reserving room deepens the table of bucket pointers up to RESERVE_SLACK bits
+// past the buckets it splits, so that buckets which overflow later can split
+// without doubling it. random keys would need about twice as many bits as
+// the buckets do before no two of them shared every bit, far more than is
+// worth allocating up front, so single-key buckets settle for a few
+#define RESERVE_SLACK 4
+
+// a bucket stores a single key and its value (full=true) or is empty
+// (full=false)
 // it also knows how many bits are shared between possible keys, and the first
 // table address that references it
 typedef struct bucket {
-	int id;		// a unique id for this bucket, equal to the first address
+	size64 id;	// a unique id for this bucket, equal to the first address
 				// in the table which points to it
 	int depth;	// how many hash value bits are being used by this bucket
 	bool full;	// does this bucket contain a key
-	int64 key;	// the key stored in this bucket
+	Entry entry;// the key stored in this bucket, along with its value
 } Bucket;
 
 // helper structure to store statistics gathered
 typedef struct stats {
-	int nbuckets;	// how many distinct buckets does the table point to
-	int nkeys;		// how many keys are being stored in the table
+	size64 nbuckets;	// how many distinct buckets does the table point to
+	size64 nkeys;		// how many keys are being stored in the table
 } Stats;
 
 // an inner table is an extendible hash table with an array of slots pointing
@@ -40,17 +62,21 @@ typedef struct stats {
 // of hash value bits to use for addressing
 typedef struct inner_table {
 	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	size64 size;		// how many entries in the table of pointers (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
 	Stats stats;
+	Hasher *hasher;		// the hash function of the table this is part of
 } InnerTable;
 
 // a xuckoo hash table is just two inner tables for storing inserted keys
 struct xuckoo_table {
 	InnerTable *table1;
 	InnerTable *table2;
-	int time;          // how much CPU time has been used to insert/lookup keys
-					   // in this table
+	Hasher hasher;     // hash function giving each key a hash value for both
+	int nreseeds;      // how many times it has been given a new seed
+	int reseeding;     // how many rebuilds with a new seed are under way
+	Latency latency;   // how long operations on this table have been taking
+	Snapshot *snapshot;// snapshot the buckets were loaded from (or NULL)
 };
 
 
@@ -58,9 +84,15 @@ struct xuckoo_table {
  * helper functions
  */
 
+// which of the two hash values taken from 'hash' (see HASH_FIRST and
+// HASH_SECOND) inner table 'table_num' (1 or 2) uses
+static int64 hash_half(int table_num, int64 hash) {
+	return (table_num == 1) ? HASH_FIRST(hash) : HASH_SECOND(hash);
+}
+
  // create a new bucket first referenced from 'first_address', based on 'depth'
  // bits of its keys' hash values
-static Bucket *new_bucket(int first_address, int depth) {
+static Bucket *new_bucket(size64 first_address, int depth) {
 	Bucket *bucket = malloc(sizeof *bucket);
 	assert(bucket);
 
@@ -73,18 +105,23 @@ static Bucket *new_bucket(int first_address, int depth) {
 
 
 // double the table of bucket pointers, duplicating the bucket pointers in the
-// first half into the new second half of the table
-static void double_table(InnerTable *inner_table) {
+// first half into the new second half of the table, and recording how long it
+// took in 'latency'
+static void double_table(InnerTable *inner_table, Latency *latency) {
 	assert(inner_table);
 
-	int size = inner_table->size * 2;
+	size64 size = inner_table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: inner_table has grown too large!");
 
+	LatencyTimer timer;
+	latency_begin_always(&timer);
+
 	// get a new array of twice as many bucket pointers, and copy pointers down
-	inner_table->buckets = realloc(inner_table->buckets,
-								  (sizeof *inner_table->buckets) * size);
+	inner_table->buckets = huge_realloc(inner_table->buckets,
+		(sizeof *inner_table->buckets) * inner_table->size,
+		(sizeof *inner_table->buckets) * size);
 	assert(inner_table->buckets);
-	int i;
+	size64 i;
 	for (i = 0; i < inner_table->size; i++) {
 		inner_table->buckets[inner_table->size + i] = inner_table->buckets[i];
 	}
@@ -92,35 +129,39 @@ static void double_table(InnerTable *inner_table) {
 	// finally, increase the table size and the depth we are using to hash keys
 	inner_table->size = size;
 	inner_table->depth++;
+
+	latency_end(latency, &timer, OP_RESIZE);
 }
 
 
-// reinsert a key into the hash table after splitting a bucket --- we can assume
-// that there will definitely be space for this key because it was already
-// inside the hash table previously
+// reinsert an entry into the hash table after splitting a bucket --- we can
+// assume that there will definitely be space for this key because it was
+// already inside the hash table previously
 // use 'xtndbl1_hash_table_insert()' instead for inserting new keys
-static void reinsert_key(InnerTable *inner_table, int64 key, int table_num) {
+static void reinsert_entry(InnerTable *inner_table, Entry entry,
+	int table_num) {
 	assert(inner_table);
 
 	// use correct hash function depending on which table we're inserting into
-	int hash = (table_num == 1) ? h1(key): h2(key);
+	int64 hash = hash_half(table_num, entry_hash(inner_table->hasher, &entry));
 
-	int address = rightmostnbits(inner_table->depth, hash);
-	inner_table->buckets[address]->key = key;
+	size64 address = rightmostnbits(inner_table->depth, hash);
+	inner_table->buckets[address]->entry = entry;
 	inner_table->buckets[address]->full = true;
 }
 
 
 // split the bucket in 'table' table_num at address 'address', growing table
-// if necessary
-static void split_bucket(InnerTable *inner_table, int address, int table_num) {
+// if necessary (recording how long that took in 'latency')
+static void split_bucket(InnerTable *inner_table, size64 address,
+	int table_num, Latency *latency) {
 	assert(inner_table);
 
 	// FIRST,
 	// do we need to grow the table?
 	if (inner_table->buckets[address]->depth == inner_table->depth) {
 		// yep, this bucket is down to its last pointer
-		double_table(inner_table);
+		double_table(inner_table, latency);
 	}
 	// either way, now it's time to split this bucket
 
@@ -129,13 +170,13 @@ static void split_bucket(InnerTable *inner_table, int address, int table_num) {
 	// create a new bucket and update both buckets' depth
 	Bucket *bucket = inner_table->buckets[address];
 	int depth = bucket->depth;
-	int first_address = bucket->id;
+	size64 first_address = bucket->id;
 
 	int new_depth = depth + 1;
 	bucket->depth = new_depth;
 
 	// new bucket's first address will be a 1 bit plus the old first address
-	int new_first_address = 1 << depth | first_address;
+	size64 new_first_address = (size64) 1 << depth | first_address;
 	Bucket *newbucket = new_bucket(new_first_address, new_depth);
 	inner_table->stats.nbuckets++;
 
@@ -145,19 +186,19 @@ static void split_bucket(InnerTable *inner_table, int address, int table_num) {
 	// (defined below)
 
 	// suffix: a 1 bit followed by the previous bucket bit address
-	int bit_address = rightmostnbits(depth, first_address);
-	int suffix = (1 << depth) | bit_address;
+	size64 bit_address = rightmostnbits(depth, first_address);
+	size64 suffix = ((size64) 1 << depth) | bit_address;
 
 	// prefix: all bitstrings of length equal to the difference between the new
 	// bucket depth and the table depth
 	// use a for loop to enumerate all possible prefixes less than maxprefix:
-	int maxprefix = 1 << (inner_table->depth - new_depth);
+	size64 maxprefix = (size64) 1 << (inner_table->depth - new_depth);
 
-	int prefix;
+	size64 prefix;
 	for (prefix = 0; prefix < maxprefix; prefix++) {
 
 		// construct address by joining this prefix and the suffix
-		int a = (prefix << new_depth) | suffix;
+		size64 a = (prefix << new_depth) | suffix;
 
 		// redirect this table entry to point at the new bucket
 		inner_table->buckets[a] = newbucket;
@@ -167,15 +208,42 @@ static void split_bucket(InnerTable *inner_table, int address, int table_num) {
 	// filter the key from the old bucket into its rightful place in the new
 	// table (which may be the old bucket, or may be the new bucket)
 
-	// remove and reinsert the key
-	int64 key = bucket->key;
-	bucket->full = false;
-	reinsert_key(inner_table, key, table_num);
+	// remove and reinsert the key (along with its value), if there is one
+	if (bucket->full) {
+		Entry entry = bucket->entry;
+		bucket->full = false;
+		reinsert_entry(inner_table, entry, table_num);
+	}
 }
 
+// grow 'inner_table' to 2^'depth' addresses (if it's smaller), and split
+// buckets until each uses at least 'depth' bits (recording how long growing
+// took in 'latency')
+static void split_to_depth(InnerTable *inner_table, int depth,
+	int table_num, Latency *latency) {
+	assert(inner_table);
+
+	while (inner_table->depth < depth) {
+		double_table(inner_table, latency);
+	}
+
+	size64 address;
+	for (address = 0; address < inner_table->size; address++) {
+		while (inner_table->buckets[address]->depth < depth) {
+			split_bucket(inner_table, address, table_num, latency);
+		}
+	}
+}
 
-// init a new inner_table
-static InnerTable *new_inner_table() {
+// how many bits of hash value to use for inner tables sized up front to hold
+// 'nkeys' keys, giving each key a bucket in each inner table
+static int depth_for(size64 nkeys) {
+	return ceil_log2(nkeys > 0 ? nkeys : 1);
+}
+
+
+// init a new inner_table, part of a table hashing with 'hasher'
+static InnerTable *new_inner_table(Hasher *hasher) {
 	// init new InnerTable
 	InnerTable *inner_table = malloc((sizeof *inner_table));
 	assert(inner_table);
@@ -188,22 +256,25 @@ static InnerTable *new_inner_table() {
 
 	inner_table->stats.nbuckets = 1;
 	inner_table->stats.nkeys = 0;
+	inner_table->hasher = hasher;
 
 	return inner_table;
 }
 
 
-// free all memory associated with the inner table
-static void free_inner_table(InnerTable *inner_table) {
+// free all memory associated with the inner table (except for any buckets
+// living inside 'snapshot')
+static void free_inner_table(InnerTable *inner_table,
+	Snapshot *snapshot) {
 	assert(inner_table);
 
 	// loop backwards through the array of pointers, freeing buckets only as we
 	// reach their first reference
 	// (if we loop through forwards, we wouldn't know which reference was last)
-	int i;
+	size64 i;
 	for (i = inner_table->size-1; i >= 0; i--) {
 		if (inner_table->buckets[i]->id == i) {
-			free(inner_table->buckets[i]);
+			snapshot_release(snapshot, inner_table->buckets[i]);
 		}
 	}
 
@@ -215,51 +286,77 @@ static void free_inner_table(InnerTable *inner_table) {
 }
 
 
-/* * * *
- * all functions
- */
+static void insert_entry(XuckooHashTable *table, Entry entry);
 
-// initialise an extendible cuckoo hash table
-XuckooHashTable *new_xuckoo_hash_table() {
-	// create new table
-	XuckooHashTable *table = malloc(sizeof *table);
+// give 'table' a new hash function and rebuild it around its keys, after an
+// insertion found them colliding pathologically (the caller counts the
+// rebuild in table->reseeding)
+static void reseed_table(XuckooHashTable *table) {
 	assert(table);
 
-	// create new inner tables
-	table->table1 = new_inner_table();
-	table->table2 = new_inner_table();
+	LatencyTimer timer;
+	latency_begin_always(&timer);
 
-	table->time = 0;
-
-	return table;
-}
+	// insert every entry into a fresh table hashing with the new function
+	XuckooHashTable *fresh = new_xuckoo_hash_table();
+	hasher_free(&fresh->hasher);
+	hasher_init_next(&fresh->hasher, &table->hasher);
+	fresh->nreseeds = table->nreseeds + 1;
+	fresh->reseeding = table->reseeding;
 
+	Cursor cursor = { 0 };
+	Entry *entry;
+	while ((entry = xuckoo_hash_table_iter_next(table, &cursor)) != NULL) {
+		insert_entry(fresh, *entry);
+	}
 
-// free all memory associated with 'table'
-void free_xuckoo_hash_table(XuckooHashTable *table) {
-	assert(table);
+	// swap the two tables' contents (except for the operation times, which
+	// stay with 'table'), pointing each inner table back at the hash function
+	// of the table it's now part of, then free the old contents
+	XuckooHashTable old = *table;
+	*table = *fresh;
+	*fresh = old;
+	Latency latency = table->latency;
+	table->latency = fresh->latency;
+	fresh->latency = latency;
+	table->table1->hasher = table->table2->hasher = &table->hasher;
+	fresh->table1->hasher = fresh->table2->hasher = &fresh->hasher;
+	free_xuckoo_hash_table(fresh);
+
+	latency_end(&table->latency, &timer, OP_RESIZE);
+}
 
-	free_inner_table(table->table1);
-	free_inner_table(table->table2);
+// has an insertion that has cuckoo'd keys around 'steps' times, and now has
+// to split the bucket at 'address' in 'inner_table', met keys colliding far
+// too much?
+static bool colliding(InnerTable *inner_table, size64 address, int steps) {
+	if (steps > MAX_STEPS) {
+		return true;
+	}
+	if (inner_table->buckets[address]->depth < inner_table->depth) {
+		// the inner table needn't grow
+		return false;
+	}
 
-	free(table);
+	// random hash values need about 2 log2(nbuckets) bits to give each
+	// single-key bucket its own address
+	int depth = 2 * ceil_log2(inner_table->stats.nbuckets);
+	return inner_table->depth >= depth + DEPTH_SLACK;
 }
 
-
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
+// cuckoo 'entry' into 'table', assuming its key is not in there already,
+// splitting buckets whenever we collide
+static void insert_entry(XuckooHashTable *table, Entry entry) {
 	assert(table);
 
-	int start_time = clock();  // start timing
-	int hash, address;
-	int64 next_key;
+	int64 hash;
+	size64 address;
+	Entry next_entry;
 
-	// is key already in table?
-	if (xuckoo_hash_table_lookup(table, key) == true) {
-		table->time += clock() - start_time;  // add time elapsed
-		return false;
-	}
+	// the entry we're holding may be new, or hashed with an old hash
+	// function, so work its hash value out afresh (entries cuckoo'd out
+	// along the way already know theirs)
+	entry_set_hash(&entry, hasher_hash(&table->hasher, entry.key));
 
 	// choose table 2 as first to try if it has less keys than table 1,
 	// else choose table 1 as first table to try
@@ -272,34 +369,42 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
 
 	InnerTable *cur_table;
 	bool key_to_insert=true;
-	// we're not using the -ive number space so a valid key will never be -1.
-	// we can set key to -1 at any time in the loop and be assured it will not
-	// run again
+	int steps = 0;
+	// keep going until we mark that we don't have anymore keys to insert
 	while (key_to_insert) {
 		// setup values depending on table we're going to try to insert into
-		if (cur_table_num == 1) {
-			cur_table = table->table1;
-			hash = h1(key);
-		} else {
-			cur_table = table->table2;
-			hash = h2(key);
-		}
+		cur_table = (cur_table_num == 1) ? table->table1 : table->table2;
+		hash = hash_half(cur_table_num, entry_hash(&table->hasher, &entry));
 
 		// get address of where key should sit in the table
 		address = rightmostnbits(cur_table->depth, hash);
 
+		// if there's a collision and the keys are colliding far too much,
+		// start over with a new hash function (and the key we're holding)
+		steps++;
+		if (cur_table->buckets[address]->full
+			&& colliding(cur_table, address, steps)
+			&& table->reseeding < MAX_RESEEDS) {
+			table->reseeding++;
+			reseed_table(table);
+			insert_entry(table, entry);
+			table->reseeding--;
+			return;
+		}
+
 		// if there's a collisions split the bucket
 		if (cur_table->buckets[address]->full) {
-			split_bucket(cur_table, address, cur_table_num);
+			split_bucket(cur_table, address, cur_table_num,
+				&table->latency);
 			// recalculate address because we might now need more bits
 			address = rightmostnbits(cur_table->depth, hash);
 		}
 
-		// if destination slot is occupied need save it's val before moving on
-		// so we can rehash it. else prepare loop to break and cur_table to
+		// if destination slot is occupied need save it's entry before moving
+		// on so we can rehash it. else prepare loop to break and cur_table to
 		// get the empty slot occupied
 		if (cur_table->buckets[address]->full) {
-			next_key = cur_table->buckets[address]->key;
+			next_entry = cur_table->buckets[address]->entry;
 		} else {
 			cur_table->buckets[address]->full = true;
 			cur_table->stats.nkeys++;
@@ -307,52 +412,527 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
 			key_to_insert = false;
 		}
 
-		// insert key into it's desired slot
-		cur_table->buckets[address]->key = key;
+		// insert entry into it's desired slot
+		cur_table->buckets[address]->entry = entry;
 
-		// set key to next key (if any)
-		key = next_key;
+		// set entry to next entry (if any)
+		entry = next_entry;
 
 		// alternate between inserting into table 1 and 2
 		cur_table_num = (cur_table_num == 1) ? 2: 1;
 	}
-	table->time += clock() - start_time;  // add time elapsed
+}
+
+
+// count the memory 'inner_table' is currently using towards 'usage' (any
+// buckets inside 'snapshot' were never allocated)
+static void count_memory_usage(InnerTable *inner_table, MemoryUsage *usage,
+	Snapshot *snapshot) {
+	assert(inner_table);
+
+	memory_count(usage, &usage->overhead, inner_table, sizeof *inner_table,
+		NULL);
+	memory_count(usage, &usage->directory, inner_table->buckets,
+		(sizeof *inner_table->buckets) * inner_table->size, snapshot);
+
+	// count each bucket once, at its first address
+	size64 address;
+	for (address = 0; address < inner_table->size; address++) {
+		Bucket *bucket = inner_table->buckets[address];
+		if (bucket->id == address) {
+			memory_count(usage, &usage->headers, bucket, sizeof *bucket,
+				snapshot);
+			// the entry itself lives inside the bucket
+			usage->headers -= sizeof bucket->entry;
+			usage->entries += sizeof bucket->entry;
+		}
+	}
+}
+
+
+// write the contents of 'inner_table' to 'file', in a layout that
+// load_inner_table() can use in place
+static void save_inner_table(InnerTable *inner_table, FILE *file) {
+	assert(inner_table);
+
+	// the sizes and statistics first
+	size64 sizes[2] = {inner_table->size, inner_table->depth};
+	snapshot_write(file, sizes, sizeof sizes);
+	snapshot_write(file, &inner_table->stats, sizeof inner_table->stats);
+
+	// each distinct bucket, in order of their ids
+	size64 i;
+	for (i = 0; i < inner_table->size; i++) {
+		Bucket *bucket = inner_table->buckets[i];
+		if (bucket->id == i) {
+			snapshot_write(file, bucket, sizeof *bucket);
+		}
+	}
+
+	// and finally the table of bucket pointers, with each pointer replaced by
+	// the id of the bucket it points to
+	size64 *ids = malloc((sizeof *ids) * inner_table->size);
+	assert(ids);
+	for (i = 0; i < inner_table->size; i++) {
+		ids[i] = inner_table->buckets[i]->id;
+	}
+	snapshot_write(file, ids, (sizeof *ids) * inner_table->size);
+	free(ids);
+}
+
+
+// point each address of 'pointers', a table of 'size' bucket pointers using
+// 'depth' bits of the hash value, at its bucket among the 'nbuckets' buckets
+// in 'buckets', as loaded from 'snapshot' along with the id of the bucket each
+// address points to ('ids')
+// returns false if the buckets or ids are corrupt (recording so in 'snapshot')
+static bool link_buckets(Snapshot *snapshot, Bucket **pointers, size64 size,
+	int depth, Bucket *buckets, size64 nbuckets, size64 *ids) {
+	// first point each bucket's first address at it, then every other address
+	// at the same bucket as the first address it shares
+	size64 k;
+	for (k = 0; k < nbuckets; k++) {
+		size64 id = buckets[k].id;
+		if (id < 0 || id >= size || pointers[id] != NULL
+			|| buckets[k].depth < 0 || buckets[k].depth > depth) {
+			snapshot_fail(snapshot, "corrupt buckets");
+			return false;
+		}
+		pointers[id] = &buckets[k];
+	}
+	size64 i;
+	for (i = 0; i < size; i++) {
+		if (ids[i] < 0 || ids[i] > i || pointers[ids[i]] == NULL) {
+			snapshot_fail(snapshot, "corrupt table of bucket pointers");
+			return false;
+		}
+		pointers[i] = pointers[ids[i]];
+	}
 	return true;
 }
 
 
-// lookup whether 'key' is inside 'table'
-// returns true if found, false if not
-bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key) {
-	assert(table);
+// create an inner table, part of a table hashing with 'hasher', from the next
+// part of 'snapshot', using the buckets inside the snapshot in place
+// returns NULL if the snapshot is truncated or corrupt
+static InnerTable *load_inner_table(Snapshot *snapshot, Hasher *hasher) {
+	assert(snapshot);
+
+	size64 *sizes = snapshot_read(snapshot, 2 * sizeof *sizes);
+	Stats *stats = snapshot_read(snapshot, sizeof *stats);
+	if (sizes == NULL || stats == NULL) {
+		return NULL;
+	}
+	size64 size = sizes[0], depth = sizes[1], nbuckets = stats->nbuckets;
+	if (depth < 0 || depth > 62 || size != (1LL << depth)
+		|| nbuckets <= 0 || nbuckets > size) {
+		return snapshot_fail(snapshot, "corrupt table sizes");
+	}
 
-	int start_time = clock(); // start timing
+	// use the buckets inside the snapshot in place, and rebuild the table of
+	// bucket pointers from the bucket ids
+	Bucket *buckets = snapshot_read_array(snapshot, nbuckets, sizeof *buckets);
+	size64 *ids = snapshot_read_array(snapshot, size, sizeof *ids);
+	if (ids == NULL) {
+		return NULL;
+	}
+	Bucket **pointers = huge_calloc(size, sizeof *pointers);
+	assert(pointers);
+	if (!link_buckets(snapshot, pointers, size, depth, buckets, nbuckets,
+		ids)) {
+		free(pointers);
+		return NULL;
+	}
 
-	// calculate the address for this key in table 1
-	int address = rightmostnbits(table->table1->depth, h1(key));
+	InnerTable *inner_table = malloc(sizeof *inner_table);
+	assert(inner_table);
+	inner_table->buckets = pointers;
+	inner_table->size = size;
+	inner_table->depth = depth;
+	memcpy(&inner_table->stats, stats, sizeof inner_table->stats);
+	inner_table->hasher = hasher;
+
+	return inner_table;
+}
+
+// init a new inner_table with 2^depth addresses, each of which will be given
+// its own bucket (by the threads bulk loading it), part of a table hashing
+// with 'hasher'
+static InnerTable *new_sized_inner_table(int depth, Hasher *hasher) {
+	InnerTable *inner_table = malloc((sizeof *inner_table));
+	assert(inner_table);
+	inner_table->depth = depth;
+	inner_table->size = (size64) 1 << depth;
+	assert(inner_table->size < MAX_TABLE_SIZE && "error: too many keys!");
+
+	inner_table->buckets = huge_malloc((sizeof *inner_table->buckets)
+		* inner_table->size);
+	assert(inner_table->buckets);
+
+	inner_table->stats.nbuckets = inner_table->size;
+	inner_table->stats.nkeys = 0;
+	inner_table->hasher = hasher;
+
+	return inner_table;
+}
+
+
+// state shared between the threads bulk loading one of the inner tables: its
+// addresses are split into 'npartitions' contiguous ranges (npartitions is a
+// power of two), one per partition of keys
+typedef struct bulk_load {
+	InnerTable *inner_table;	// the inner table we're filling
+	int table_num;				// which one it is (1 or 2)
+	int npartitions;
+} BulkLoad;
+
+// which partition each of the 'n' keys in 'keys' belongs to while bulk
+// loading: the one containing its address in the inner table being filled
+static void key_partition(const int64 *keys, int *partition, int n,
+	void *arg) {
+	BulkLoad *bulk = arg;
+	InnerTable *inner_table = bulk->inner_table;
+	int64 hashes[HASH_BATCH];
+	hasher_hash_batch(inner_table->hasher, keys, hashes, n);
+
+	int i;
+	for (i = 0; i < n; i++) {
+		int64 hash = hash_half(bulk->table_num, hashes[i]);
+		size64 address = rightmostnbits(inner_table->depth, hash);
+		partition[i] = address / (inner_table->size / bulk->npartitions);
+	}
+}
+
+// task: create the buckets for partition 'p''s range of addresses (each one
+// already at full depth), and place the partition's keys into them. only this
+// thread touches these buckets, so no locking is needed. keys which find their
+// bucket full are left in the partition for later, rather than cuckoo'ing
+// anything out
+static void fill_partition(Partitions *partitions, int p, void *arg) {
+	BulkLoad *bulk = arg;
+	InnerTable *inner_table = bulk->inner_table;
+	int64 *keys = partitions->keys + partitions->starts[p];
+
+	size64 range = inner_table->size / bulk->npartitions;
+	size64 a;
+	for (a = p * range; a < (p + 1) * range; a++) {
+		inner_table->buckets[a] = new_bucket(a, inner_table->depth);
+	}
+
+	int64 hashes[HASH_BATCH];
+	size64 i, left = 0;
+	for (i = 0; i < partitions->counts[p]; i++) {
+		// hash the keys a batch at a time
+		if (i % HASH_BATCH == 0) {
+			size64 n = partitions->counts[p] - i;
+			hasher_hash_batch(inner_table->hasher, keys + i, hashes,
+				(n < HASH_BATCH) ? n : HASH_BATCH);
+		}
+
+		int64 hash = hash_half(bulk->table_num, hashes[i % HASH_BATCH]);
+		size64 address = rightmostnbits(inner_table->depth, hash);
+		Bucket *bucket = inner_table->buckets[address];
+		if (!bucket->full) {
+			bucket->entry.key = keys[i];
+			bucket->entry.value = 0;
+			entry_set_hash(&bucket->entry, hashes[i % HASH_BATCH]);
+			bucket->full = true;
+		} else {
+			keys[left++] = keys[i];
+		}
+	}
+	partitions->counts[p] = left;
+}
+
+
+// find the value stored with 'key' inside 'table' (without timing it)
+// returns a pointer to the value, or NULL if 'key' is not in the table
+static int64 *find_value(XuckooHashTable *table, int64 key) {
+	// calculate the address for this key in table 1 (and table 2, at once)
+	int64 hash = hasher_hash(&table->hasher, key);
+	size64 address = rightmostnbits(table->table1->depth, HASH_FIRST(hash));
+	Bucket *bucket = table->table1->buckets[address];
 
 	// check if key in table 1
-	if (table->table1->buckets[address]->full &&
-		table->table1->buckets[address]->key == key) {
-		// add time elapsed to total CPU time before returning result
-		table->time += clock() - start_time;
-		return true;
+	if (bucket->full && bucket->entry.key == key) {
+		return &bucket->entry.value;
 	}
 
 	// calculate the address for this key in table 2
-	address = rightmostnbits(table->table2->depth, h2(key));
+	address = rightmostnbits(table->table2->depth, HASH_SECOND(hash));
+	bucket = table->table2->buckets[address];
 
 	// check if key in table 2
-	if (table->table2->buckets[address]->full &&
-		table->table2->buckets[address]->key == key) {
-		// add time elapsed to total CPU time before returning result
-		table->time += clock() - start_time;
-		return true;
+	if (bucket->full && bucket->entry.key == key) {
+		return &bucket->entry.value;
 	}
 
 	// key is in neither of the tables
-	table->time += clock() - start_time;
-	return false;
+	return NULL;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise an extendible cuckoo hash table
+XuckooHashTable *new_xuckoo_hash_table() {
+	// create new table
+	XuckooHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	// create new inner tables, sharing one hash function
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->table1 = new_inner_table(&table->hasher);
+	table->table2 = new_inner_table(&table->hasher);
+	table->nreseeds = 0;
+	table->reseeding = 0;
+
+	latency_init(&table->latency);
+	table->snapshot = NULL;
+
+	return table;
+}
+
+
+
+// build a new table containing the 'n' keys in 'keys' (which may contain
+// duplicates), sized up front to hold them all without growing, and filled
+// in parallel by 'nthreads' threads
+XuckooHashTable *xuckoo_hash_table_bulk_load(int64 *keys, size64 n,
+	int nthreads) {
+	XuckooHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	// make each inner table big enough to hold every key by itself, so the
+	// table as a whole is at most half full
+	int depth = depth_for(n);
+	hasher_init(&table->hasher, hash_default_family(), hash_new_seed());
+	table->table1 = new_sized_inner_table(depth, &table->hasher);
+	table->table2 = new_sized_inner_table(depth, &table->hasher);
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	latency_init(&table->latency);
+	table->snapshot = NULL;
+
+	int depth_bits = ceil_log2(nthreads * PARTITIONS_PER_THREAD);
+	BulkLoad bulk;
+	bulk.npartitions = 1 << (depth_bits < depth ? depth_bits : depth);
+
+	// fill table 1 in parallel, then table 2 with the keys that didn't fit
+	size64 nleft = n;
+	int64 *left = keys;
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	int t;
+	for (t = 0; t < 2; t++) {
+		bulk.inner_table = innertables[t];
+		bulk.table_num = t + 1;
+		Partitions *partitions = partition_keys(left, nleft, bulk.npartitions,
+			key_partition, &bulk, nthreads);
+		size64 nkeys = count_keys(partitions);
+		for_each_partition(partitions, fill_partition, &bulk);
+		innertables[t]->stats.nkeys = nkeys - count_keys(partitions);
+
+		if (left != keys) {
+			free(left);
+		}
+		left = remaining_keys(partitions, &nleft);
+		free_partitions(partitions);
+	}
+
+	// the few keys that collided in both tables get cuckoo'd in normally
+	size64 i;
+	for (i = 0; i < nleft; i++) {
+		Entry entry = { .key = left[i], .value = 0 };
+		insert_entry(table, entry);
+	}
+	free(left);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_xuckoo_hash_table(XuckooHashTable *table) {
+	assert(table);
+
+	free_inner_table(table->table1, table->snapshot);
+	free_inner_table(table->table2, table->snapshot);
+
+	hasher_free(&table->hasher);
+	latency_free(&table->latency);
+	free(table);
+}
+
+
+// make room in 'table' for 'nkeys' keys in total, without growing as they're
+// inserted
+void xuckoo_hash_table_reserve(XuckooHashTable *table, size64 nkeys) {
+	assert(table);
+
+	// give each inner table a bucket for every key, so the table as a whole is
+	// at most half full, then deepen their tables of bucket pointers past
+	// the buckets (for the half of the keys each holds), so that buckets
+	// which overflow split without doubling them
+	int depth = depth_for(nkeys);
+	split_to_depth(table->table1, depth, 1, &table->latency);
+	split_to_depth(table->table2, depth, 2, &table->latency);
+	depth = overflow_depth((nkeys + 1) / 2, 1, depth,
+		depth + RESERVE_SLACK);
+	while (table->table1->depth < depth) {
+		double_table(table->table1, &table->latency);
+	}
+	while (table->table2->depth < depth) {
+		double_table(table->table2, &table->latency);
+	}
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
+	assert(table);
+
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	// is key already in table?
+	if (find_value(table, key) != NULL) {
+		latency_end(&table->latency, &timer, OP_INSERT);
+		return false;
+	}
+
+	// otherwise cuckoo it in with an empty value
+	Entry entry = { .key = key, .value = 0 };
+	insert_entry(table, entry);
+
+	latency_end(&table->latency, &timer, OP_INSERT);
+	return true;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key) {
+	return xuckoo_hash_table_get(table, key) != NULL;
+}
+
+
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	// if key already in table just replace its value
+	int64 *stored = find_value(table, key);
+	if (stored != NULL) {
+		*stored = value;
+		latency_end(&table->latency, &timer, OP_INSERT);
+		return false;
+	}
+
+	Entry entry = { .key = key, .value = value };
+	insert_entry(table, entry);
+
+	latency_end(&table->latency, &timer, OP_INSERT);
+	return true;
+}
+
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *xuckoo_hash_table_get(XuckooHashTable *table, int64 key) {
+	assert(table);
+	LatencyTimer timer;
+	latency_begin(&table->latency, &timer);
+
+	int64 *value = find_value(table, key);
+
+	latency_end(&table->latency, &timer, value ? OP_HIT : OP_MISS);
+	return value;
+}
+
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *xuckoo_hash_table_iter_next(XuckooHashTable *table, Cursor *cursor) {
+	assert(table);
+	assert(cursor);
+
+	// walk through table 1's buckets, then table 2's. many addresses can point
+	// to the same bucket, so only look at each bucket from its first address
+	InnerTable *innertables[2] = {table->table1, table->table2};
+	while (cursor->table < 2) {
+		InnerTable *inner_table = innertables[cursor->table];
+		while (cursor->address < inner_table->size) {
+			size64 address = cursor->address++;
+			Bucket *bucket = inner_table->buckets[address];
+			if (bucket->id == address && bucket->full) {
+				return &bucket->entry;
+			}
+		}
+
+		// move on to the start of the next table
+		cursor->table++;
+		cursor->address = 0;
+	}
+
+	// no more buckets left
+	return NULL;
+}
+
+
+// write the contents of 'table' to 'file', in a layout that
+// xuckoo_hash_table_load() can use in place
+void xuckoo_hash_table_save(XuckooHashTable *table, FILE *file) {
+	assert(table);
+	assert(file);
+
+	snapshot_write_hasher(file, &table->hasher);
+	save_inner_table(table->table1, file);
+	save_inner_table(table->table2, file);
+}
+
+
+// create a table from the next part of 'snapshot' (as written by
+// xuckoo_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+XuckooHashTable *xuckoo_hash_table_load(Snapshot *snapshot) {
+	assert(snapshot);
+
+	XuckooHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	if (!snapshot_read_hasher(snapshot, &table->hasher)) {
+		free(table);
+		return NULL;
+	}
+	table->table1 = load_inner_table(snapshot, &table->hasher);
+	table->table2 = load_inner_table(snapshot, &table->hasher);
+	if (table->table2 == NULL) {
+		// (reads after a failed one fail too, so this one failing covers both)
+		if (table->table1) {
+			free_inner_table(table->table1, snapshot);
+		}
+		hasher_free(&table->hasher);
+		free(table);
+		return NULL;
+	}
+	latency_init(&table->latency);
+	table->nreseeds = 0;
+	table->reseeding = 0;
+	table->snapshot = snapshot;
+
+	return table;
 }
 
 
@@ -373,16 +953,17 @@ void xuckoo_hash_table_print(XuckooHashTable *table) {
 		printf("  address | bucketid   bucketid [key]\n");
 
 		// print table and buckets
-		int i;
+		size64 i;
 		for (i = 0; i < innertables[t]->size; i++) {
 			// table entry
-			printf("%9d | %-9d ", i, innertables[t]->buckets[i]->id);
+			printf("%9lld | %-9lld ", (long long) i,
+				(long long) innertables[t]->buckets[i]->id);
 
 			// if this is the first address at which a bucket occurs, print it
 			if (innertables[t]->buckets[i]->id == i) {
-				printf("%9d ", innertables[t]->buckets[i]->id);
+				printf("%9lld ", (long long) innertables[t]->buckets[i]->id);
 				if (innertables[t]->buckets[i]->full) {
-					printf("[%llu]", innertables[t]->buckets[i]->key);
+					printf("[%llu]", innertables[t]->buckets[i]->entry.key);
 				} else {
 					printf("[ ]");
 				}
@@ -396,6 +977,31 @@ void xuckoo_hash_table_print(XuckooHashTable *table) {
 }
 
 
+// how full 'table' is: the fraction of its key slots currently holding a key
+double xuckoo_hash_table_load_factor(XuckooHashTable *table) {
+	assert(table);
+
+	size64 nkeys = table->table1->stats.nkeys + table->table2->stats.nkeys;
+	return (double) nkeys
+		/ (table->table1->stats.nbuckets + table->table2->stats.nbuckets);
+}
+
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage xuckoo_hash_table_memory_usage(XuckooHashTable *table) {
+	assert(table);
+
+	MemoryUsage usage = { 0 };
+	memory_count(&usage, &usage.overhead, table, sizeof *table, NULL);
+	count_memory_usage(table->table1, &usage, table->snapshot);
+	count_memory_usage(table->table2, &usage, table->snapshot);
+	memory_count_hasher(&usage, &table->hasher);
+	latency_memory_usage(&table->latency, &usage);
+	return usage;
+}
+
+
 // print some statistics about 'table' to stdout
 void xuckoo_hash_table_stats(XuckooHashTable *table) {
 	assert(table);
@@ -405,12 +1011,12 @@ void xuckoo_hash_table_stats(XuckooHashTable *table) {
 
 	// compute some stats
 	// avoid 0 division when there are 0 keys in the table
-	int total_keys = 0;
+	size64 total_keys = 0;
 	if (table1->stats.nkeys + table2->stats.nkeys > 0) {
 		total_keys = table1->stats.nkeys + table2->stats.nkeys;
 	}
 
-	int total_buckets = table1->stats.nbuckets + table2->stats.nbuckets;
+	size64 total_buckets = table1->stats.nbuckets + table2->stats.nbuckets;
 
 	float t1_load_factor = table1->stats.nkeys * 100.0 / table1->size;
 	float t2_load_factor = table2->stats.nkeys * 100.0 / table2->size;
@@ -423,24 +1029,31 @@ void xuckoo_hash_table_stats(XuckooHashTable *table) {
 	printf("--- table stats ---\n");
 
 	// print some stats about state of the table
+	printf("rehashed with a new seed: %d times\n", table->nreseeds);
 	printf("table 1:\n");
-	printf("    %d slots\n", table1->size);
-	printf("    %d keys\n", table1->stats.nkeys);
-	printf("    %d buckets\n", table1->stats.nbuckets);
+	printf("    %lld slots\n", (long long) table1->size);
+	printf("    %lld keys\n", (long long) table1->stats.nkeys);
+	printf("    %lld buckets\n", (long long) table1->stats.nbuckets);
 	printf("    %.1f%% of all keys\n", t1_keyp);
 	printf("    %.1f%% of all buckets\n", t1_bucketp);
 	printf("    load factor of %.3f%% (nkeys/nslots)\n", t1_load_factor);
 	printf("table 2:\n");
-	printf("    %d slots\n", table2->size);
-	printf("    %d keys\n", table2->stats.nkeys);
-	printf("    %d buckets\n", table2->stats.nbuckets);
+	printf("    %lld slots\n", (long long) table2->size);
+	printf("    %lld keys\n", (long long) table2->stats.nkeys);
+	printf("    %lld buckets\n", (long long) table2->stats.nbuckets);
 	printf("    %.1f%% of all keys\n", t2_keyp);
 	printf("    %.1f%% of all buckets\n", t2_bucketp);
 	printf("    load factor of %.3f%% (nkeys/nslots)\n", t2_load_factor);
 
-	// also calculate CPU usage in seconds and print this
-	float seconds = table->time * 1.0 / CLOCKS_PER_SEC;
-	printf("CPU time spent: %.6f sec\n", seconds);
+	// print how much memory each entry is costing us (avoiding 0 division)
+	size_t bytes = memory_total(xuckoo_hash_table_memory_usage(table));
+	printf("memory used: %zu bytes\n", bytes);
+	if (total_keys > 0) {
+		printf("    per entry: %.2f bytes\n", bytes * 1.0 / total_keys);
+	}
+
+	// and how long operations have been taking
+	latency_print(&table->latency);
 
 	printf("--- end stats ---\n");
 }
@@ -12,16 +12,32 @@
 #define XUCKOON_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "../inthash.h"
+#include "../snapshot.h"
+#include "../memusage.h"
 
 typedef struct xuckoon_table XuckoonHashTable;
 
 // initialise an extendible cuckoo hash table
 XuckoonHashTable *new_xuckoon_hash_table(int bucketsize);
 
+// build a new table with 'bucketsize' keys per bucket containing the 'n' keys
+// in 'keys' (which may contain duplicates), sized up front to hold them all
+// without growing, and filled in parallel by 'nthreads' threads
+XuckoonHashTable *xuckoon_hash_table_bulk_load(int64 *keys, size64 n,
+	int bucketsize, int nthreads);
+
 // free all memory associated with 'table'
 void free_xuckoon_hash_table(XuckoonHashTable *table);
 
+// make room in 'table' for 'nkeys' keys in total (including any already in
+// it), splitting buckets and deepening the table of bucket pointers past
+// them, so that inserting that many keys splits few buckets and does no
+// doubling (unless keys share long runs of hash value bits). never shrinks
+// the table
+void xuckoon_hash_table_reserve(XuckoonHashTable *table, size64 nkeys);
+
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool xuckoon_hash_table_insert(XuckoonHashTable *table, int64 key);
@@ -30,6 +46,39 @@ bool xuckoon_hash_table_insert(XuckoonHashTable *table, int64 key);
 // returns true if found, false if not
 bool xuckoon_hash_table_lookup(XuckoonHashTable *table, int64 key);
 
+// insert 'key' into 'table' with value 'value', or replace the value stored
+// with 'key' if it's already in there
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xuckoon_hash_table_put(XuckoonHashTable *table, int64 key, int64 value);
+
+// find the value stored with 'key' inside 'table'
+// returns a pointer to the value (only valid until the next insertion),
+// or NULL if 'key' is not in the table
+int64 *xuckoon_hash_table_get(XuckoonHashTable *table, int64 key);
+
+// advance 'cursor' to the next entry inside 'table' (start with a zeroed
+// cursor), visiting every entry exactly once
+// returns a pointer to the entry inside the table itself (only valid until the
+// next insertion), or NULL once every entry has been visited
+Entry *xuckoon_hash_table_iter_next(XuckoonHashTable *table, Cursor *cursor);
+
+// write the contents of 'table' to 'file', in a layout that
+// xuckoon_hash_table_load() can use in place
+void xuckoon_hash_table_save(XuckoonHashTable *table, FILE *file);
+
+// create a table from the next part of 'snapshot' (as written by
+// xuckoon_hash_table_save()), using the arrays inside the snapshot in place
+// rather than re-inserting any keys. 'snapshot' must outlive the table
+// returns NULL if the snapshot is truncated or corrupt (see snapshot->error)
+XuckoonHashTable *xuckoon_hash_table_load(Snapshot *snapshot);
+
+// how full 'table' is: the fraction of its key slots currently holding a key
+double xuckoon_hash_table_load_factor(XuckoonHashTable *table);
+
+// calculate how many bytes of memory 'table' is currently using, broken down
+// by what they're used for
+MemoryUsage xuckoon_hash_table_memory_usage(XuckoonHashTable *table);
+
 // print the contents of 'table' to stdout
 void xuckoon_hash_table_print(XuckoonHashTable *table);
 
@@ -0,0 +1,71 @@
+/* * * * * * * * *
+ * Test program checking that every hash family can address every slot of a
+ * power-of-two table up to MAX_TABLE_SIZE slots: across a few thousand random
+ * keys, each of the lowest log2(MAX_TABLE_SIZE) bits of both hash values (see
+ * HASH_FIRST and HASH_SECOND) must be set for some key and clear for
+ * another. tables past 2^32 slots (and extendible tables past 32 bits deep)
+ * address with the upper of those bits, so a bit stuck at 0 would leave half
+ * their slots unreachable
+ *
+ * usage:
+ *   make check
+ *   ./tests/addresses
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "../inthash.h"
+#include "../xorshift.h"
+
+#define NKEYS 4096
+
+// how many other seeds to try each family with (besides seed 0)
+#define NSEEDS 8
+
+// check that the hash function of 'family' with seed 'seed' sets and clears
+// every address bit of both of its hash values, over NKEYS random keys (as
+// few keys as regular as 0, 1, 2, ... can leave some low bits of a
+// multiply-shift hash unchanged, without saying anything about addressing)
+static void test_hasher(HashFamily family, int64 seed) {
+	Hasher hasher;
+	hasher_init(&hasher, family, seed);
+
+	const int64 mask = MAX_TABLE_SIZE - 1;
+	int64 ones[2] = {0, 0}, zeros[2] = {0, 0};
+	int64 state = XORSHIFT_SEED;
+	int i;
+	for (i = 0; i < NKEYS; i++) {
+		int64 hash = hasher_hash(&hasher, next_random(&state));
+		ones[0] |= HASH_FIRST(hash);
+		zeros[0] |= ~HASH_FIRST(hash);
+		ones[1] |= HASH_SECOND(hash);
+		zeros[1] |= ~HASH_SECOND(hash);
+	}
+	int half;
+	for (half = 0; half < 2; half++) {
+		assert((ones[half] & mask) == mask);
+		assert((zeros[half] & mask) == mask);
+	}
+
+	hasher_free(&hasher);
+}
+
+int main(int argc, char **argv) {
+	int64 seeds = XORSHIFT_SEED + 1;
+	HashFamily family;
+	for (family = 0; family < NUM_HASH_FAMILIES; family++) {
+		test_hasher(family, 0);
+		int s;
+		for (s = 0; s < NSEEDS; s++) {
+			test_hasher(family, next_random(&seeds));
+		}
+	}
+	printf("addresses: ok\n");
+	return 0;
+}
@@ -0,0 +1,184 @@
+/* * * * * * * * *
+ * Test program checking that tables which change hash function part-way
+ * through growing still find every key afterwards, with entries keeping
+ * their hash values (it's built with CACHE_HASHES=1, whatever CACHE is, as
+ * stale cached hash values are what would lose the keys), and that keys
+ * sharing far too many hash value bits make the extendible cuckoo tables
+ * change hash function rather than grow their tables of bucket pointers
+ *
+ * usage:
+ *   make check
+ *   ./tests/reseed
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../memusage.h"
+#include "../xorshift.h"
+
+#if !CACHE_HASHES
+#error "tests/reseed checks cached hash values: build it with CACHE_HASHES=1"
+#endif
+
+// the size of the linear probing table, and how far apart (in h1() values)
+// its colliding keys are
+#define LINEAR_SIZE 1024
+#define LINEAR_STRIDE (1 << 20)
+
+// the size of the cuckoo table, and how many keys it reserves room for
+// (making it resize to RESERVED + RESERVED / 4 slots per inner table)
+#define CUCKOO_SIZE 1024
+#define CUCKOO_KEYS 600
+#define RESERVED 1000
+
+// how many keys to give the extendible cuckoo tables, and how many of the
+// lowest bits of h1() and of h2() those keys all share
+#define XUCKOO_KEYS 8
+#define H1_BITS 14
+#define H2_BITS 12
+
+// the most bucket pointers per key a table may keep once it has changed
+// hash function (keeping them all, it would need thousands)
+#define POINTERS_PER_KEY 16
+
+// check that every one of the 'n' keys in 'keys' is in 'table'
+static void check_keys(HashTable *table, int64 *keys, int n) {
+	int i;
+	for (i = 0; i < n; i++) {
+		assert(hash_table_lookup(table, keys[i]));
+	}
+}
+
+// fill the back half of a linear probing table with keys that land in a slot
+// each, and the front half with keys that all land in slot 0 (too late to
+// change seed, with the table over half full), then insert one more key to
+// double it. the colliding keys come first when the table doubles, and give
+// it a new hash function before the rest of its keys are moved
+static void test_linear(void) {
+	int n = LINEAR_SIZE + 1;
+	int64 *keys = malloc(n * sizeof *keys);
+	assert(keys);
+	int i;
+	for (i = 0; i < LINEAR_SIZE / 2; i++) {
+		keys[i] = h1_preimage(LINEAR_SIZE / 2 + i);
+	}
+	for (; i < n; i++) {
+		keys[i] = h1_preimage((i - LINEAR_SIZE / 2 + 1) * LINEAR_STRIDE);
+	}
+
+	HashTable *table = new_hash_table(LINEAR, LINEAR_SIZE);
+	for (i = 0; i < n; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	check_keys(table, keys, n);
+
+	free_hash_table(table);
+	free(keys);
+}
+
+// find 'n' keys that share both slots (0 in each inner table) in a cuckoo
+// table with 'size' slots per inner table, none of them sharing a slot with
+// another in a table with 'old_size' slots, where they all go in the front
+// half of each inner table
+static void find_cuckoo_keys(int64 *keys, int n, size64 size, size64 old_size) {
+	Hasher hasher;
+	hasher_init(&hasher, HASH_MODPRIME, 0);
+	int64 key = 0;
+	int found = 0;
+	while (found < n) {
+		key++;
+		int64 hash = hasher_hash(&hasher, key);
+		size64 first = HASH_FIRST(hash), second = HASH_SECOND(hash);
+		if (first % size != 0 || second % size != 0
+			|| first % old_size >= old_size / 2
+			|| second % old_size >= old_size / 2) {
+			continue;
+		}
+		int i;
+		for (i = 0; i < found; i++) {
+			int64 other = hasher_hash(&hasher, keys[i]);
+			if ((size64) HASH_FIRST(other) % old_size == first % old_size) {
+				break;
+			}
+		}
+		if (i == found) {
+			keys[found++] = key;
+		}
+	}
+	hasher_free(&hasher);
+}
+
+// put three keys that can only cuckoo back and forth between the same two
+// slots, once it grows, into a cuckoo table with plenty of other keys, then
+// make it grow by reserving room. the three keys come first when the table
+// moves its keys, and give it a new hash function before the rest are moved
+static void test_cuckoo(void) {
+	int n = 3 + CUCKOO_KEYS;
+	int64 *keys = malloc(n * sizeof *keys);
+	assert(keys);
+	size64 size = RESERVED + (RESERVED + 3) / 4;
+	find_cuckoo_keys(keys, 3, size, CUCKOO_SIZE);
+	int64 state = XORSHIFT_SEED;
+	int i;
+	for (i = 3; i < n; i++) {
+		keys[i] = next_random(&state);
+	}
+
+	HashTable *table = new_hash_table(CUCKOO, CUCKOO_SIZE);
+	for (i = 0; i < n; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	hash_table_reserve(table, RESERVED);
+	check_keys(table, keys, n);
+
+	free_hash_table(table);
+	free(keys);
+}
+
+// insert keys sharing their lowest H1_BITS bits of h1() and H2_BITS bits of
+// h2() into an extendible cuckoo table of type 'type' (with bucket size
+// 'size'), each inner table of which would have to grow deep enough to tell
+// the keys apart, unless it changes hash function instead
+static void test_xuckoo(TableType type, int size) {
+	int64 keys[XUCKOO_KEYS];
+	int found = 0;
+	int64 hash;
+	for (hash = 1 << H1_BITS; found < XUCKOO_KEYS; hash += 1 << H1_BITS) {
+		int64 key = h1_preimage(hash);
+		if (h2(key) % (1 << H2_BITS) == 0) {
+			keys[found++] = key;
+		}
+	}
+
+	HashTable *table = new_hash_table(type, size);
+	int i;
+	for (i = 0; i < XUCKOO_KEYS; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	MemoryUsage usage = hash_table_memory_usage(table);
+	assert(usage.directory
+		<= XUCKOO_KEYS * POINTERS_PER_KEY * sizeof (void *));
+	check_keys(table, keys, XUCKOO_KEYS);
+
+	free_hash_table(table);
+}
+
+int main(int argc, char **argv) {
+	// (seed 0 makes HASH_MODPRIME's halves h1() and h2() themselves)
+	hash_fix_seed(0);
+
+	test_linear();
+	test_cuckoo();
+	test_xuckoo(XUCKOO, 1);
+	test_xuckoo(XUCKOON, 2);
+	printf("reseed: ok\n");
+	return 0;
+}
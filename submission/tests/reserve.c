@@ -0,0 +1,89 @@
+/* * * * * * * * *
+ * Test program checking that a table which has reserved room for n keys takes
+ * n keys without growing: linear probing and cuckoo tables never resize, and
+ * extendible tables never double their tables of bucket pointers (though a
+ * few of their buckets may still split)
+ *
+ * the single-key bucket tables (xtndbl1 and xuckoo) are left out: they have
+ * to double whenever two keys share every bit of their table of bucket
+ * pointers, and random keys do that long before reserving could afford
+ * enough bits to prevent it
+ *
+ * usage:
+ *   make check
+ *   ./tests/reserve
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../memusage.h"
+#include "../xorshift.h"
+
+#define SEED 0x5eed5eed5eed5eedLL
+
+// the table types to check, in order
+static const char *types[] = { "linear", "cuckoo", "xtndbln", "xuckoon" };
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// the sizes to create each table with, as in a2 -s (the initial number of
+// slots for linear and cuckoo, and the bucket size for the others)
+static const int sizes[] = { 4, 16 };
+#define NUM_SIZES (sizeof sizes / sizeof *sizes)
+
+// how many keys to reserve room for, and insert
+static const int nkeys[] = { 1000, 50000 };
+#define NUM_NKEYS (sizeof nkeys / sizeof *nkeys)
+
+// reserve room for 'n' keys in a new table of type 'type' and size 'size',
+// then insert 'n' random keys and check that the table didn't grow
+static void test_reserve(TableType type, int size, int n) {
+	HashTable *table = new_hash_table(type, size);
+	hash_table_reserve(table, n);
+	MemoryUsage before = hash_table_memory_usage(table);
+
+	int64 state = XORSHIFT_SEED;
+	int i;
+	for (i = 0; i < n; i++) {
+		hash_table_insert(table, next_random(&state));
+	}
+	MemoryUsage after = hash_table_memory_usage(table);
+
+	// no resizing or doubling
+	assert(after.slots == before.slots);
+	assert(after.inuse == before.inuse);
+	assert(after.directory == before.directory);
+
+	// and only a few buckets split (under 1 in 8)
+	assert(after.headers - before.headers <= before.headers / 8);
+
+	// with every key still there
+	state = XORSHIFT_SEED;
+	for (i = 0; i < n; i++) {
+		assert(hash_table_lookup(table, next_random(&state)));
+	}
+
+	free_hash_table(table);
+}
+
+int main(int argc, char **argv) {
+	hash_fix_seed(SEED);
+
+	int t, s, k;
+	for (t = 0; t < NUM_TYPES; t++) {
+		for (s = 0; s < NUM_SIZES; s++) {
+			for (k = 0; k < NUM_NKEYS; k++) {
+				test_reserve(strtotype((char *) types[t]), sizes[s], nkeys[k]);
+			}
+		}
+	}
+	printf("reserve: ok\n");
+	return 0;
+}
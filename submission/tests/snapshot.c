@@ -0,0 +1,214 @@
+/* * * * * * * * *
+ * Test program checking that snapshots load back into working tables, and
+ * that truncated or corrupted snapshot files are refused (hash_table_load()
+ * returning NULL) rather than crashing the program
+ *
+ * usage:
+ *   make check
+ *   ./tests/snapshot
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#define _POSIX_C_SOURCE 200809L  // for dup, fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "../inthash.h"
+#include "../hashtbl.h"
+#include "../xorshift.h"
+
+#define NKEYS 1000
+#define SIZE 4096
+#define NFUZZ 64
+#define SEED 0x5eed5eed5eed5eedLL
+
+// where the snapshots are written (and rewritten, truncated or corrupted)
+#define PATH "tests/snapshot.tmp"
+
+// the table types that can be saved, in order
+static const char *types[] = {
+	"linear", "xtndbl1", "cuckoo", "xtndbln", "xuckoo", "xuckoon"
+};
+#define NUM_TYPES (sizeof types / sizeof *types)
+
+// read the whole file at 'path' into a new array, setting '*size' to its size
+static char *read_file(const char *path, long *size) {
+	FILE *file = fopen(path, "rb");
+	assert(file);
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	char *data = malloc(*size);
+	assert(data);
+	size_t nread = fread(data, 1, *size, file);
+	assert(nread == (size_t) *size);
+	fclose(file);
+	return data;
+}
+
+// write the first 'size' bytes of 'data' to the file at 'path'
+static void write_file(const char *path, const char *data, long size) {
+	FILE *file = fopen(path, "wb");
+	assert(file);
+	size_t nwritten = fwrite(data, 1, size, file);
+	assert(nwritten == (size_t) size);
+	fclose(file);
+}
+
+// load the snapshot at PATH, without letting hash_table_load() print why it
+// refuses it (which this program expects, again and again)
+static HashTable *load_quietly(void) {
+	fflush(stderr);
+	int saved = dup(fileno(stderr));
+	assert(saved >= 0);
+	FILE *null = freopen("/dev/null", "w", stderr);
+	assert(null);
+	HashTable *table = hash_table_load(PATH);
+	fflush(stderr);
+	dup2(saved, fileno(stderr));
+	close(saved);
+	return table;
+}
+
+// write 'data' (a snapshot) with 'size' bytes to PATH, and check it's refused
+static void check_refused(const char *data, long size) {
+	write_file(PATH, data, size);
+	assert(load_quietly() == NULL);
+}
+
+// check that every key in 'keys' is in 'table', and some others aren't
+static void check_keys(HashTable *table, int64 *keys) {
+	int i;
+	for (i = 0; i < NKEYS; i++) {
+		assert(hash_table_lookup(table, keys[i]));
+		assert(!hash_table_lookup(table, keys[i] + 1));
+	}
+}
+
+// save a table of type 'type' to PATH, then check that it loads back, that
+// every shorter copy of the file is refused, and that so are copies with a
+// damaged header, table sizes, hash function or table of bucket pointers.
+// copies damaged anywhere else must either be refused or load into a table
+// that can be searched (whatever it finds)
+static void test_type(TableType type) {
+	// keys spread out by multiplying by an odd constant, so that none is one
+	// more than another, and all are below both hash function primes
+	int64 keys[NKEYS];
+	int i;
+	for (i = 0; i < NKEYS; i++) {
+		keys[i] = (int64) (i + 1) * 2654435 * 2;
+	}
+	HashTable *table = new_hash_table(type, SIZE);
+	for (i = 0; i < NKEYS; i++) {
+		hash_table_insert(table, keys[i]);
+	}
+	assert(hash_table_save(table, PATH));
+	free_hash_table(table);
+
+	long size;
+	char *data = read_file(PATH, &size);
+	char *copy = malloc(size);
+	assert(copy);
+
+	// an intact snapshot loads, and keeps working after more insertions
+	table = hash_table_load(PATH);
+	assert(table);
+	check_keys(table, keys);
+	hash_table_insert(table, 1);
+	assert(hash_table_lookup(table, 1));
+	free_hash_table(table);
+
+	// truncated anywhere
+	long length, step = size / 256 + 1;
+	for (length = 0; length < size; length += step) {
+		check_refused(data, length);
+	}
+	check_refused(data, size - 1);
+	check_refused(data, size - 8);
+
+	// a damaged magic number, or another format version
+	memcpy(copy, data, size);
+	copy[0] ^= 1;
+	check_refused(copy, size);
+	memcpy(copy, data, size);
+	copy[8] ^= 1;
+	check_refused(copy, size);
+
+	// the hash function is recorded as its family and (fixed) seed, and the
+	// table sizes follow the header, aligned to 8 bytes (except in the
+	// extendible cuckoo tables, where the hash function comes first, and the
+	// first inner table's sizes follow it)
+	int64 hashing[2] = {hash_default_family(), SEED};
+	long hasher = 0;
+	while (memcmp(data + hasher, hashing, sizeof hashing) != 0) {
+		hasher += 8;
+		assert(hasher + sizeof hashing <= size);
+	}
+	long sizes = (28 + 7) / 8 * 8;
+	if (type == XUCKOO || type == XUCKOON) {
+		sizes = hasher + sizeof hashing;
+	}
+	if (type == LINEAR || type == CUCKOO) {
+		// more keys than slots
+		memcpy(copy, data, size);
+		size64 load = SIZE + 1;
+		memcpy(copy + sizes + sizeof (size64), &load, sizeof load);
+		check_refused(copy, size);
+	} else {
+		// a table of bucket pointers which isn't a power of two long
+		memcpy(copy, data, size);
+		size64 bad_size = 3;
+		memcpy(copy + sizes, &bad_size, sizeof bad_size);
+		check_refused(copy, size);
+
+		// a bucket pointer (the very last) to a bucket that isn't there
+		memcpy(copy, data, size);
+		size64 id = -1;
+		memcpy(copy + size - sizeof id, &id, sizeof id);
+		check_refused(copy, size);
+	}
+	memcpy(copy, data, size);
+	int64 family = NUM_HASH_FAMILIES;
+	memcpy(copy + hasher, &family, sizeof family);
+	check_refused(copy, size);
+
+	// damaged anywhere at all
+	int64 state = XORSHIFT_SEED;
+	int f;
+	for (f = 0; f < NFUZZ; f++) {
+		memcpy(copy, data, size);
+		int64 word = -1;
+		long at = next_random(&state) % (size / 8) * 8;
+		memcpy(copy + at, &word, sizeof word);
+		write_file(PATH, copy, size);
+		table = load_quietly();
+		if (table) {
+			for (i = 0; i < NKEYS; i++) {
+				hash_table_lookup(table, keys[i]);
+			}
+			free_hash_table(table);
+		}
+	}
+
+	free(data);
+	free(copy);
+}
+
+int main(int argc, char **argv) {
+	hash_fix_seed(SEED);
+
+	int t;
+	for (t = 0; t < NUM_TYPES; t++) {
+		test_type(strtotype((char *) types[t]));
+	}
+	remove(PATH);
+	printf("snapshot: ok\n");
+	return 0;
+}
@@ -0,0 +1,27 @@
+/* * * * * * * * *
+ * The pseudo-random number generator shared by cmdgen and the test and
+ * benchmark programs: Marsaglia's xorshift64, which is fast, gives all 64
+ * bits, and gives the same numbers on every machine (unlike rand())
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Liam Aharon
+ */
+
+#ifndef XORSHIFT_H
+#define XORSHIFT_H
+
+#include "inthash.h"
+
+// the state the test and benchmark programs start their generators in
+// (Marsaglia's own example). any state but 0 works
+#define XORSHIFT_SEED 88172645463325252ULL
+
+// the next pseudo-random number from the xorshift generator at 'state'
+static inline int64 next_random(int64 *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+#endif